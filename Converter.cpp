@@ -1,11 +1,25 @@
 #include <iostream>
 #include <vector>
 #include <assert.h>
+#include <math.h>
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
 #include "../GfxCore/color.h"
 #include "../GfxCore/image.h"
 #include "../GfxCore/geom.h"
 #include "../GfxCore/resourceManager.h"
 #include "../GfxCore/util.h"
+#include "converter.h"
+#include "vertexWelder.h"
+#include "benchmark.h"
+#include "parallel.h"
+#include "objParser.h"
+#include "modelFile.h"
+#include "meshOptimizer.h"
 
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
@@ -14,10 +28,6 @@
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 
-static const std::string ModelPath = "models/";
-static const std::string TexturePath = "textures/";
-static const std::string ConvertedPath = "models/";
-
 enum imageFormat_t
 {
     IMAGE_FORMAT_BMP,
@@ -58,13 +68,31 @@ bool ConvertImage( const std::string& srcFileName, const std::string& dstFileNam
 }
 
 
+static void CopyPixels( const stbi_uc* pixels, const int32_t width, const int32_t height, Image<Color>& outImage )
+{
+    outImage = Image<Color>( width, height );
+    for ( int32_t y = 0; y < height; ++y )
+    {
+        for ( int32_t x = 0; x < width; ++x )
+        {
+            Pixel pixel;
+            pixel.rgba.r = pixels[ ( y * width + x ) * 4 + 0 ];
+            pixel.rgba.g = pixels[ ( y * width + x ) * 4 + 1 ];
+            pixel.rgba.b = pixels[ ( y * width + x ) * 4 + 2 ];
+            pixel.rgba.a = pixels[ ( y * width + x ) * 4 + 3 ];
+
+            outImage.SetPixel( x, y, Color( pixel.r8g8b8a8 ) );
+        }
+    }
+}
+
+
 bool LoadImage( const std::string& path, Image<Color>& outImage )
 {
     int32_t width;
     int32_t height;
     int32_t channels;
     stbi_uc* pixels = stbi_load( path.c_str(), &width, &height, &channels, STBI_rgb_alpha );
-    int32_t imageSize = width * height * 4;
 
     if ( !pixels )
     {
@@ -73,21 +101,27 @@ bool LoadImage( const std::string& path, Image<Color>& outImage )
         return false;
     }
 
-    outImage = Image<Color>( width, height );
-    for ( int32_t y = 0; y < height; ++y )
-    {
-        for ( int32_t x = 0; x < width; ++x )
-        {
-            Pixel pixel;
-            pixel.rgba.r = pixels[ ( y * width + x ) * 4 + 0 ];
-            pixel.rgba.g = pixels[ ( y * width + x ) * 4 + 1 ];
-            pixel.rgba.b = pixels[ ( y * width + x ) * 4 + 2 ];
-            pixel.rgba.a = pixels[ ( y * width + x ) * 4 + 3 ];
+    CopyPixels( pixels, width, height, outImage );
+    stbi_image_free( pixels );
+    return true;
+}
 
-            outImage.SetPixel( x, y, Color( pixel.r8g8b8a8 ) );
-        }
+
+// Decodes an image file that is already in memory, e.g. a pack entry
+bool LoadImageFromMemory( const uint8_t* data, const size_t size, Image<Color>& outImage )
+{
+    int32_t width;
+    int32_t height;
+    int32_t channels;
+    stbi_uc* pixels = ( size <= INT32_MAX ) ? stbi_load_from_memory( data, static_cast<int>( size ), &width, &height, &channels, STBI_rgb_alpha ) : nullptr;
+
+    if ( !pixels )
+    {
+        std::cout << "Failed to load texture image!" << std::endl;
+        return false;
     }
 
+    CopyPixels( pixels, width, height, outImage );
     stbi_image_free( pixels );
     return true;
 }
@@ -103,92 +137,72 @@ rgbTuplef_t TinyObjColorToRGB( tinyobj::real_t ary[ 3 ] )
 }
 
 
-uint32_t LoadModel( const std::string& path, ResourceManager& rm )
+vertex_t TinyObjVertex( const tinyobj::attrib_t& attrib, const tinyobj::index_t& index )
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn, err;
+    return ObjVertex( attrib.vertices.data(), attrib.vertices.size(), attrib.normals.data(), attrib.normals.size(),
+                      attrib.texcoords.data(), attrib.texcoords.size(), index );
+}
+
+
+vertex_t ObjVertex( const tinyobj::real_t* vertices, const size_t vertexCount, const tinyobj::real_t* normals, const size_t normalCount,
+                    const tinyobj::real_t* texcoords, const size_t textureCount, const tinyobj::index_t& index )
+{
+    vertex_t vert;
 
-    if ( !tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, path.c_str(), ModelPath.c_str() ) )
+    if( ( index.vertex_index >= 0 ) && ( ( 3 * static_cast<size_t>( index.vertex_index ) + 2 ) < vertexCount ) )
     {
-        throw std::runtime_error( warn + err );
+        vert.pos[ 0 ] = vertices[ 3 * index.vertex_index + 0 ];
+        vert.pos[ 1 ] = vertices[ 3 * index.vertex_index + 1 ],
+        vert.pos[ 2 ] = vertices[ 3 * index.vertex_index + 2 ];
+    }
+    else
+    {
+        vert.pos = vec4f( 0.0f, 0.0f, 0.0f );
     }
 
-    std::string materialName = "";
-    if( materials.size() )
+    if ( ( index.normal_index >= 0 ) && ( ( 3 * static_cast<size_t>( index.normal_index ) + 2 ) < normalCount ) )
     {
-        materialName = materials[ 0 ].name;
+        vert.normal[ 0 ] = normals[ 3 * index.normal_index + 0 ];
+        vert.normal[ 1 ] = normals[ 3 * index.normal_index + 1 ],
+        vert.normal[ 2 ] = normals[ 3 * index.normal_index + 2 ];
+    }
+    else
+    {
+        vert.normal = vec3f( 1.0f, 0.0f, 0.0f ).Normalize();
+    }
+
+    if ( ( index.texcoord_index >= 0 ) && ( ( 2 * static_cast<size_t>( index.texcoord_index ) + 1 ) < textureCount ) )
+    {
+        vert.uv[ 0 ] = texcoords[ 2 * index.texcoord_index + 0 ];
+        vert.uv[ 1 ] = texcoords[ 2 * index.texcoord_index + 1 ];
+    }
+    else
+    {
+        vert.uv = vec2f( 0.0f, 0.0f );
     }
 
-    using indexBuffer = std::vector<uint32_t>;
+    vert.color = Color::White;
 
-    std::vector<vertex_t>       vertices;
-    std::vector<indexBuffer>    indexBuffers;
-    std::vector<vertex_t>       uniqueVertices{};
+    return vert;
+}
 
+
+void WeldShapes( const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, VertexWelder& welder, std::vector<indexBuffer_t>& indexBuffers )
+{
     const uint32_t shapeCount = shapes.size();
-    const uint32_t vertexCount = attrib.vertices.size();
-    const uint32_t normalCount = attrib.normals.size();
-    const uint32_t textureCount = attrib.texcoords.size();
 
     indexBuffers.resize( shapeCount );
-    
+
     for ( uint32_t shapeIx = 0; shapeIx < shapeCount; ++shapeIx )
     {
-        indexBuffer& indices = indexBuffers[ shapeIx ];
+        indexBuffer_t& indices = indexBuffers[ shapeIx ];
 
-        tinyobj::shape_t& shape = shapes[ shapeIx ];
+        const tinyobj::shape_t& shape = shapes[ shapeIx ];
+        indices.reserve( shape.mesh.indices.size() );
 
         for ( const auto& index : shape.mesh.indices )
         {
-            vertex_t vert;
-
-            if( ( index.vertex_index >= 0 ) && ( ( 3 * index.vertex_index + 2 ) < vertexCount ) )
-            {
-                vert.pos[ 0 ] = attrib.vertices[ 3 * index.vertex_index + 0 ];
-                vert.pos[ 1 ] = attrib.vertices[ 3 * index.vertex_index + 1 ],
-                vert.pos[ 2 ] = attrib.vertices[ 3 * index.vertex_index + 2 ];
-            }
-            else
-            {
-                vert.pos = vec4f( 0.0f, 0.0f, 0.0f );
-            }
-
-            if ( ( index.normal_index >= 0 ) && ( ( 3 * index.normal_index + 2 ) < normalCount ) )
-            {
-                vert.normal[ 0 ] = attrib.normals[ 3 * index.normal_index + 0 ];
-                vert.normal[ 1 ] = attrib.normals[ 3 * index.normal_index + 1 ],
-                vert.normal[ 2 ] = attrib.normals[ 3 * index.normal_index + 2 ];
-            }
-            else
-            {
-                vert.normal = vec3f( 1.0f, 0.0f, 0.0f ).Normalize();
-            }
-
-            if ( ( index.texcoord_index >= 0 ) && ( ( 2 * index.texcoord_index + 1 ) < textureCount ) )
-            {
-                vert.uv[ 0 ] = attrib.texcoords[ 2 * index.texcoord_index + 0 ];
-                vert.uv[ 1 ] = attrib.texcoords[ 2 * index.texcoord_index + 1 ];
-            }
-            else
-            {
-                vert.uv = vec2f( 0.0f, 0.0f );
-            }
-
-            vert.color = Color::White;
-
-            auto it = std::find( uniqueVertices.begin(), uniqueVertices.end(), vert );
-
-            if ( it == uniqueVertices.end() )
-            {
-                indices.push_back( uniqueVertices.size() );
-                uniqueVertices.push_back( vert );      
-            }
-            else
-            {
-                indices.push_back( std::distance( uniqueVertices.begin(), it ) );
-            }
+            indices.push_back( welder.Add( TinyObjVertex( attrib, index ) ) );
 
             /*
             if ( shape.mesh.num_face_vertices == 4 )
@@ -207,32 +221,245 @@ uint32_t LoadModel( const std::string& path, ResourceManager& rm )
             */
         }
     }
+}
 
-    // Normalize UVs to [0, 1]
+
+void WeldShapesParallel( const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, VertexWelder& welder, std::vector<indexBuffer_t>& indexBuffers, const uint32_t threadCount )
+{
+    const uint32_t shapeCount = shapes.size();
+    // Tolerance welds chain through earlier vertices, so merging per-shape
+    // results would not match the serial weld. They always run serially.
+    if ( ( shapeCount <= 1 ) || ( ResolveThreadCount( threadCount ) <= 1 ) || !welder.IsExact() )
+    {
+        WeldShapes( attrib, shapes, welder, indexBuffers );
+        return;
+    }
+
+    indexBuffers.resize( shapeCount );
+
+    // Each shape is welded against its own table. Local vertices come out in
+    // first-appearance order within the shape.
+    std::vector<VertexWelder> localWelders( shapeCount );
+    ParallelFor( shapeCount, threadCount, [&]( const uint32_t shapeIx )
+    {
+        indexBuffer_t& indices = indexBuffers[ shapeIx ];
+        const tinyobj::shape_t& shape = shapes[ shapeIx ];
+
+        // Welded meshes typically keep far fewer vertices than indices
+        localWelders[ shapeIx ].Reserve( shape.mesh.indices.size() / 4 );
+
+        indices.reserve( shape.mesh.indices.size() );
+        for ( const auto& index : shape.mesh.indices )
+        {
+            indices.push_back( localWelders[ shapeIx ].Add( TinyObjVertex( attrib, index ) ) );
+        }
+    } );
+
+    // Merging local tables in shape order assigns global indices in exactly the
+    // order the serial weld would, so the output is byte-identical.
+    std::vector<indexBuffer_t> remaps( shapeCount );
+    for ( uint32_t shapeIx = 0; shapeIx < shapeCount; ++shapeIx )
+    {
+        const VertexWelder& local = localWelders[ shapeIx ];
+        const std::vector<vertex_t>& localVertices = local.GetVertices();
+        const uint32_t localCount = static_cast<uint32_t>( localVertices.size() );
+
+        indexBuffer_t& remap = remaps[ shapeIx ];
+        remap.resize( localCount );
+        for ( uint32_t i = 0; i < localCount; ++i )
+        {
+            remap[ i ] = welder.Add( localVertices[ i ], local.GetHash( i ) );
+        }
+    }
+
+    ParallelFor( shapeCount, threadCount, [&]( const uint32_t shapeIx )
+    {
+        const indexBuffer_t& remap = remaps[ shapeIx ];
+        for ( uint32_t& index : indexBuffers[ shapeIx ] )
+        {
+            index = remap[ index ];
+        }
+    } );
+}
+
+
+void ImportObj( const std::string& path, const convertOptions_t& options, importedModel_t& imported )
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    const bool loaded = options.mappedParse ?
+        LoadObjMapped( &attrib, &shapes, &materials, &warn, &err, path.c_str(), ModelPath.c_str(), options.threadCount ) :
+        tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, path.c_str(), ModelPath.c_str() );
+
+    if ( !loaded )
+    {
+        throw std::runtime_error( warn + err );
+    }
+
+    VertexWelder welder( attrib.vertices.size() / 3, options.weldTolerance );
+
+    const uint32_t shapeCount = shapes.size();
+
+    if ( options.parallelWeld )
+    {
+        WeldShapesParallel( attrib, shapes, welder, imported.indexBuffers, options.threadCount );
+    }
+    else
+    {
+        WeldShapes( attrib, shapes, welder, imported.indexBuffers );
+    }
+
+    imported.vertices.swap( welder.GetVertices() );
+    imported.materials.swap( materials );
+
+    // Intentionally does not support per-vertex materials
+    imported.materialIds.resize( shapeCount );
+    for ( uint32_t shapeIx = 0; shapeIx < shapeCount; ++shapeIx )
+    {
+        const std::vector<int>& materialIds = shapes[ shapeIx ].mesh.material_ids;
+        imported.materialIds[ shapeIx ] = ( materialIds.size() > 0 ) ? materialIds[ 0 ] : -1;
+    }
+}
+
+
+void NormalizeUVs( vertex_t* vertices, const size_t vertexCount )
+{
     // TODO: leave as-is and let texture wrap mode deal with it?
+    vertex_t* vertEnd = vertices + vertexCount;
+    for ( vertex_t* it = vertices; it != vertEnd; ++it )
     {
-        auto vertEnd = uniqueVertices.end();
-        for ( auto it = uniqueVertices.begin(); it != vertEnd; ++it )
+        it->uv[ 0 ] = ( it->uv[ 0 ] > 1.0 ) ? ( it->uv[ 0 ] - floor( it->uv[ 0 ] ) ) : it->uv[ 0 ];
+        it->uv[ 1 ] = ( it->uv[ 1 ] > 1.0 ) ? ( it->uv[ 1 ] - floor( it->uv[ 1 ] ) ) : it->uv[ 1 ];
+
+        it->uv[ 0 ] = Saturate( it->uv[ 0 ] );
+        it->uv[ 1 ] = Saturate( it->uv[ 1 ] );
+
+        it->uv[ 1 ] = 1.0 - it->uv[ 1 ];
+    }
+}
+
+
+// Vertex cache order, then overdraw clusters on top of it when enabled
+static void OptimizeTriangleOrder( importedModel_t& imported, const convertOptions_t& options )
+{
+    const bool overdraw = ( options.overdrawThreshold > 0.0f );
+
+    const uint32_t surfaceCount = static_cast<uint32_t>( imported.indexBuffers.size() );
+    std::vector<vertexCacheStats_t> before( surfaceCount );
+    std::vector<vertexCacheStats_t> cached( surfaceCount );
+    std::vector<vertexCacheStats_t> after( surfaceCount );
+    std::vector<size_t> clusterCounts( surfaceCount, 0 );
+    ParallelFor( surfaceCount, options.threadCount, [&]( const uint32_t surfaceIx )
+    {
+        indexBuffer_t& indices = imported.indexBuffers[ surfaceIx ];
+        before[ surfaceIx ] = AnalyzeVertexCache( indices.data(), indices.size() );
+
+        std::vector<uint32_t> optimized( indices.size() );
+        OptimizeVertexCache( optimized.data(), indices.data(), indices.size() );
+        cached[ surfaceIx ] = AnalyzeVertexCache( optimized.data(), optimized.size() );
+        if ( overdraw )
+        {
+            clusterCounts[ surfaceIx ] = OptimizeOverdraw( indices.data(), optimized.data(), optimized.size(), imported.vertices.data(), options.overdrawThreshold );
+        }
+        else
         {
-            it->uv[ 0 ] = ( it->uv[ 0 ] > 1.0 ) ? ( it->uv[ 0 ] - floor( it->uv[ 0 ] ) ) : it->uv[ 0 ];
-            it->uv[ 1 ] = ( it->uv[ 1 ] > 1.0 ) ? ( it->uv[ 1 ] - floor( it->uv[ 1 ] ) ) : it->uv[ 1 ];
+            std::copy( optimized.begin(), optimized.end(), indices.begin() );
+        }
+
+        after[ surfaceIx ] = AnalyzeVertexCache( indices.data(), indices.size() );
+    } );
+
+    vertexCacheStats_t totalBefore = {};
+    vertexCacheStats_t totalCached = {};
+    vertexCacheStats_t totalAfter = {};
+    size_t clusterCount = 0;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        totalBefore.Add( before[ surfaceIx ] );
+        totalCached.Add( cached[ surfaceIx ] );
+        totalAfter.Add( after[ surfaceIx ] );
+        clusterCount += clusterCounts[ surfaceIx ];
+    }
+    std::cout << "  vertex cache: ACMR " << totalBefore.Acmr() << " -> " << totalCached.Acmr();
+    std::cout << ", ATVR " << totalBefore.Atvr() << " -> " << totalCached.Atvr() << "\n";
+    if ( overdraw )
+    {
+        std::cout << "  overdraw: " << clusterCount << " clusters, ACMR " << totalCached.Acmr() << " -> " << totalAfter.Acmr() << "\n";
+    }
+}
+
+
+// Renumbers the shared VB by first use across all surfaces in draw order, so each
+// surface reads a mostly contiguous, ascending run of vertices
+static void OptimizeVertexFetch( importedModel_t& imported, const convertOptions_t& options )
+{
+    std::vector<vertex_t>& vertices = imported.vertices;
+    const uint32_t vertexCount = static_cast<uint32_t>( vertices.size() );
+    const uint32_t surfaceCount = static_cast<uint32_t>( imported.indexBuffers.size() );
+
+    vertexFetchStats_t before = {};
+    std::vector<uint32_t> remap( vertexCount, NoVertex );
+    uint32_t nextVertex = 0;
+    for ( const indexBuffer_t& indices : imported.indexBuffers )
+    {
+        before.Add( AnalyzeVertexFetch( indices.data(), indices.size(), sizeof( vertex_t ) ) );
+        nextVertex = BuildVertexFetchRemap( remap.data(), indices.data(), indices.size(), nextVertex );
+    }
+    // Unreferenced vertices keep their relative order at the end
+    for ( uint32_t& newIx : remap )
+    {
+        newIx = ( newIx == NoVertex ) ? nextVertex++ : newIx;
+    }
 
-            it->uv[ 0 ] = Saturate( it->uv[ 0 ] );
-            it->uv[ 1 ] = Saturate( it->uv[ 1 ] );
+    std::vector<vertex_t> reordered( vertexCount );
+    for ( uint32_t oldIx = 0; oldIx < vertexCount; ++oldIx )
+    {
+        reordered[ remap[ oldIx ] ] = vertices[ oldIx ];
+    }
+    vertices.swap( reordered );
 
-            it->uv[ 1 ] = 1.0 - it->uv[ 1 ];
+    std::vector<vertexFetchStats_t> after( surfaceCount );
+    ParallelFor( surfaceCount, options.threadCount, [&]( const uint32_t surfaceIx )
+    {
+        indexBuffer_t& indices = imported.indexBuffers[ surfaceIx ];
+        for ( uint32_t& index : indices )
+        {
+            index = remap[ index ];
         }
+        after[ surfaceIx ] = AnalyzeVertexFetch( indices.data(), indices.size(), sizeof( vertex_t ) );
+    } );
+
+    vertexFetchStats_t totalAfter = {};
+    for ( const vertexFetchStats_t& surfaceAfter : after )
+    {
+        totalAfter.Add( surfaceAfter );
     }
+    std::cout << "  vertex fetch: overfetch " << before.Overfetch() << " -> " << totalAfter.Overfetch() << "\n";
+}
 
-    /////////////////////////////////////////////
-    //                                         //
-    // Construct final object representation   //
-    //                                         //
-    /////////////////////////////////////////////
 
-    const uint32_t modelIx = rm.AllocModel();
-    Model* model = rm.GetModel( modelIx );
+// Reorders index buffers ahead of CreateModel() or StoreModelMapped(): vertex cache
+// order, then overdraw clusters on top of it, then the VB in the resulting fetch
+// order. Surfaces are independent, so each runs on its own worker.
+void OptimizeSurfaces( importedModel_t& imported, const convertOptions_t& options )
+{
+    const bool overdraw = ( options.overdrawThreshold > 0.0f );
+    if ( options.optimizeVertexCache || overdraw )
+    {
+        OptimizeTriangleOrder( imported, options );
+    }
+    if ( options.optimizeVertexFetch )
+    {
+        OptimizeVertexFetch( imported, options );
+    }
+}
 
+
+void StoreMaterials( const std::string& path, std::vector<tinyobj::material_t>& materials, ResourceManager& rm )
+{
     const uint32_t materialCount = materials.size();
     for ( uint32_t i = 0; i < materialCount; ++i )
     {
@@ -273,6 +500,36 @@ uint32_t LoadModel( const std::string& path, ResourceManager& rm )
 
         rm.StoreMaterialCopy( m );
     }
+}
+
+
+uint32_t CreateModel( const std::string& path, importedModel_t& imported, ResourceManager& rm )
+{
+    std::vector<tinyobj::material_t>& materials = imported.materials;
+    std::vector<vertex_t>& uniqueVertices = imported.vertices;
+    std::vector<indexBuffer_t>& indexBuffers = imported.indexBuffers;
+
+    std::string materialName = "";
+    if( materials.size() )
+    {
+        materialName = materials[ 0 ].name;
+    }
+
+    const uint32_t shapeCount = indexBuffers.size();
+
+    // Normalize UVs to [0, 1]
+    NormalizeUVs( uniqueVertices.data(), uniqueVertices.size() );
+
+    /////////////////////////////////////////////
+    //                                         //
+    // Construct final object representation   //
+    //                                         //
+    /////////////////////////////////////////////
+
+    const uint32_t modelIx = rm.AllocModel();
+    Model* model = rm.GetModel( modelIx );
+
+    StoreMaterials( path, materials, rm );
 
     // Build VB and IB
     // VB is shared while IB is shared but partitioned by shape
@@ -280,8 +537,7 @@ uint32_t LoadModel( const std::string& path, ResourceManager& rm )
         model->surfs.resize( shapeCount );
 
         uint32_t vbOffset = rm.GetVbOffset();
-        const uint32_t vertexCnt = uniqueVertices.size();
-        for ( int32_t i = 0; i < vertexCnt; ++i )
+        for ( size_t i = 0; i < uniqueVertices.size(); ++i )
         {
             rm.AddVertex( uniqueVertices[ i ] );
         }
@@ -307,15 +563,7 @@ uint32_t LoadModel( const std::string& path, ResourceManager& rm )
             }
             surf.ibEnd = rm.GetIbOffset();
 
-            // Intentionally does not support per-vertex materials
-            if( shapes[ shapeIx ].mesh.material_ids.size() > 0 )
-            {
-                surf.materialId = shapes[ shapeIx ].mesh.material_ids[ 0 ];
-            }
-            else
-            {
-                surf.materialId = -1;
-            }
+            surf.materialId = imported.materialIds[ shapeIx ];
         }
     }
 
@@ -323,16 +571,521 @@ uint32_t LoadModel( const std::string& path, ResourceManager& rm )
 }
 
 
-int main()
+uint32_t LoadModel( const std::string& path, ResourceManager& rm, const convertOptions_t& options )
 {
+    if ( options.memoryLimit > 0 )
+    {
+        // The ResourceManager holds the whole model, so only mapped models can be bounded
+        throw std::runtime_error( "Out-of-core conversion writes mapped models only" );
+    }
+
+    importedModel_t imported;
+    if ( options.streamImport )
+    {
+        ImportObjStreamed( path, options, imported );
+    }
+    else
+    {
+        ImportObj( path, options, imported );
+    }
+    OptimizeSurfaces( imported, options );
+    return CreateModel( path, imported, rm );
+}
+
+
+void ConvertModelMapped( const std::string& srcPath, const std::string& dstPath, const convertOptions_t& options )
+{
+    if ( options.memoryLimit > 0 )
+    {
+        ConvertModelOutOfCore( srcPath, dstPath, options );
+    }
+    else
+    {
+        importedModel_t imported;
+        if ( options.streamImport )
+        {
+            ImportObjStreamed( srcPath, options, imported );
+        }
+        else
+        {
+            ImportObj( srcPath, options, imported );
+        }
+        NormalizeUVs( imported.vertices.data(), imported.vertices.size() );
+        OptimizeSurfaces( imported, options );
+
+        StoreModelMapped( dstPath, srcPath, imported, options );
+    }
+
+    // Load back through the mapping so a bad file is caught here and not at runtime
+    MappedModel model;
+    std::string err;
+    if ( !model.Open( dstPath, &err, MDL_OPEN_VERIFY ) )
+    {
+        throw std::runtime_error( err );
+    }
+    const size_t vertexBytes = ( model.GetPackedVertices() != nullptr ) ? sizeof( mdlPackedVertex_t ) : sizeof( vertex_t );
+    std::cout << "  " << model.GetVertexCount() << " vertices, " << model.GetIndexCount() << " indices, " << model.GetSurfaceCount() << " surfaces, ";
+    std::cout << ( model.GetVertexCount() * vertexBytes ) << " vertex bytes\n";
+}
+
+
+static rgbTuplef_t MdlColorToRGB( const float color[ 3 ] )
+{
+    rgbTuplef_t rgb;
+    rgb.r = color[ 0 ];
+    rgb.g = color[ 1 ];
+    rgb.b = color[ 2 ];
+    return rgb;
+}
+
+
+// Mapped counterpart of LoadModelBin(). Surfaces decode in parallel into ranges
+// laid out up front by LoadSurfaces(), and textures load in parallel, one per
+// material. The RM only appends, so the results are added in order at the end.
+static uint32_t CreateModelMapped( const MappedModel& mapped, ResourceManager& rm, const convertOptions_t& options,
+                                   const std::function<bool( const char* colorMap, Image<Color>& image )>& loadImage )
+{
+    std::string err;
+    const uint32_t materialCount = mapped.GetMaterialCount();
+    const mdlMaterial_t* materials = mapped.GetMaterials();
+    std::vector<Image<Color>> images( materialCount );
+    std::vector<uint8_t> textured( materialCount, 0 );
+    ParallelFor( materialCount, options.threadCount, [&]( const uint32_t i )
+    {
+        if ( materials[ i ].colorMap[ 0 ] != '\0' )
+        {
+            textured[ i ] = loadImage( materials[ i ].colorMap, images[ i ] ) ? 1 : 0;
+        }
+    } );
+
+    const uint32_t surfaceCount = mapped.GetSurfaceCount();
+    std::vector<uint32_t> surfaceIds( surfaceCount );
+    for ( uint32_t i = 0; i < surfaceCount; ++i )
+    {
+        surfaceIds[ i ] = i;
+    }
+    mdlSurfaceSet_t set;
+    if ( !mapped.LoadSurfaces( surfaceIds.data(), surfaceCount, set, &err ) )
+    {
+        throw std::runtime_error( err );
+    }
+
+    for ( uint32_t i = 0; i < materialCount; ++i )
+    {
+        const mdlMaterial_t& material = materials[ i ];
+        material_t m;
+
+        memset( m.name, 0, material_t::BufferSize );
+        strcpy_s( m.name, material_t::BufferSize, material.name );
+        m.Ni = material.Ni;
+        m.Ns = material.Ns;
+        m.Ka = MdlColorToRGB( material.Ka );
+        m.Ke = MdlColorToRGB( material.Ke );
+        m.Kd = MdlColorToRGB( material.Kd );
+        m.Ks = MdlColorToRGB( material.Ks );
+        m.Tf = MdlColorToRGB( material.Tf );
+        m.Tr = material.Tr;
+        m.d = material.d;
+        m.illum = material.illum;
+        m.textured = ( textured[ i ] != 0 );
+        m.colorMapId = m.textured ? rm.StoreImageCopy( images[ i ] ) : 0;
+        m.normalMapId = 0;
+
+        rm.StoreMaterialCopy( m );
+    }
+
+    const uint32_t modelIx = rm.AllocModel();
+    Model* model = rm.GetModel( modelIx );
+    model->name = mapped.GetName();
+    model->surfs.resize( surfaceCount );
+
+    const uint32_t vbOffset = rm.GetVbOffset();
+    for ( const vertex_t& vertex : set.vertices )
+    {
+        rm.AddVertex( vertex );
+    }
+
+    std::vector<uint32_t> widened;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        const mdlSurface_t& src = set.surfaces[ surfaceIx ];
+        surface_t& surf = model->surfs[ surfaceIx ];
+
+        surf.vb = rm.GetVB();
+        surf.ib = rm.GetIB();
+        surf.vbOffset = vbOffset + src.vbOffset;
+        surf.vbEnd = surf.vbOffset + src.vbCount;
+
+        const uint32_t* indices = set.indices.data() + src.ibOffset;
+        if ( ( src.flags & MDL_SURFACE_FLAG_INDEX16 ) != 0 )
+        {
+            widened.assign( set.indices16.begin() + src.ibOffset, set.indices16.begin() + src.ibOffset + src.ibCount );
+            indices = widened.data();
+        }
+
+        surf.ibOffset = rm.GetIbOffset();
+        for ( uint32_t i = 0; i < src.ibCount; ++i )
+        {
+            rm.AddIndex( surf.vbOffset + indices[ i ] );
+        }
+        surf.ibEnd = rm.GetIbOffset();
+
+        surf.materialId = src.materialId;
+    }
+
+    return modelIx;
+}
+
+
+uint32_t LoadModelMapped( const std::string& path, ResourceManager& rm, const convertOptions_t& options )
+{
+    MappedModel mapped;
+    std::string err;
+    if ( !mapped.Open( path, &err, MDL_OPEN_DEFER_DECODE, options.threadCount ) )
+    {
+        throw std::runtime_error( err );
+    }
+    return CreateModelMapped( mapped, rm, options, []( const char* colorMap, Image<Color>& image )
+    {
+        return LoadImage( TexturePath + colorMap, image );
+    } );
+}
+
+
+// Adds a converted .mdl and the textures its materials name. Textures are shared
+// by name across the pack, so ones already there are not added again.
+void AddModelToPack( PackWriter& pack, const std::string& name, const std::string& mdlPath )
+{
+    pack.AddFile( name, PACK_ENTRY_MODEL, mdlPath );
+
+    MappedModel mapped;
+    std::string err;
+    if ( !mapped.Open( mdlPath, &err, MDL_OPEN_DEFER_DECODE ) )
+    {
+        throw std::runtime_error( err );
+    }
+    for ( uint32_t i = 0; i < mapped.GetMaterialCount(); ++i )
+    {
+        const char* colorMap = mapped.GetMaterials()[ i ].colorMap;
+        if ( ( colorMap[ 0 ] == '\0' ) || pack.Contains( colorMap, PACK_ENTRY_TEXTURE ) )
+        {
+            continue;
+        }
+        MappedFile image;
+        if ( !image.Open( TexturePath + colorMap ) )
+        {
+            std::cout << "Failed to load texture image!" << std::endl;
+            continue;
+        }
+        pack.Add( colorMap, PACK_ENTRY_TEXTURE, image.GetData(), static_cast<size_t>( image.GetSize() ) );
+    }
+}
+
+
+// The model opens in place inside the pack's mapping. Textures come from the pack
+// too, falling back to TexturePath for any that were missing when it was built.
+uint32_t LoadModelPacked( const PackFile& pack, const std::string& name, ResourceManager& rm, const convertOptions_t& options )
+{
+    const packEntry_t* entry = pack.Find( name, PACK_ENTRY_MODEL );
+    if ( entry == nullptr )
+    {
+        throw std::runtime_error( "No model [" + name + "] in pack" );
+    }
+
+    MappedModel mapped;
+    std::string err;
+    if ( !mapped.Open( pack.GetData( *entry ), entry->size, &err, MDL_OPEN_DEFER_DECODE, options.threadCount ) )
+    {
+        throw std::runtime_error( err );
+    }
+    return CreateModelMapped( mapped, rm, options, [&]( const char* colorMap, Image<Color>& image )
+    {
+        const packEntry_t* texture = pack.Find( colorMap, PACK_ENTRY_TEXTURE );
+        if ( texture == nullptr )
+        {
+            return LoadImage( TexturePath + colorMap, image );
+        }
+        return LoadImageFromMemory( pack.GetData( *texture ), static_cast<size_t>( texture->size ), image );
+    } );
+}
+
+
+// The whole of text as a decimal count. False on signs, trailing text or overflow.
+static bool ParseCount( const char* text, uint64_t& value )
+{
+    if ( !isdigit( static_cast<unsigned char>( text[ 0 ] ) ) )
+    {
+        return false;
+    }
+    char* end = nullptr;
+    errno = 0;
+    value = strtoull( text, &end, 10 );
+    return ( *end == '\0' ) && ( errno == 0 );
+}
+
+
+// The whole of text as a finite float no smaller than minValue
+static bool ParseFloat( const char* text, const float minValue, float& value )
+{
+    char* end = nullptr;
+    value = strtof( text, &end );
+    return ( end != text ) && ( *end == '\0' ) && std::isfinite( value ) && ( value >= minValue );
+}
+
+
+// Comma separated triangle ratios, each in ( 0, 1 ]. False on an empty or bad item.
+static bool ParseLodRatios( const std::string& list, std::vector<float>& ratios )
+{
+    ratios.clear();
+    for ( size_t begin = 0; begin <= list.size(); )
+    {
+        const size_t end = std::min( list.find( ',', begin ), list.size() );
+        const std::string item = list.substr( begin, end - begin );
+
+        float ratio = 0.0f;
+        if ( !ParseFloat( item.c_str(), 0.0f, ratio ) || ( ratio == 0.0f ) || ( ratio > 1.0f ) )
+        {
+            return false;
+        }
+        ratios.push_back( ratio );
+        begin = end + 1;
+    }
+    return true;
+}
+
+
+int main( int argc, char** argv )
+{
+    convertOptions_t options;
+    std::string benchModel;
+
+    for ( int argIx = 1; argIx < argc; ++argIx )
+    {
+        const std::string arg = argv[ argIx ];
+        // No option starts with a digit, so -0.5 is a (bad) value and not the next option
+        const char* next = ( ( argIx + 1 ) < argc ) ? argv[ argIx + 1 ] : nullptr;
+        const bool hasValue = ( next != nullptr ) && ( ( next[ 0 ] != '-' ) || isdigit( static_cast<unsigned char>( next[ 1 ] ) ) || ( next[ 1 ] == '.' ) );
+
+        if ( arg == "-bench" )
+        {
+            benchModel = hasValue ? argv[ ++argIx ] : "test.obj";
+        }
+        else if ( arg == "-stream" )
+        {
+            options.streamImport = true;
+        }
+        else if ( arg == "-mmap" )
+        {
+            options.mappedParse = true;
+        }
+        else if ( arg == "-mapped" )
+        {
+            options.mappedModel = true;
+        }
+        else if ( arg == "-quantize" )
+        {
+            options.quantizeVertices = true;
+        }
+        else if ( arg == "-encodeIndices" )
+        {
+            options.encodeIndices = true;
+        }
+        else if ( arg == "-encodeVertices" )
+        {
+            options.encodeVertices = true;
+        }
+        else if ( arg == "-surfaceRanges" )
+        {
+            options.surfaceRanges = true;
+        }
+        else if ( arg == "-index16" )
+        {
+            options.index16 = true;
+        }
+        else if ( arg == "-lz" )
+        {
+            options.compressSections = true;
+        }
+        else if ( arg == "-vcache" )
+        {
+            options.optimizeVertexCache = true;
+        }
+        else if ( arg == "-overdraw" )
+        {
+            // Below 1 no cluster ever cuts, and 0 would turn the pass off
+            options.overdrawThreshold = 1.05f;
+            if ( hasValue && !ParseFloat( argv[ ++argIx ], 1.0f, options.overdrawThreshold ) )
+            {
+                std::cout << "Bad -overdraw threshold: " << argv[ argIx ] << ", expected a finite ACMR growth factor >= 1 like 1.05" << std::endl;
+                return 1;
+            }
+        }
+        else if ( arg == "-vfetch" )
+        {
+            options.optimizeVertexFetch = true;
+        }
+        else if ( arg == "-meshlets" )
+        {
+            options.buildMeshlets = true;
+        }
+        else if ( arg == "-lod" )
+        {
+            // Comma separated, e.g. -lod 0.5,0.25,0.125
+            const std::string ratios = hasValue ? argv[ ++argIx ] : "0.5,0.25,0.125";
+            if ( !ParseLodRatios( ratios, options.lodRatios ) )
+            {
+                std::cout << "Bad -lod ratios: " << ratios << ", expected values in ( 0, 1 ] like 0.5,0.25" << std::endl;
+                return 1;
+            }
+        }
+        else if ( ( arg == "-lodError" ) && hasValue )
+        {
+            if ( !ParseFloat( argv[ ++argIx ], 0.0f, options.lodMaxError ) )
+            {
+                std::cout << "Bad -lodError: " << argv[ argIx ] << ", expected a finite value >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else if ( arg == "-mt" )
+        {
+            options.parallelWeld = true;
+        }
+        else if ( ( arg == "-pack" ) && hasValue )
+        {
+            options.packPath = argv[ ++argIx ];
+        }
+        else if ( ( arg == "-outOfCore" ) && hasValue )
+        {
+            // Megabytes. Only mapped models can be written out of core: StoreModelBin
+            // serializes a ResourceManager, which would hold the whole model.
+            uint64_t megabytes = 0;
+            if ( !ParseCount( argv[ ++argIx ], megabytes ) || ( megabytes == 0 ) || ( megabytes > ( UINT64_MAX / ( 1024 * 1024 ) ) ) )
+            {
+                std::cout << "Bad -outOfCore limit: " << argv[ argIx ] << ", expected a size in megabytes > 0" << std::endl;
+                return 1;
+            }
+            options.memoryLimit = megabytes * 1024 * 1024;
+        }
+        else if ( ( arg == "-spillDir" ) && hasValue )
+        {
+            options.spillPath = argv[ ++argIx ];
+        }
+        else if ( ( arg == "-threads" ) && hasValue )
+        {
+            uint64_t threadCount = 0;
+            if ( !ParseCount( argv[ ++argIx ], threadCount ) || ( threadCount > UINT32_MAX ) )
+            {
+                std::cout << "Bad -threads count: " << argv[ argIx ] << ", expected 0 for every hardware thread or a thread count" << std::endl;
+                return 1;
+            }
+            options.threadCount = static_cast<uint32_t>( threadCount );
+        }
+        else if ( ( arg == "-posEps" ) && hasValue )
+        {
+            if ( !ParseFloat( argv[ ++argIx ], 0.0f, options.weldTolerance.position ) )
+            {
+                std::cout << "Bad -posEps tolerance: " << argv[ argIx ] << ", expected a finite value >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else if ( ( arg == "-normalEps" ) && hasValue )
+        {
+            if ( !ParseFloat( argv[ ++argIx ], 0.0f, options.weldTolerance.normal ) )
+            {
+                std::cout << "Bad -normalEps tolerance: " << argv[ argIx ] << ", expected a finite value >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else if ( ( arg == "-uvEps" ) && hasValue )
+        {
+            if ( !ParseFloat( argv[ ++argIx ], 0.0f, options.weldTolerance.uv ) )
+            {
+                std::cout << "Bad -uvEps tolerance: " << argv[ argIx ] << ", expected a finite value >= 0" << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            std::cout << "Unknown option: " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    if ( benchModel.size() > 0 )
+    {
+        BenchmarkWeld( benchModel, options );
+        BenchmarkParse( benchModel, options );
+        BenchmarkFloatParse( benchModel );
+        BenchmarkModelLoad( benchModel, options );
+        BenchmarkIndexCodec( benchModel, options );
+        BenchmarkVertexCodec( benchModel, options );
+        BenchmarkParallelLoad( benchModel, options );
+        BenchmarkVertexCache( benchModel, options );
+        return 0;
+    }
+
     //std::vector<std::string> models = { "12140_Skull_v3_L2", "sphere", "box", "rx-7 veilside fortune" };
 
     std::vector<std::string> models = { "911_scene" };
 
+    if ( ( options.memoryLimit > 0 ) && !options.mappedModel )
+    {
+        std::cout << "-outOfCore requires -mapped, there is no out-of-core StoreModelBin output" << std::endl;
+        return 1;
+    }
+    const char* unsupported = ( options.memoryLimit > 0 ) ? OutOfCoreUnsupportedOption( options ) : nullptr;
+    if ( unsupported != nullptr )
+    {
+        std::cout << "-outOfCore does not support " << unsupported << std::endl;
+        return 1;
+    }
+    if ( !options.packPath.empty() && !options.mappedModel )
+    {
+        std::cout << "-pack requires -mapped" << std::endl;
+        return 1;
+    }
+
+    PackWriter pack;
+    if ( !options.packPath.empty() )
+    {
+        pack.Open( options.packPath );
+    }
+
     for( uint32_t i = 0; i < models.size(); ++i )
     {
         std::cout << "Converting: " << models[ i ] << "...\n";
 
+        std::string& modelName = models[ i ];
+
+        if ( options.mappedModel )
+        {
+            try
+            {
+                ConvertModelMapped( ModelPath + modelName + ".obj", ConvertedPath + modelName + ".mdl", options );
+            }
+            catch ( const std::exception& e )
+            {
+                // Bad or oversized input, or an I/O failure; report it rather than terminate
+                std::cout << "Failed to convert " << modelName << ": " << e.what() << std::endl;
+                return 1;
+            }
+
+            // Loading into a ResourceManager would undo the memory limit
+            if ( options.memoryLimit == 0 )
+            {
+                ResourceManager mappedRM;
+                mappedRM.PushVB( mappedRM.AllocVB() );
+                mappedRM.PushIB( mappedRM.AllocIB() );
+                LoadModelMapped( ConvertedPath + modelName + ".mdl", mappedRM, options );
+            }
+
+            if ( pack.IsOpen() )
+            {
+                AddModelToPack( pack, modelName, ConvertedPath + modelName + ".mdl" );
+            }
+            continue;
+        }
+
         ResourceManager modelRM;
 
         uint32_t vb = modelRM.AllocVB();
@@ -341,12 +1094,34 @@ int main()
         modelRM.PushVB( vb );
         modelRM.PushIB( ib );
 
-        std::string& modelName = models[ i ];
-
-        uint32_t srcModelId = LoadModel( ModelPath + modelName + ".obj", modelRM );
+        uint32_t srcModelId = LoadModel( ModelPath + modelName + ".obj", modelRM, options );
 
         StoreModelBin( ConvertedPath + modelName + ".mdl", modelRM, srcModelId );
         uint32_t modelIx = LoadModelBin( ConvertedPath + modelName + ".mdl", modelRM );
         // StoreModelObj( "test.obj", modelRM, modelIx );
     }
+
+    if ( pack.IsOpen() )
+    {
+        pack.Finish();
+
+        // Load back through the pack, as the per-file path does above
+        PackFile packFile;
+        std::string err;
+        if ( !packFile.Open( options.packPath, &err ) )
+        {
+            throw std::runtime_error( err );
+        }
+        ResourceManager packRM;
+        packRM.PushVB( packRM.AllocVB() );
+        packRM.PushIB( packRM.AllocIB() );
+        for ( const std::string& modelName : models )
+        {
+            if ( options.memoryLimit == 0 )
+            {
+                LoadModelPacked( packFile, modelName, packRM, options );
+            }
+        }
+        std::cout << "Packed " << packFile.GetEntryCount() << " entries into " << options.packPath << "\n";
+    }
 }
\ No newline at end of file
@@ -0,0 +1,92 @@
+#include <stdlib.h>
+#include <new>
+#include <algorithm>
+#include "arena.h"
+
+Arena::Arena( const size_t blockSize )
+{
+    blocks = nullptr;
+    cursor = nullptr;
+    end = nullptr;
+    this->blockSize = blockSize;
+    usedBytes = 0;
+    reservedBytes = 0;
+}
+
+
+Arena::~Arena()
+{
+    Release();
+}
+
+
+Arena::block_t* Arena::NewBlock( const size_t size )
+{
+    block_t* block = static_cast<block_t*>( malloc( sizeof( block_t ) + size ) );
+    if ( block == nullptr )
+    {
+        throw std::bad_alloc();
+    }
+    block->size = size;
+    reservedBytes += size;
+    return block;
+}
+
+
+void* Arena::Allocate( const size_t size, const size_t alignment )
+{
+    usedBytes += size;
+
+    uintptr_t address = ( reinterpret_cast<uintptr_t>( cursor ) + ( alignment - 1 ) ) & ~static_cast<uintptr_t>( alignment - 1 );
+    if ( ( cursor != nullptr ) && ( ( address + size ) <= reinterpret_cast<uintptr_t>( end ) ) )
+    {
+        cursor = reinterpret_cast<uint8_t*>( address + size );
+        return reinterpret_cast<void*>( address );
+    }
+
+    const size_t paddedSize = size + alignment;
+    if ( paddedSize > ( blockSize / 4 ) )
+    {
+        // Large requests get a block of their own behind the current one, so the
+        // space left in the current block is not thrown away.
+        block_t* block = NewBlock( paddedSize );
+        if ( blocks != nullptr )
+        {
+            block->next = blocks->next;
+            blocks->next = block;
+        }
+        else
+        {
+            block->next = nullptr;
+            blocks = block;
+        }
+        address = ( reinterpret_cast<uintptr_t>( block + 1 ) + ( alignment - 1 ) ) & ~static_cast<uintptr_t>( alignment - 1 );
+        return reinterpret_cast<void*>( address );
+    }
+
+    block_t* block = NewBlock( blockSize );
+    block->next = blocks;
+    blocks = block;
+
+    cursor = reinterpret_cast<uint8_t*>( block + 1 );
+    end = cursor + blockSize;
+
+    address = ( reinterpret_cast<uintptr_t>( cursor ) + ( alignment - 1 ) ) & ~static_cast<uintptr_t>( alignment - 1 );
+    cursor = reinterpret_cast<uint8_t*>( address + size );
+    return reinterpret_cast<void*>( address );
+}
+
+
+void Arena::Release()
+{
+    while ( blocks != nullptr )
+    {
+        block_t* next = blocks->next;
+        free( blocks );
+        blocks = next;
+    }
+    cursor = nullptr;
+    end = nullptr;
+    usedBytes = 0;
+    reservedBytes = 0;
+}
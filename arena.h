@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Monotonic allocator for short-lived import state. Allocations are bumped out of
+// large blocks and only released all at once, when the arena is destroyed or
+// Release() is called. Not thread-safe; give each worker its own arena.
+class Arena
+{
+public:
+    static const size_t DefaultBlockSize = 1024 * 1024;
+
+    explicit Arena( const size_t blockSize = DefaultBlockSize );
+    ~Arena();
+
+    Arena( const Arena& ) = delete;
+    Arena& operator=( const Arena& ) = delete;
+
+    void*   Allocate( const size_t size, const size_t alignment );
+    void    Release();
+
+    size_t  GetUsedBytes() const { return usedBytes; }
+    size_t  GetReservedBytes() const { return reservedBytes; }
+
+private:
+    struct block_t
+    {
+        block_t*    next;
+        size_t      size;
+    };
+
+    block_t*    NewBlock( const size_t size );
+
+    block_t*    blocks;
+    uint8_t*    cursor;
+    uint8_t*    end;
+    size_t      blockSize;
+    size_t      usedBytes;
+    size_t      reservedBytes;
+};
@@ -0,0 +1,613 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <string.h>
+#include "converter.h"
+#include "vertexWelder.h"
+#include "parallel.h"
+#include "objParser.h"
+#include "fastFloat.h"
+#include "mappedFile.h"
+#include "modelFile.h"
+#include "indexCodec.h"
+#include "vertexCodec.h"
+#include "vertexQuantizer.h"
+#include "checksum.h"
+#include "meshOptimizer.h"
+#include "benchmark.h"
+
+using benchClock_t = std::chrono::high_resolution_clock;
+
+static double ElapsedMs( const benchClock_t::time_point& start )
+{
+    return std::chrono::duration<double, std::milli>( benchClock_t::now() - start ).count();
+}
+
+
+static bool LoadBenchmarkObj( const std::string& path, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes )
+{
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    if ( !tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, path.c_str(), ModelPath.c_str() ) )
+    {
+        std::cout << "Failed to load benchmark model " << path << ": " << warn << err << std::endl;
+        return false;
+    }
+    return true;
+}
+
+
+void BenchmarkWeld( const std::string& path, const convertOptions_t& options )
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    if ( !LoadBenchmarkObj( path, attrib, shapes ) )
+    {
+        return;
+    }
+
+    std::vector<vertex_t> stream;
+    for ( const tinyobj::shape_t& shape : shapes )
+    {
+        for ( const auto& index : shape.mesh.indices )
+        {
+            stream.push_back( TinyObjVertex( attrib, index ) );
+        }
+    }
+
+    // Reference: the original linear search weld. It is quadratic, so it is
+    // skipped on anything much bigger than test.obj.
+    const size_t linearLimit = 250000;
+    const bool runLinear = ( stream.size() <= linearLimit );
+
+    std::vector<uint32_t> linearIndices;
+    std::vector<vertex_t> linearVertices;
+    linearIndices.reserve( runLinear ? stream.size() : 0 );
+
+    const size_t linearCount = runLinear ? stream.size() : 0;
+
+    benchClock_t::time_point start = benchClock_t::now();
+    for ( size_t i = 0; i < linearCount; ++i )
+    {
+        const vertex_t& vert = stream[ i ];
+        auto it = std::find( linearVertices.begin(), linearVertices.end(), vert );
+        if ( it == linearVertices.end() )
+        {
+            linearIndices.push_back( static_cast<uint32_t>( linearVertices.size() ) );
+            linearVertices.push_back( vert );
+        }
+        else
+        {
+            linearIndices.push_back( static_cast<uint32_t>( std::distance( linearVertices.begin(), it ) ) );
+        }
+    }
+    const double linearMs = ElapsedMs( start );
+
+    std::vector<uint32_t> hashIndices;
+    hashIndices.reserve( stream.size() );
+
+    start = benchClock_t::now();
+    VertexWelder welder( attrib.vertices.size() / 3 );
+    for ( const vertex_t& vert : stream )
+    {
+        hashIndices.push_back( welder.Add( vert ) );
+    }
+    const double hashMs = ElapsedMs( start );
+
+    const bool match = !runLinear || ( ( hashIndices == linearIndices ) && ( welder.GetVertexCount() == linearVertices.size() ) );
+
+    std::vector<indexBuffer_t> serialBuffers;
+    VertexWelder serialWelder( attrib.vertices.size() / 3 );
+
+    start = benchClock_t::now();
+    WeldShapes( attrib, shapes, serialWelder, serialBuffers );
+    const double serialShapeMs = ElapsedMs( start );
+
+    std::vector<indexBuffer_t> parallelBuffers;
+    VertexWelder parallelWelder( attrib.vertices.size() / 3 );
+
+    start = benchClock_t::now();
+    WeldShapesParallel( attrib, shapes, parallelWelder, parallelBuffers, options.threadCount );
+    const double parallelShapeMs = ElapsedMs( start );
+
+    const std::vector<vertex_t>& serialVertices = serialWelder.GetVertices();
+    const std::vector<vertex_t>& parallelVertices = parallelWelder.GetVertices();
+    const bool parallelMatch = ( serialBuffers == parallelBuffers ) &&
+        ( serialVertices.size() == parallelVertices.size() ) &&
+        std::equal( serialVertices.begin(), serialVertices.end(), parallelVertices.begin() );
+
+    std::cout << "Weld benchmark: " << path << "\n";
+    std::cout << "  indices:  " << stream.size() << ", unique vertices: " << welder.GetVertexCount() << "\n";
+    if ( runLinear )
+    {
+        std::cout << "  linear:   " << linearMs << " ms\n";
+        std::cout << "  hashed:   " << hashMs << " ms\n";
+        std::cout << "  speedup:  " << ( linearMs / std::max( hashMs, 0.001 ) ) << "x\n";
+        std::cout << "  outputs " << ( match ? "match" : "DIFFER" ) << "\n";
+    }
+    else
+    {
+        std::cout << "  linear:   skipped (more than " << linearLimit << " indices)\n";
+        std::cout << "  hashed:   " << hashMs << " ms\n";
+    }
+    std::cout << "  shapes:   " << shapes.size() << ", threads: " << ResolveThreadCount( options.threadCount ) << "\n";
+    std::cout << "  serial:   " << serialShapeMs << " ms (TinyObjVertex + weld)\n";
+    std::cout << "  parallel: " << parallelShapeMs << " ms (TinyObjVertex + weld)\n";
+    std::cout << "  outputs " << ( parallelMatch ? "match" : "DIFFER" ) << std::endl;
+
+    if ( !options.weldTolerance.IsExact() )
+    {
+        VertexWelder toleranceWelder( attrib.vertices.size() / 3, options.weldTolerance );
+
+        start = benchClock_t::now();
+        for ( const vertex_t& vert : stream )
+        {
+            toleranceWelder.Add( vert );
+        }
+        const double toleranceMs = ElapsedMs( start );
+
+        const double exactCount = static_cast<double>( welder.GetVertexCount() );
+        const double toleranceCount = static_cast<double>( toleranceWelder.GetVertexCount() );
+
+        std::cout << "  tolerance weld (pos " << options.weldTolerance.position << ", normal " << options.weldTolerance.normal << ", uv " << options.weldTolerance.uv << "):\n";
+        std::cout << "    vertices: " << welder.GetVertexCount() << " -> " << toleranceWelder.GetVertexCount();
+        std::cout << " (" << ( 100.0 * ( 1.0 - toleranceCount / exactCount ) ) << "% fewer)\n";
+        std::cout << "    time:     " << toleranceMs << " ms" << std::endl;
+    }
+}
+
+
+static bool SameObj( const tinyobj::attrib_t& attribA, const std::vector<tinyobj::shape_t>& shapesA,
+                     const tinyobj::attrib_t& attribB, const std::vector<tinyobj::shape_t>& shapesB )
+{
+    if ( ( attribA.vertices != attribB.vertices ) || ( attribA.normals != attribB.normals ) || ( attribA.texcoords != attribB.texcoords ) )
+    {
+        return false;
+    }
+    if ( shapesA.size() != shapesB.size() )
+    {
+        return false;
+    }
+    for ( size_t shapeIx = 0; shapeIx < shapesA.size(); ++shapeIx )
+    {
+        const tinyobj::mesh_t& meshA = shapesA[ shapeIx ].mesh;
+        const tinyobj::mesh_t& meshB = shapesB[ shapeIx ].mesh;
+        if ( ( meshA.indices.size() != meshB.indices.size() ) || ( meshA.material_ids != meshB.material_ids ) || ( meshA.num_face_vertices != meshB.num_face_vertices ) )
+        {
+            return false;
+        }
+        for ( size_t i = 0; i < meshA.indices.size(); ++i )
+        {
+            if ( ( meshA.indices[ i ].vertex_index != meshB.indices[ i ].vertex_index ) ||
+                 ( meshA.indices[ i ].normal_index != meshB.indices[ i ].normal_index ) ||
+                 ( meshA.indices[ i ].texcoord_index != meshB.indices[ i ].texcoord_index ) )
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+void BenchmarkParse( const std::string& path, const convertOptions_t& options )
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+
+    benchClock_t::time_point start = benchClock_t::now();
+    if ( !tinyobj::LoadObj( &attrib, &shapes, &materials, &warn, &err, path.c_str(), ModelPath.c_str() ) )
+    {
+        std::cout << "Failed to load benchmark model " << path << ": " << warn << err << std::endl;
+        return;
+    }
+    const double tinyObjMs = ElapsedMs( start );
+
+    std::cout << "Parse benchmark: " << path << "\n";
+    std::cout << "  tinyobj:  " << tinyObjMs << " ms\n";
+
+    const uint32_t maxThreads = ResolveThreadCount( options.threadCount );
+    for ( uint32_t threads = 1; threads <= maxThreads; threads *= 2 )
+    {
+        tinyobj::attrib_t mappedAttrib;
+        std::vector<tinyobj::shape_t> mappedShapes;
+        std::vector<tinyobj::material_t> mappedMaterials;
+
+        start = benchClock_t::now();
+        const bool loaded = LoadObjMapped( &mappedAttrib, &mappedShapes, &mappedMaterials, &warn, &err, path.c_str(), ModelPath.c_str(), threads );
+        const double mappedMs = ElapsedMs( start );
+
+        const bool match = loaded && SameObj( attrib, shapes, mappedAttrib, mappedShapes );
+        std::cout << "  mapped:   " << mappedMs << " ms, " << threads << " thread(s), " << ( tinyObjMs / std::max( mappedMs, 0.001 ) ) << "x, outputs " << ( match ? "match" : "DIFFER" ) << "\n";
+    }
+    std::cout << std::flush;
+}
+
+
+void BenchmarkFloatParse( const std::string& path )
+{
+    MappedFile file;
+    if ( !file.Open( path ) )
+    {
+        std::cout << "Failed to open benchmark model " << path << std::endl;
+        return;
+    }
+
+    const char* data = reinterpret_cast<const char*>( file.GetData() );
+    const char* end = data + file.GetSize();
+
+    // Every numeric token on v, vn and vt lines, with the end of its line
+    std::vector<const char*> tokens;
+    std::vector<const char*> lineEnds;
+    const char* p = data;
+    while ( p < end )
+    {
+        const char* lineEnd = static_cast<const char*>( memchr( p, '\n', end - p ) );
+        if ( lineEnd == nullptr )
+        {
+            lineEnd = end;
+        }
+
+        if ( ( ( lineEnd - p ) > 2 ) && ( p[ 0 ] == 'v' ) )
+        {
+            const char* token = p + ( ( p[ 1 ] == ' ' ) ? 1 : 2 );
+            while ( token < lineEnd )
+            {
+                while ( ( token < lineEnd ) && ( ( *token == ' ' ) || ( *token == '\t' ) || ( *token == '\r' ) ) )
+                {
+                    ++token;
+                }
+                if ( token == lineEnd )
+                {
+                    break;
+                }
+                tokens.push_back( token );
+                lineEnds.push_back( lineEnd );
+                while ( ( token < lineEnd ) && ( *token != ' ' ) && ( *token != '\t' ) && ( *token != '\r' ) )
+                {
+                    ++token;
+                }
+            }
+        }
+        p = lineEnd + 1;
+    }
+
+    const size_t tokenCount = tokens.size();
+    std::vector<float> scalarValues( tokenCount, 0.0f );
+    std::vector<float> fastValues( tokenCount, 0.0f );
+
+    // Repeat so the timings are well above clock resolution on small files
+    const uint32_t passes = 20;
+
+    benchClock_t::time_point start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        for ( size_t i = 0; i < tokenCount; ++i )
+        {
+            const char* tokenEnd = tokens[ i ];
+            while ( ( tokenEnd < lineEnds[ i ] ) && ( *tokenEnd != ' ' ) && ( *tokenEnd != '\t' ) && ( *tokenEnd != '\r' ) )
+            {
+                ++tokenEnd;
+            }
+            double value = 0.0;
+            ParseObjDouble( tokens[ i ], tokenEnd, &value );
+            scalarValues[ i ] = static_cast<float>( value );
+        }
+    }
+    const double scalarMs = ElapsedMs( start ) / passes;
+
+    start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        for ( size_t i = 0; i < tokenCount; ++i )
+        {
+            ParseObjReal( tokens[ i ], lineEnds[ i ], data, end, &fastValues[ i ] );
+        }
+    }
+    const double fastMs = ElapsedMs( start ) / passes;
+
+    // Exactness is bitwise, so -0.0 and 0.0 count as different
+    size_t mismatches = 0;
+    for ( size_t i = 0; i < tokenCount; ++i )
+    {
+        if ( memcmp( &scalarValues[ i ], &fastValues[ i ], sizeof( float ) ) != 0 )
+        {
+            mismatches++;
+        }
+    }
+
+    std::cout << "Float parse benchmark: " << path << ", " << tokenCount << " tokens\n";
+    std::cout << "  scalar:   " << scalarMs << " ms\n";
+    std::cout << "  fast:     " << fastMs << " ms, " << ( scalarMs / std::max( fastMs, 0.001 ) ) << "x, " << mismatches << " mismatches\n";
+    std::cout << std::flush;
+}
+
+
+void BenchmarkModelLoad( const std::string& path, const convertOptions_t& options )
+{
+    const std::string mdlPath = path + ".bench.mdl";
+    const std::string packedPath = path + ".bench.packed.mdl";
+    const std::string lzPath = path + ".bench.lz.mdl";
+    {
+        convertOptions_t mdlOptions = options;
+        mdlOptions.memoryLimit = 0;
+        mdlOptions.quantizeVertices = false;
+        mdlOptions.compressSections = false;
+        ConvertModelMapped( path, mdlPath, mdlOptions );
+        mdlOptions.compressSections = true;
+        ConvertModelMapped( path, lzPath, mdlOptions );
+        mdlOptions.compressSections = false;
+        mdlOptions.quantizeVertices = true;
+        ConvertModelMapped( path, packedPath, mdlOptions );
+    }
+
+    const uint32_t passes = 20;
+
+    // Reference: read the whole file and copy the buffers out, which is what a
+    // serialized loader has to do before the data is usable
+    size_t checksum = 0;
+    benchClock_t::time_point start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        MappedFile file;
+        file.Open( mdlPath );
+        std::vector<uint8_t> bytes( file.GetData(), file.GetData() + file.GetSize() );
+        const mdlHeader_t* header = reinterpret_cast<const mdlHeader_t*>( bytes.data() );
+        const mdlSection_t* sections = reinterpret_cast<const mdlSection_t*>( bytes.data() + header->sectionTableOffset );
+
+        std::vector<vertex_t> vertices;
+        std::vector<uint32_t> indices;
+        for ( uint32_t i = 0; i < header->sectionCount; ++i )
+        {
+            const uint8_t* data = bytes.data() + sections[ i ].offset;
+            if ( sections[ i ].type == MDL_SECTION_VERTICES )
+            {
+                const vertex_t* first = reinterpret_cast<const vertex_t*>( data );
+                vertices.assign( first, first + sections[ i ].count );
+            }
+            else if ( sections[ i ].type == MDL_SECTION_INDICES )
+            {
+                const uint32_t* first = reinterpret_cast<const uint32_t*>( data );
+                indices.assign( first, first + sections[ i ].count );
+            }
+        }
+        checksum += 4 * ( vertices.size() + indices.size() );
+    }
+    const double copyMs = ElapsedMs( start ) / passes;
+
+    start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        MappedModel model;
+        model.Open( mdlPath, nullptr );
+        checksum -= model.GetVertexCount() + model.GetIndexCount();
+    }
+    const double mappedMs = ElapsedMs( start ) / passes;
+
+    start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        MappedModel model;
+        model.Open( mdlPath, nullptr, MDL_OPEN_VERIFY );
+        checksum -= model.GetVertexCount() + model.GetIndexCount();
+    }
+    const double verifiedMs = ElapsedMs( start ) / passes;
+
+    // Packed vertices are decoded to vertex_t on open
+    start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        MappedModel model;
+        model.Open( packedPath, nullptr );
+        checksum -= model.GetVertexCount() + model.GetIndexCount();
+    }
+    const double packedMs = ElapsedMs( start ) / passes;
+
+    // LZ sections are inflated on open
+    start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        MappedModel model;
+        model.Open( lzPath, nullptr );
+        checksum -= model.GetVertexCount() + model.GetIndexCount();
+    }
+    const double lzMs = ElapsedMs( start ) / passes;
+
+    MappedFile mdlFile;
+    MappedFile packedFile;
+    MappedFile lzFile;
+    mdlFile.Open( mdlPath );
+    packedFile.Open( packedPath );
+    lzFile.Open( lzPath );
+    const uint64_t mdlBytes = mdlFile.GetSize();
+    const uint64_t packedBytes = packedFile.GetSize();
+    const uint64_t lzBytes = lzFile.GetSize();
+    mdlFile.Close();
+    packedFile.Close();
+    lzFile.Close();
+
+    remove( mdlPath.c_str() );
+    remove( packedPath.c_str() );
+    remove( lzPath.c_str() );
+
+    // Reading the smaller file then inflating beats reading the raw one while storage is slower than this
+    const double inflateGBps = mdlBytes / std::max( lzMs - mappedMs, 0.0001 ) / 1.0e6;
+    const double breakEvenGBps = inflateGBps * ( 1.0 - static_cast<double>( lzBytes ) / std::max<uint64_t>( mdlBytes, 1 ) );
+
+    std::cout << "Model load benchmark: " << path << ", warm cache\n";
+    std::cout << "  read+copy: " << copyMs << " ms\n";
+    std::cout << "  mapped:    " << mappedMs << " ms, " << ( copyMs / std::max( mappedMs, 0.0001 ) ) << "x, " << mdlBytes << " bytes\n";
+    std::cout << "  verified:  " << verifiedMs << " ms, CRC32C at " << ( mdlBytes / std::max( verifiedMs - mappedMs, 0.0001 ) / 1.0e6 ) << " GB/s";
+    std::cout << ( Crc32cIsHardware() ? ", hardware\n" : ", software\n" );
+    std::cout << "  packed:    " << packedMs << " ms, " << ( copyMs / std::max( packedMs, 0.0001 ) ) << "x, " << packedBytes << " bytes\n";
+    std::cout << "  lz:        " << lzMs << " ms, " << ( copyMs / std::max( lzMs, 0.0001 ) ) << "x, " << lzBytes << " bytes, ";
+    std::cout << "faster to load below " << breakEvenGBps << " GB/s storage\n";
+    if ( checksum != 0 )
+    {
+        std::cout << "  COUNTS DIFFER\n";
+    }
+    std::cout << std::flush;
+}
+
+
+void BenchmarkIndexCodec( const std::string& path, const convertOptions_t& options )
+{
+    importedModel_t imported;
+    ImportObj( path, options, imported );
+
+    const uint32_t passes = 20;
+
+    size_t indexCount = 0;
+    size_t encodedBytes = 0;
+    size_t mismatches = 0;
+    double decodeMs = 0.0;
+    for ( const indexBuffer_t& indices : imported.indexBuffers )
+    {
+        std::vector<uint8_t> encoded;
+        EncodeIndexBuffer( indices.data(), indices.size(), encoded );
+
+        std::vector<uint32_t> decoded( indices.size() );
+        benchClock_t::time_point start = benchClock_t::now();
+        for ( uint32_t pass = 0; pass < passes; ++pass )
+        {
+            DecodeIndexBuffer( encoded.data(), encoded.size(), decoded.data(), decoded.size() );
+        }
+        decodeMs += ElapsedMs( start ) / passes;
+
+        // Triangles may be rotated, so compare each against all three rotations
+        for ( size_t i = 0; i < indices.size(); i += 3 )
+        {
+            bool found = false;
+            for ( uint32_t r = 0; r < 3; ++r )
+            {
+                found = found || ( ( indices[ i ] == decoded[ i + r ] ) && ( indices[ i + 1 ] == decoded[ i + ( r + 1 ) % 3 ] ) && ( indices[ i + 2 ] == decoded[ i + ( r + 2 ) % 3 ] ) );
+            }
+            mismatches += found ? 0 : 1;
+        }
+
+        indexCount += indices.size();
+        encodedBytes += encoded.size();
+    }
+
+    const double rawBytes = static_cast<double>( indexCount * sizeof( uint32_t ) );
+    std::cout << "Index codec benchmark: " << path << ", " << ( indexCount / 3 ) << " triangles\n";
+    std::cout << "  encoded:  " << ( 3.0 * encodedBytes / std::max<size_t>( indexCount, 1 ) ) << " bytes/triangle, " << ( rawBytes / std::max<size_t>( encodedBytes, 1 ) ) << "x smaller\n";
+    std::cout << "  decode:   " << ( rawBytes / std::max( decodeMs, 0.0001 ) / 1.0e6 ) << " GB/s, " << mismatches << " mismatches\n";
+    std::cout << std::flush;
+}
+
+
+template< class T >
+static void BenchmarkVertexStream( const char* label, const std::vector<T>& vertices )
+{
+    const uint32_t passes = 20;
+    const size_t rawBytes = vertices.size() * sizeof( T );
+
+    std::vector<uint8_t> encoded;
+    EncodeVertexBuffer( vertices.data(), vertices.size(), sizeof( T ), encoded );
+
+    std::vector<T> decoded( vertices.size() );
+    benchClock_t::time_point start = benchClock_t::now();
+    for ( uint32_t pass = 0; pass < passes; ++pass )
+    {
+        DecodeVertexBuffer( encoded.data(), encoded.size(), decoded.data(), decoded.size(), sizeof( T ) );
+    }
+    const double decodeMs = ElapsedMs( start ) / passes;
+    const bool exact = ( memcmp( decoded.data(), vertices.data(), rawBytes ) == 0 );
+
+    // Reading encoded then decoding beats reading raw while storage is slower than this
+    const double decodeGBps = rawBytes / std::max( decodeMs, 0.0001 ) / 1.0e6;
+    const double breakEvenGBps = decodeGBps * ( 1.0 - static_cast<double>( encoded.size() ) / std::max<size_t>( rawBytes, 1 ) );
+
+    std::cout << "  " << label << ( static_cast<double>( rawBytes ) / std::max<size_t>( encoded.size(), 1 ) ) << "x smaller, decode " << decodeGBps << " GB/s, ";
+    std::cout << "faster to load below " << breakEvenGBps << " GB/s storage, " << ( exact ? "exact" : "DIFFERS" ) << "\n";
+}
+
+
+void BenchmarkVertexCodec( const std::string& path, const convertOptions_t& options )
+{
+    importedModel_t imported;
+    ImportObj( path, options, imported );
+    NormalizeUVs( imported.vertices.data(), imported.vertices.size() );
+
+    std::cout << "Vertex codec benchmark: " << path << ", " << imported.vertices.size() << " vertices\n";
+    BenchmarkVertexStream( "vertex_t: ", imported.vertices );
+
+    mdlVertexQuantization_t quantization;
+    std::vector<mdlPackedVertex_t> packed;
+    if ( QuantizeVertices( imported.vertices.data(), imported.vertices.size(), quantization, packed ) )
+    {
+        BenchmarkVertexStream( "packed:   ", packed );
+    }
+    std::cout << std::flush;
+}
+
+
+// Loads an encoded model with per-surface ranges into a ResourceManager, on one
+// thread and then on all of them
+void BenchmarkParallelLoad( const std::string& path, const convertOptions_t& options )
+{
+    const std::string mdlPath = path + ".bench.parallel.mdl";
+    convertOptions_t mdlOptions = options;
+    mdlOptions.memoryLimit = 0;
+    mdlOptions.encodeVertices = true;
+    mdlOptions.encodeIndices = true;
+    mdlOptions.surfaceRanges = true;
+    ConvertModelMapped( path, mdlPath, mdlOptions );
+
+    const uint32_t passes = 10;
+    const uint32_t threadCounts[ 2 ] = { 1, ResolveThreadCount( options.threadCount ) };
+    double loadMs[ 2 ];
+    uint32_t surfaceCount = 0;
+    for ( uint32_t run = 0; run < 2; ++run )
+    {
+        mdlOptions.threadCount = threadCounts[ run ];
+        benchClock_t::time_point start = benchClock_t::now();
+        for ( uint32_t pass = 0; pass < passes; ++pass )
+        {
+            ResourceManager rm;
+            rm.PushVB( rm.AllocVB() );
+            rm.PushIB( rm.AllocIB() );
+            const uint32_t modelIx = LoadModelMapped( mdlPath, rm, mdlOptions );
+            surfaceCount = static_cast<uint32_t>( rm.GetModel( modelIx )->surfs.size() );
+        }
+        loadMs[ run ] = ElapsedMs( start ) / passes;
+    }
+    remove( mdlPath.c_str() );
+
+    std::cout << "Parallel load benchmark: " << path << ", " << surfaceCount << " surfaces\n";
+    std::cout << "  1 thread:   " << loadMs[ 0 ] << " ms\n";
+    std::cout << "  " << threadCounts[ 1 ] << " threads:  " << loadMs[ 1 ] << " ms, " << ( loadMs[ 0 ] / std::max( loadMs[ 1 ], 0.0001 ) ) << "x\n";
+    std::cout << std::flush;
+}
+
+
+void BenchmarkVertexCache( const std::string& path, const convertOptions_t& options )
+{
+    importedModel_t imported;
+    ImportObj( path, options, imported );
+
+    vertexCacheStats_t before = {};
+    vertexCacheStats_t after = {};
+    double optimizeMs = 0.0;
+    for ( const indexBuffer_t& indices : imported.indexBuffers )
+    {
+        std::vector<uint32_t> optimized( indices.size() );
+        benchClock_t::time_point start = benchClock_t::now();
+        OptimizeVertexCache( optimized.data(), indices.data(), indices.size() );
+        optimizeMs += ElapsedMs( start );
+
+        before.Add( AnalyzeVertexCache( indices.data(), indices.size() ) );
+        after.Add( AnalyzeVertexCache( optimized.data(), optimized.size() ) );
+    }
+
+    std::cout << "Vertex cache benchmark: " << path << ", " << before.triangleCount << " triangles\n";
+    std::cout << "  optimize: " << optimizeMs << " ms, " << ( before.triangleCount / std::max( optimizeMs, 0.0001 ) / 1000.0 ) << " Mtri/s\n";
+    std::cout << "  ACMR:     " << before.Acmr() << " -> " << after.Acmr() << "\n";
+    std::cout << "  ATVR:     " << before.Atvr() << " -> " << after.Atvr() << "\n";
+    std::cout << std::flush;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+
+struct convertOptions_t;
+
+void BenchmarkWeld( const std::string& path, const convertOptions_t& options );
+void BenchmarkParse( const std::string& path, const convertOptions_t& options );
+void BenchmarkFloatParse( const std::string& path );
+void BenchmarkModelLoad( const std::string& path, const convertOptions_t& options );
+void BenchmarkIndexCodec( const std::string& path, const convertOptions_t& options );
+void BenchmarkVertexCodec( const std::string& path, const convertOptions_t& options );
+void BenchmarkParallelLoad( const std::string& path, const convertOptions_t& options );
+void BenchmarkVertexCache( const std::string& path, const convertOptions_t& options );
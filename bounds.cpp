@@ -0,0 +1,173 @@
+#include <math.h>
+#include "bounds.h"
+#include "simd.h"
+
+static inline const float* PointAt( const float* points, const size_t stride, const size_t i )
+{
+    return reinterpret_cast<const float*>( reinterpret_cast<const uint8_t*>( points ) + i * stride );
+}
+
+
+static inline float DistanceSquared( const float* a, const float* b )
+{
+    const float dx = a[ 0 ] - b[ 0 ];
+    const float dy = a[ 1 ] - b[ 1 ];
+    const float dz = a[ 2 ] - b[ 2 ];
+    return dx * dx + dy * dy + dz * dz;
+}
+
+
+void ComputeAabb( const float* points, const size_t count, const size_t stride, float min[ 3 ], float max[ 3 ] )
+{
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        min[ axis ] = 0.0f;
+        max[ axis ] = 0.0f;
+    }
+    if ( count == 0 )
+    {
+        return;
+    }
+
+#if defined( CONVERTER_SSE2 )
+    if ( stride >= ( 4 * sizeof( float ) ) )
+    {
+        // Two accumulator pairs so consecutive points don't wait on each other
+        __m128 lo0 = _mm_loadu_ps( points );
+        __m128 hi0 = lo0;
+        __m128 lo1 = lo0;
+        __m128 hi1 = lo0;
+        size_t i = 1;
+        for ( ; ( i + 1 ) < count; i += 2 )
+        {
+            const __m128 a = _mm_loadu_ps( PointAt( points, stride, i ) );
+            const __m128 b = _mm_loadu_ps( PointAt( points, stride, i + 1 ) );
+            lo0 = _mm_min_ps( lo0, a );
+            hi0 = _mm_max_ps( hi0, a );
+            lo1 = _mm_min_ps( lo1, b );
+            hi1 = _mm_max_ps( hi1, b );
+        }
+        if ( i < count )
+        {
+            const __m128 a = _mm_loadu_ps( PointAt( points, stride, i ) );
+            lo0 = _mm_min_ps( lo0, a );
+            hi0 = _mm_max_ps( hi0, a );
+        }
+
+        float lo[ 4 ];
+        float hi[ 4 ];
+        _mm_storeu_ps( lo, _mm_min_ps( lo0, lo1 ) );
+        _mm_storeu_ps( hi, _mm_max_ps( hi0, hi1 ) );
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            min[ axis ] = lo[ axis ];
+            max[ axis ] = hi[ axis ];
+        }
+        return;
+    }
+#endif
+
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        min[ axis ] = points[ axis ];
+        max[ axis ] = points[ axis ];
+    }
+    for ( size_t i = 1; i < count; ++i )
+    {
+        const float* p = PointAt( points, stride, i );
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            min[ axis ] = ( p[ axis ] < min[ axis ] ) ? p[ axis ] : min[ axis ];
+            max[ axis ] = ( p[ axis ] > max[ axis ] ) ? p[ axis ] : max[ axis ];
+        }
+    }
+}
+
+
+void ComputeBoundingSphere( const float* points, const size_t count, const size_t stride, float center[ 3 ], float& radius )
+{
+    center[ 0 ] = 0.0f;
+    center[ 1 ] = 0.0f;
+    center[ 2 ] = 0.0f;
+    radius = 0.0f;
+    if ( count == 0 )
+    {
+        return;
+    }
+
+    size_t minIx[ 3 ] = { 0, 0, 0 };
+    size_t maxIx[ 3 ] = { 0, 0, 0 };
+    for ( size_t i = 1; i < count; ++i )
+    {
+        const float* p = PointAt( points, stride, i );
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            minIx[ axis ] = ( p[ axis ] < PointAt( points, stride, minIx[ axis ] )[ axis ] ) ? i : minIx[ axis ];
+            maxIx[ axis ] = ( p[ axis ] > PointAt( points, stride, maxIx[ axis ] )[ axis ] ) ? i : maxIx[ axis ];
+        }
+    }
+
+    uint32_t seedAxis = 0;
+    float seedDistance = -1.0f;
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        const float distance = DistanceSquared( PointAt( points, stride, minIx[ axis ] ), PointAt( points, stride, maxIx[ axis ] ) );
+        if ( distance > seedDistance )
+        {
+            seedAxis = axis;
+            seedDistance = distance;
+        }
+    }
+
+    const float* a = PointAt( points, stride, minIx[ seedAxis ] );
+    const float* b = PointAt( points, stride, maxIx[ seedAxis ] );
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        center[ axis ] = ( a[ axis ] + b[ axis ] ) * 0.5f;
+    }
+    radius = sqrtf( seedDistance ) * 0.5f;
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        GrowBoundingSphere( PointAt( points, stride, i ), center, radius );
+    }
+}
+
+
+void GrowBoundingSphere( const float point[ 3 ], float center[ 3 ], float& radius )
+{
+    if ( radius < 0.0f )
+    {
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            center[ axis ] = point[ axis ];
+        }
+        radius = 0.0f;
+        return;
+    }
+
+    const float distanceSquared = DistanceSquared( point, center );
+    if ( distanceSquared > ( radius * radius ) )
+    {
+        // Move the center toward the point just far enough that the far side stays put
+        const float distance = sqrtf( distanceSquared );
+        const float k = 0.5f + 0.5f * ( radius / distance );
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            center[ axis ] = center[ axis ] * k + point[ axis ] * ( 1.0f - k );
+        }
+        radius = ( radius + distance ) * 0.5f;
+    }
+}
+
+
+float ComputeEnclosingRadius( const float* points, const size_t count, const size_t stride, const float center[ 3 ] )
+{
+    float radiusSquared = 0.0f;
+    for ( size_t i = 0; i < count; ++i )
+    {
+        const float distanceSquared = DistanceSquared( PointAt( points, stride, i ), center );
+        radiusSquared = ( distanceSquared > radiusSquared ) ? distanceSquared : radiusSquared;
+    }
+    return sqrtf( radiusSquared );
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Axis-aligned box of count points, laid out as for ComputeBoundingSphere(). With
+// SSE2 and a stride of at least four floats, each point is read as one vector, so
+// the float after z must be readable. Zero for no points.
+void    ComputeAabb( const float* points, const size_t count, const size_t stride, float min[ 3 ], float max[ 3 ] );
+
+// Bounding sphere of count points, each three floats at the start of a stride-byte
+// element. Seeded from the most distant pair of axis extremes, then grown to take
+// in each point outside it, so it is within a few percent of the minimal sphere.
+void    ComputeBoundingSphere( const float* points, const size_t count, const size_t stride, float center[ 3 ], float& radius );
+
+// One step of the above for points that arrive one at a time. A negative radius
+// is an empty sphere, which the first point replaces.
+void    GrowBoundingSphere( const float point[ 3 ], float center[ 3 ], float& radius );
+
+// Radius of the smallest sphere around center that holds every point
+float   ComputeEnclosingRadius( const float* points, const size_t count, const size_t stride, const float center[ 3 ] );
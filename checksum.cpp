@@ -0,0 +1,179 @@
+#include <string.h>
+#include "checksum.h"
+#include "simd.h"
+
+static const uint32_t Crc32cPolynomial = 0x82F63B78;   // Reflected
+// Bytes per lane of the interleaved hardware loop. The lanes are joined by
+// advancing a CRC over LaneSize zero bytes, which is a fixed linear map.
+static const size_t LaneSize = 1024;
+
+struct crcTables_t
+{
+    uint32_t    bytes[ 8 ][ 256 ];
+    uint32_t    shift[ 4 ][ 256 ];
+
+    crcTables_t();
+};
+
+
+// Raw CRC update, no pre or post inversion
+static uint32_t UpdateSoftware( const crcTables_t& tables, uint32_t crc, const uint8_t* data, size_t size )
+{
+    while ( size >= 8 )
+    {
+        uint32_t lo;
+        uint32_t hi;
+        memcpy( &lo, data, sizeof( lo ) );
+        memcpy( &hi, data + 4, sizeof( hi ) );
+        lo ^= crc;
+        crc = tables.bytes[ 7 ][ lo & 0xFF ] ^ tables.bytes[ 6 ][ ( lo >> 8 ) & 0xFF ] ^ tables.bytes[ 5 ][ ( lo >> 16 ) & 0xFF ] ^ tables.bytes[ 4 ][ lo >> 24 ] ^
+              tables.bytes[ 3 ][ hi & 0xFF ] ^ tables.bytes[ 2 ][ ( hi >> 8 ) & 0xFF ] ^ tables.bytes[ 1 ][ ( hi >> 16 ) & 0xFF ] ^ tables.bytes[ 0 ][ hi >> 24 ];
+        data += 8;
+        size -= 8;
+    }
+    while ( size > 0 )
+    {
+        crc = tables.bytes[ 0 ][ ( crc ^ *data++ ) & 0xFF ] ^ ( crc >> 8 );
+        --size;
+    }
+    return crc;
+}
+
+
+crcTables_t::crcTables_t()
+{
+    for ( uint32_t i = 0; i < 256; ++i )
+    {
+        uint32_t crc = i;
+        for ( uint32_t bit = 0; bit < 8; ++bit )
+        {
+            crc = ( crc >> 1 ) ^ ( Crc32cPolynomial & ( 0u - ( crc & 1 ) ) );
+        }
+        bytes[ 0 ][ i ] = crc;
+    }
+    for ( uint32_t i = 0; i < 256; ++i )
+    {
+        for ( uint32_t slice = 1; slice < 8; ++slice )
+        {
+            const uint32_t prev = bytes[ slice - 1 ][ i ];
+            bytes[ slice ][ i ] = bytes[ 0 ][ prev & 0xFF ] ^ ( prev >> 8 );
+        }
+    }
+
+    // The shift is linear, so it only has to be run on the 32 basis vectors
+    static const uint8_t zeros[ LaneSize ] = {};
+    uint32_t basis[ 32 ];
+    for ( uint32_t bit = 0; bit < 32; ++bit )
+    {
+        basis[ bit ] = UpdateSoftware( *this, 1u << bit, zeros, LaneSize );
+    }
+    for ( uint32_t byteIx = 0; byteIx < 4; ++byteIx )
+    {
+        for ( uint32_t value = 0; value < 256; ++value )
+        {
+            uint32_t shifted = 0;
+            for ( uint32_t bit = 0; bit < 8; ++bit )
+            {
+                shifted ^= ( ( value >> bit ) & 1 ) ? basis[ 8 * byteIx + bit ] : 0;
+            }
+            shift[ byteIx ][ value ] = shifted;
+        }
+    }
+}
+
+
+static const crcTables_t& GetTables()
+{
+    static const crcTables_t tables;
+    return tables;
+}
+
+
+#if defined( CONVERTER_SSE42 )
+static bool CpuHasSse42()
+{
+#if defined( _MSC_VER )
+    int info[ 4 ];
+    __cpuid( info, 1 );
+    return ( info[ 2 ] & ( 1 << 20 ) ) != 0;
+#else
+    return __builtin_cpu_supports( "sse4.2" ) != 0;
+#endif
+}
+
+
+static inline uint32_t ShiftLane( const crcTables_t& tables, const uint32_t crc )
+{
+    return tables.shift[ 0 ][ crc & 0xFF ] ^ tables.shift[ 1 ][ ( crc >> 8 ) & 0xFF ] ^ tables.shift[ 2 ][ ( crc >> 16 ) & 0xFF ] ^ tables.shift[ 3 ][ crc >> 24 ];
+}
+
+
+// The instruction has a latency of about three cycles and a throughput of one,
+// so three independent lanes keep it busy
+CONVERTER_TARGET_SSE42 static uint32_t UpdateHardware( const crcTables_t& tables, uint32_t crc, const uint8_t* data, size_t size )
+{
+    while ( size >= 3 * LaneSize )
+    {
+        uint64_t a = crc;
+        uint64_t b = 0;
+        uint64_t c = 0;
+        for ( size_t i = 0; i < LaneSize; i += 8 )
+        {
+            uint64_t wordA;
+            uint64_t wordB;
+            uint64_t wordC;
+            memcpy( &wordA, data + i, sizeof( wordA ) );
+            memcpy( &wordB, data + LaneSize + i, sizeof( wordB ) );
+            memcpy( &wordC, data + 2 * LaneSize + i, sizeof( wordC ) );
+            a = _mm_crc32_u64( a, wordA );
+            b = _mm_crc32_u64( b, wordB );
+            c = _mm_crc32_u64( c, wordC );
+        }
+        crc = ShiftLane( tables, ShiftLane( tables, static_cast<uint32_t>( a ) ) ^ static_cast<uint32_t>( b ) ) ^ static_cast<uint32_t>( c );
+        data += 3 * LaneSize;
+        size -= 3 * LaneSize;
+    }
+
+    uint64_t tail = crc;
+    while ( size >= 8 )
+    {
+        uint64_t word;
+        memcpy( &word, data, sizeof( word ) );
+        tail = _mm_crc32_u64( tail, word );
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<uint32_t>( tail );
+    while ( size > 0 )
+    {
+        crc = _mm_crc32_u8( crc, *data++ );
+        --size;
+    }
+    return crc;
+}
+#endif
+
+
+bool Crc32cIsHardware()
+{
+#if defined( CONVERTER_SSE42 )
+    static const bool hardware = CpuHasSse42();
+    return hardware;
+#else
+    return false;
+#endif
+}
+
+
+uint32_t Crc32c( const void* data, const size_t size, const uint32_t crc )
+{
+    const crcTables_t& tables = GetTables();
+    const uint8_t* bytes = static_cast<const uint8_t*>( data );
+#if defined( CONVERTER_SSE42 )
+    if ( Crc32cIsHardware() )
+    {
+        return ~UpdateHardware( tables, ~crc, bytes, size );
+    }
+#endif
+    return ~UpdateSoftware( tables, ~crc, bytes, size );
+}
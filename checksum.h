@@ -0,0 +1,12 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC32C (Castagnoli). Uses the SSE4.2 CRC instruction on three interleaved
+// lanes where the CPU has it, slice-by-8 tables otherwise; both give the same
+// result. Pass a previous result as crc to continue over more data.
+uint32_t    Crc32c( const void* data, const size_t size, const uint32_t crc = 0 );
+
+// True when Crc32c() runs on the hardware path
+bool        Crc32cIsHardware();
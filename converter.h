@@ -0,0 +1,81 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "../GfxCore/geom.h"
+#include "../GfxCore/resourceManager.h"
+#include "tiny_obj_loader.h"
+#include "vertexWelder.h"
+#include "packFile.h"
+
+static const std::string ModelPath = "models/";
+static const std::string TexturePath = "textures/";
+static const std::string ConvertedPath = "models/";
+
+using indexBuffer_t = std::vector<uint32_t>;
+
+struct convertOptions_t
+{
+    bool        parallelWeld = false;   // Weld each shape on its own worker, then merge in shape order
+    uint32_t    threadCount = 0;        // 0 uses every hardware thread
+    weldTolerance_t weldTolerance;      // Opt-in near-equal welding, exact by default
+    bool        streamImport = false;   // Weld faces as the OBJ is parsed instead of materializing shapes
+    bool        mappedParse = false;    // Parse with the memory-mapped, multithreaded front end
+    uint64_t    memoryLimit = 0;        // Convert mapped models out of core within this many bytes, 0 keeps everything in memory. There is no out-of-core StoreModelBin output.
+    std::string spillPath;              // Directory for out-of-core scratch files, empty for the working directory
+    bool        mappedModel = false;    // Write the memory-mappable .mdl layout instead of StoreModelBin
+    bool        quantizeVertices = false; // Pack mapped model vertices into 16 bytes, see mdlPackedVertex_t
+    bool        encodeIndices = false;  // Compress mapped model indices with EncodeIndexBuffer()
+    bool        encodeVertices = false; // Compress mapped model vertices with EncodeVertexBuffer()
+    bool        surfaceRanges = false;  // Give each mapped model surface its own vertex range
+    bool        index16 = false;        // Store 16-bit indices for surfaces that fit, implies surfaceRanges
+    bool        compressSections = false; // LZ compress mapped model geometry in independent blocks
+    std::string packPath;               // Also append mapped models and their textures to this pack
+    bool        optimizeVertexCache = false; // Reorder each surface's triangles for the post-transform vertex cache
+    float       overdrawThreshold = 0.0f; // Also sort vertex cache ordered clusters for overdraw, letting ACMR grow by this factor, at least 1; 0 is off
+    bool        optimizeVertexFetch = false; // Reorder the VB by first use in the final index order
+    bool        buildMeshlets = false;  // Also store mapped model surfaces as meshlets with culling bounds
+    std::vector<float> lodRatios;       // Triangle ratios of the LOD levels stored in mapped models, e.g. 0.5 0.25; empty stores none
+    float       lodMaxError = 0.02f;    // LOD levels stop short of their ratio rather than deviate more than this, relative to the surface extent
+};
+
+// Materials and surface breaks from tinyobj::LoadObjWithCallback, shared by the
+// callback importers. Their state derives from this, and tinyobj's userData is
+// the objSurfaceState_t* so SetObjSurfaceCallbacks()'s callbacks can use it.
+struct objSurfaceState_t
+{
+    std::vector<tinyobj::material_t>    materials;
+    int32_t                             materialId = -1;
+    bool                                surfaceOpen = false;    // Faces go to the last surface; false starts a new one
+};
+
+// Welded geometry and materials, ready to become a Model
+struct importedModel_t
+{
+    std::vector<tinyobj::material_t>    materials;
+    std::vector<vertex_t>               vertices;
+    std::vector<indexBuffer_t>          indexBuffers;   // One per surface
+    std::vector<int32_t>                materialIds;    // One per surface
+};
+
+vertex_t    TinyObjVertex( const tinyobj::attrib_t& attrib, const tinyobj::index_t& index );
+vertex_t    ObjVertex( const tinyobj::real_t* vertices, const size_t vertexCount, const tinyobj::real_t* normals, const size_t normalCount,
+                       const tinyobj::real_t* texcoords, const size_t textureCount, const tinyobj::index_t& index );
+void        ResolveObjIndex( int& index, const size_t count );
+void        WeldShapes( const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, VertexWelder& welder, std::vector<indexBuffer_t>& indexBuffers );
+void        WeldShapesParallel( const tinyobj::attrib_t& attrib, const std::vector<tinyobj::shape_t>& shapes, VertexWelder& welder, std::vector<indexBuffer_t>& indexBuffers, const uint32_t threadCount );
+void        ImportObj( const std::string& path, const convertOptions_t& options, importedModel_t& imported );
+void        SetObjSurfaceCallbacks( tinyobj::callback_t& callbacks );
+void        ImportObjStreamed( const std::string& path, const convertOptions_t& options, importedModel_t& imported );
+uint32_t    CreateModel( const std::string& path, importedModel_t& imported, ResourceManager& rm );
+uint32_t    LoadModel( const std::string& path, ResourceManager& rm, const convertOptions_t& options );
+void        ConvertModelMapped( const std::string& srcPath, const std::string& dstPath, const convertOptions_t& options );
+uint32_t    LoadModelMapped( const std::string& path, ResourceManager& rm, const convertOptions_t& options );
+void        AddModelToPack( PackWriter& pack, const std::string& name, const std::string& mdlPath );
+uint32_t    LoadModelPacked( const PackFile& pack, const std::string& name, ResourceManager& rm, const convertOptions_t& options );
+void        ConvertModelOutOfCore( const std::string& srcPath, const std::string& dstPath, const convertOptions_t& options );
+const char* OutOfCoreUnsupportedOption( const convertOptions_t& options );     // Null when every set option works out of core
+void        NormalizeUVs( vertex_t* vertices, const size_t vertexCount );
+void        OptimizeSurfaces( importedModel_t& imported, const convertOptions_t& options );
+void        StoreMaterials( const std::string& path, std::vector<tinyobj::material_t>& materials, ResourceManager& rm );
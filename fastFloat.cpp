@@ -0,0 +1,248 @@
+#include <math.h>
+#include <string.h>
+#include <stdint.h>
+#include "fastFloat.h"
+#include "simd.h"
+
+#if defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+static const double PowLut[] = { 1.0, 0.1, 0.01, 0.001, 0.0001, 0.00001, 0.000001, 0.0000001 };
+static const int PowLutEntries = sizeof( PowLut ) / sizeof( PowLut[ 0 ] );
+
+
+static inline bool IsDigit( const char c )
+{
+    return ( c >= '0' ) && ( c <= '9' );
+}
+
+
+static inline const char* TokenEnd( const char* p, const char* end )
+{
+    while ( ( p < end ) && ( *p != ' ' ) && ( *p != '\t' ) && ( *p != '\r' ) )
+    {
+        ++p;
+    }
+    return p;
+}
+
+
+bool ParseObjDouble( const char* s, const char* sEnd, double* result )
+{
+    if ( s >= sEnd )
+    {
+        return false;
+    }
+
+    double mantissa = 0.0;
+    int exponent = 0;
+    char sign = '+';
+    char expSign = '+';
+    const char* curr = s;
+    int read = 0;
+    bool leadingDecimalDot = false;
+
+    if ( ( *curr == '+' ) || ( *curr == '-' ) )
+    {
+        sign = *curr;
+        curr++;
+        if ( ( curr != sEnd ) && ( *curr == '.' ) )
+        {
+            leadingDecimalDot = true;
+        }
+    }
+    else if ( *curr == '.' )
+    {
+        leadingDecimalDot = true;
+    }
+    else if ( !IsDigit( *curr ) )
+    {
+        return false;
+    }
+
+    if ( !leadingDecimalDot )
+    {
+        while ( ( curr != sEnd ) && IsDigit( *curr ) )
+        {
+            mantissa *= 10;
+            mantissa += static_cast<int>( *curr - '0' );
+            curr++;
+            read++;
+        }
+        if ( read == 0 )
+        {
+            return false;
+        }
+    }
+
+    if ( curr != sEnd )
+    {
+        if ( *curr == '.' )
+        {
+            curr++;
+            read = 1;
+            while ( ( curr != sEnd ) && IsDigit( *curr ) )
+            {
+                mantissa += static_cast<int>( *curr - '0' ) * ( ( read < PowLutEntries ) ? PowLut[ read ] : pow( 10.0, -read ) );
+                read++;
+                curr++;
+            }
+        }
+
+        if ( ( curr != sEnd ) && ( ( *curr == 'e' ) || ( *curr == 'E' ) ) )
+        {
+            curr++;
+            if ( ( curr != sEnd ) && ( ( *curr == '+' ) || ( *curr == '-' ) ) )
+            {
+                expSign = *curr;
+                curr++;
+            }
+            else if ( ( curr == sEnd ) || !IsDigit( *curr ) )
+            {
+                return false;
+            }
+
+            read = 0;
+            while ( ( curr != sEnd ) && IsDigit( *curr ) )
+            {
+                exponent *= 10;
+                exponent += static_cast<int>( *curr - '0' );
+                curr++;
+                read++;
+            }
+            exponent *= ( expSign == '+' ) ? 1 : -1;
+            if ( read == 0 )
+            {
+                return false;
+            }
+        }
+    }
+
+    *result = ( ( sign == '+' ) ? 1 : -1 ) * ( exponent ? ldexp( mantissa * pow( 5.0, exponent ), exponent ) : mantissa );
+    return true;
+}
+
+
+#if defined( CONVERTER_SSE2 )
+static inline uint32_t LowestBit( const uint32_t mask )
+{
+#if defined( _MSC_VER )
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return static_cast<uint32_t>( index );
+#else
+    return static_cast<uint32_t>( __builtin_ctz( mask ) );
+#endif
+}
+
+
+// Handles [+-]digits[.digits] with at most 15 characters, 8 integer digits and
+// 7 fractional digits. Returns 0 when the token is not in that form, or when the
+// result lands too close to a float rounding boundary to be sure it matches
+// ParseObjDouble. The caller then falls back to the scalar parser.
+static inline uint32_t ParseFixedPoint( const char* s, float* result )
+{
+    const __m128i chars = _mm_loadu_si128( reinterpret_cast<const __m128i*>( s ) );
+
+    // Unsigned digit test: c - '0' <= 9
+    const __m128i digits = _mm_sub_epi8( chars, _mm_set1_epi8( '0' ) );
+    const __m128i isDigit = _mm_cmpeq_epi8( _mm_min_epu8( digits, _mm_set1_epi8( 9 ) ), digits );
+    const uint32_t digitMask = static_cast<uint32_t>( _mm_movemask_epi8( isDigit ) );
+    const uint32_t dotMask = static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( chars, _mm_set1_epi8( '.' ) ) ) );
+
+    // The token runs up to the first character that is not a digit, a dot or a
+    // leading sign, and that character has to be a delimiter.
+    const uint32_t start = ( ( s[ 0 ] == '-' ) || ( s[ 0 ] == '+' ) ) ? 1 : 0;
+    const uint32_t otherMask = ~( digitMask | dotMask | start ) & 0xFFFF;
+    if ( otherMask == 0 )
+    {
+        return 0;
+    }
+    const uint32_t length = LowestBit( otherMask );
+    const char delimiter = s[ length ];
+    if ( ( delimiter != ' ' ) && ( delimiter != '\n' ) && ( delimiter != '\r' ) && ( delimiter != '\t' ) )
+    {
+        // Exponents and anything else unusual
+        return 0;
+    }
+
+    const uint32_t dot = dotMask & ( ( 1u << length ) - 1 );
+    if ( ( dot & ( dot - 1 ) ) != 0 )
+    {
+        return 0;
+    }
+
+    const uint32_t intEnd = ( dot != 0 ) ? LowestBit( dot ) : length;
+    if ( ( intEnd == start ) || ( ( intEnd - start ) > 8 ) || ( ( length - intEnd ) > 8 ) )
+    {
+        return 0;
+    }
+
+    // Reload the 16 bytes starting 8 before the dot, so the integer part and the
+    // fraction line up as two 8-digit groups. Only digits of the token are kept.
+    const __m128i window = _mm_sub_epi8( _mm_loadu_si128( reinterpret_cast<const __m128i*>( s + intEnd - 8 ) ), _mm_set1_epi8( '0' ) );
+    const __m128i lanes = _mm_setr_epi8( 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15 );
+    const __m128i integerLanes = _mm_cmpgt_epi8( lanes, _mm_set1_epi8( static_cast<char>( start + 7 - intEnd ) ) );
+    const __m128i fractionLanes = _mm_cmplt_epi8( lanes, _mm_set1_epi8( static_cast<char>( length + 8 - intEnd ) ) );
+    const __m128i dotLane = _mm_cmpeq_epi8( lanes, _mm_set1_epi8( 8 ) );
+    const __m128i groups = _mm_andnot_si128( dotLane, _mm_and_si128( window, _mm_and_si128( integerLanes, fractionLanes ) ) );
+
+    // Horner in three multiply-add steps: digit pairs, then 4-digit, then 8-digit values
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i pairs = _mm_packs_epi32( _mm_madd_epi16( _mm_unpacklo_epi8( groups, zero ), _mm_set1_epi32( ( 1 << 16 ) | 10 ) ),
+                                           _mm_madd_epi16( _mm_unpackhi_epi8( groups, zero ), _mm_set1_epi32( ( 1 << 16 ) | 10 ) ) );
+    const __m128i quads = _mm_madd_epi16( pairs, _mm_set1_epi32( ( 1 << 16 ) | 100 ) );
+    const __m128i octets = _mm_madd_epi16( _mm_packs_epi32( quads, quads ), _mm_set1_epi32( ( 1 << 16 ) | 10000 ) );
+
+    const uint64_t integer = static_cast<uint32_t>( _mm_cvtsi128_si32( octets ) );
+    const uint64_t fraction = static_cast<uint32_t>( _mm_cvtsi128_si32( _mm_srli_si128( octets, 4 ) ) );
+
+    // Both values are exact and the division is correctly rounded, so this is
+    // within half an ulp of the decimal value. ParseObjDouble accumulates the
+    // fraction digit by digit and lands within ~10 ulps of it. Unless that
+    // window straddles a point halfway between two floats, both round to the
+    // same float.
+    const double value = static_cast<double>( integer * 10000000 + fraction ) / 1e7;
+
+    uint64_t bits;
+    memcpy( &bits, &value, sizeof( bits ) );
+
+    // The 29 mantissa bits a float drops, compared against the halfway pattern with
+    // a single unsigned range check. Two signed compares would mispredict half the time.
+    const uint64_t discarded = bits & ( ( 1ull << 29 ) - 1 );
+    const uint64_t halfway = 1ull << 28;
+    if ( ( discarded - ( halfway - 64 ) ) < 128 )
+    {
+        return 0;
+    }
+
+    const float rounded = static_cast<float>( value );
+    *result = ( s[ 0 ] == '-' ) ? -rounded : rounded;
+    return length;
+}
+#endif
+
+
+const char* ParseObjReal( const char* s, const char* lineEnd, const char* readBegin, const char* readEnd, float* result )
+{
+#if defined( CONVERTER_SSE2 )
+    if ( ( ( s - readBegin ) >= 8 ) && ( ( readEnd - s ) >= 24 ) )
+    {
+        float value;
+        const uint32_t length = ParseFixedPoint( s, &value );
+        if ( ( length > 0 ) && ( ( s + length ) <= lineEnd ) )
+        {
+            *result = value;
+            return s + length;
+        }
+    }
+#endif
+    const char* tokenEnd = TokenEnd( s, lineEnd );
+    double value;
+    if ( ParseObjDouble( s, tokenEnd, &value ) )
+    {
+        *result = static_cast<float>( value );
+    }
+    return tokenEnd;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// OBJ real number parsing. Results are bit-identical to tinyobj's tryParseDouble,
+// so every front end produces the same vertex data.
+
+// Scalar parser for the token [s, sEnd). result is left untouched on failure.
+bool ParseObjDouble( const char* s, const char* sEnd, double* result );
+
+// Parses the token starting at s as a float and returns its end. The token stops
+// at a space, tab, '\r' or lineEnd. Short fixed-point tokens ("-12.3456") are
+// classified and converted with SSE2 and no per-character branches; the result is
+// the same float ParseObjDouble would round to. Anything else goes through
+// ParseObjDouble. [readBegin, readEnd) is the memory around the token that is safe
+// to load from.
+const char* ParseObjReal( const char* s, const char* lineEnd, const char* readBegin, const char* readEnd, float* result );
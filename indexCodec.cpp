@@ -0,0 +1,335 @@
+#include <string.h>
+#include "indexCodec.h"
+
+// 15 addressable edges, the 16th code marks a miss
+static const uint32_t EdgeFifoSize = 16;
+static const uint32_t EdgeFifoReach = 15;
+// Codes 1..14 address the vertex FIFO, 0 is "next new vertex", 15 is explicit
+static const uint32_t VertexFifoSize = 16;
+static const uint32_t VertexFifoReach = 14;
+static const uint32_t CodeNext = 0;
+static const uint32_t CodeExplicit = 15;
+
+struct indexCodecState_t
+{
+    uint32_t    edges[ EdgeFifoSize ][ 2 ];
+    uint32_t    vertices[ VertexFifoSize ];
+    uint32_t    edgeOffset;
+    uint32_t    vertexOffset;
+    uint32_t    next;
+    uint32_t    last;
+
+    indexCodecState_t()
+    {
+        // ~0 never matches a real edge in the encoder; the decoder never reads it
+        memset( edges, 0xFF, sizeof( edges ) );
+        memset( vertices, 0xFF, sizeof( vertices ) );
+        edgeOffset = 0;
+        vertexOffset = 0;
+        next = 0;
+        last = 0;
+    }
+
+    void PushEdge( const uint32_t a, const uint32_t b )
+    {
+        edges[ edgeOffset & ( EdgeFifoSize - 1 ) ][ 0 ] = a;
+        edges[ edgeOffset & ( EdgeFifoSize - 1 ) ][ 1 ] = b;
+        ++edgeOffset;
+    }
+
+    void PushVertex( const uint32_t v )
+    {
+        vertices[ vertexOffset & ( VertexFifoSize - 1 ) ] = v;
+        ++vertexOffset;
+    }
+};
+
+
+static void WriteVarint( std::vector<uint8_t>& out, uint32_t value )
+{
+    while ( value >= 0x80 )
+    {
+        out.push_back( static_cast<uint8_t>( value | 0x80 ) );
+        value >>= 7;
+    }
+    out.push_back( static_cast<uint8_t>( value ) );
+}
+
+
+static uint32_t ZigZag( const uint32_t index, const uint32_t last )
+{
+    const int32_t delta = static_cast<int32_t>( index - last );
+    return ( static_cast<uint32_t>( delta ) << 1 ) ^ static_cast<uint32_t>( delta >> 31 );
+}
+
+
+static uint32_t UnZigZag( const uint32_t value, const uint32_t last )
+{
+    return last + ( ( value >> 1 ) ^ ( 0u - ( value & 1 ) ) );
+}
+
+
+static int32_t FindEdge( const indexCodecState_t& state, const uint32_t a, const uint32_t b )
+{
+    for ( uint32_t i = 0; i < EdgeFifoReach; ++i )
+    {
+        const uint32_t* edge = state.edges[ ( state.edgeOffset - 1 - i ) & ( EdgeFifoSize - 1 ) ];
+        if ( ( edge[ 0 ] == a ) && ( edge[ 1 ] == b ) )
+        {
+            return static_cast<int32_t>( i );
+        }
+    }
+    return -1;
+}
+
+
+static int32_t FindVertex( const indexCodecState_t& state, const uint32_t v )
+{
+    for ( uint32_t i = 0; i < VertexFifoReach; ++i )
+    {
+        if ( state.vertices[ ( state.vertexOffset - 1 - i ) & ( VertexFifoSize - 1 ) ] == v )
+        {
+            return static_cast<int32_t>( i );
+        }
+    }
+    return -1;
+}
+
+
+// Codes one vertex against the state; explicit vertices go to data
+static uint32_t EncodeVertex( indexCodecState_t& state, const uint32_t v, std::vector<uint8_t>& data )
+{
+    if ( v == state.next )
+    {
+        state.next++;
+        state.PushVertex( v );
+        return CodeNext;
+    }
+
+    const int32_t fifoIx = FindVertex( state, v );
+    if ( fifoIx >= 0 )
+    {
+        return static_cast<uint32_t>( fifoIx ) + 1;
+    }
+
+    WriteVarint( data, ZigZag( v, state.last ) );
+    state.last = v;
+    state.PushVertex( v );
+    return CodeExplicit;
+}
+
+
+void EncodeIndexBuffer( const uint32_t* indices, const size_t indexCount, std::vector<uint8_t>& out )
+{
+    const size_t triCount = indexCount / 3;
+
+    indexCodecState_t state;
+    std::vector<uint8_t> codes;
+    std::vector<uint8_t> data;
+    codes.reserve( triCount );
+    data.reserve( triCount );
+
+    for ( size_t triIx = 0; triIx < triCount; ++triIx )
+    {
+        uint32_t a = indices[ 3 * triIx + 0 ];
+        uint32_t b = indices[ 3 * triIx + 1 ];
+        uint32_t c = indices[ 3 * triIx + 2 ];
+
+        // Neighbours walk a shared edge in the opposite direction, so edges are
+        // stored reversed and any of the three rotations may hit
+        int32_t edgeIx = FindEdge( state, a, b );
+        if ( edgeIx < 0 )
+        {
+            edgeIx = FindEdge( state, b, c );
+            if ( edgeIx >= 0 )
+            {
+                const uint32_t t = a;
+                a = b;
+                b = c;
+                c = t;
+            }
+        }
+        if ( edgeIx < 0 )
+        {
+            edgeIx = FindEdge( state, c, a );
+            if ( edgeIx >= 0 )
+            {
+                const uint32_t t = c;
+                c = b;
+                b = a;
+                a = t;
+            }
+        }
+
+        if ( edgeIx >= 0 )
+        {
+            const uint32_t code = EncodeVertex( state, c, data );
+            codes.push_back( static_cast<uint8_t>( ( static_cast<uint32_t>( edgeIx ) << 4 ) | code ) );
+
+            state.PushEdge( c, b );
+            state.PushEdge( a, c );
+        }
+        else
+        {
+            // Miss: the code byte carries a, an aux byte in the data carries b and c
+            const uint32_t codeA = EncodeVertex( state, a, data );
+            codes.push_back( static_cast<uint8_t>( ( EdgeFifoReach << 4 ) | codeA ) );
+
+            const size_t auxPos = data.size();
+            data.push_back( 0 );
+            const uint32_t codeB = EncodeVertex( state, b, data );
+            const uint32_t codeC = EncodeVertex( state, c, data );
+            data[ auxPos ] = static_cast<uint8_t>( ( codeB << 4 ) | codeC );
+
+            state.PushEdge( b, a );
+            state.PushEdge( c, b );
+            state.PushEdge( a, c );
+        }
+    }
+
+    out.insert( out.end(), codes.begin(), codes.end() );
+    out.insert( out.end(), data.begin(), data.end() );
+}
+
+
+// A triangle reads at most an aux byte and three 5-byte varints; with that much
+// data left the per-byte bounds checks are skipped
+static const size_t MaxTriangleData = 1 + 3 * 5;
+
+template< bool Checked >
+static inline bool ReadVarint( const uint8_t*& data, const uint8_t* end, uint32_t& value )
+{
+    uint32_t result = 0;
+    for ( uint32_t shift = 0; shift < 35; shift += 7 )
+    {
+        if ( Checked && ( data == end ) )
+        {
+            return false;
+        }
+        const uint8_t byte = *data++;
+        result |= static_cast<uint32_t>( byte & 0x7F ) << shift;
+        if ( byte < 0x80 )
+        {
+            value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+template< bool Checked >
+static inline bool DecodeVertex( indexCodecState_t& state, const uint32_t code, const uint8_t*& data, const uint8_t* end, uint32_t& v )
+{
+    if ( code == CodeNext )
+    {
+        v = state.next++;
+    }
+    else if ( code < CodeExplicit )
+    {
+        v = state.vertices[ ( state.vertexOffset - code ) & ( VertexFifoSize - 1 ) ];
+        return true;
+    }
+    else
+    {
+        uint32_t value;
+        if ( !ReadVarint<Checked>( data, end, value ) )
+        {
+            return false;
+        }
+        v = UnZigZag( value, state.last );
+        state.last = v;
+    }
+    state.PushVertex( v );
+    return true;
+}
+
+
+template< bool Checked, class Index >
+static inline bool DecodeTriangle( indexCodecState_t& state, const uint32_t code, const uint8_t*& data, const uint8_t* end, Index* tri )
+{
+    const uint32_t edgeIx = code >> 4;
+    if ( edgeIx < EdgeFifoReach )
+    {
+        const uint32_t* edge = state.edges[ ( state.edgeOffset - 1 - edgeIx ) & ( EdgeFifoSize - 1 ) ];
+        const uint32_t a = edge[ 0 ];
+        const uint32_t b = edge[ 1 ];
+        uint32_t c;
+        if ( !DecodeVertex<Checked>( state, code & 15, data, end, c ) )
+        {
+            return false;
+        }
+
+        state.PushEdge( c, b );
+        state.PushEdge( a, c );
+        tri[ 0 ] = static_cast<Index>( a );
+        tri[ 1 ] = static_cast<Index>( b );
+        tri[ 2 ] = static_cast<Index>( c );
+        return true;
+    }
+
+    uint32_t a, b, c;
+    if ( !DecodeVertex<Checked>( state, code & 15, data, end, a ) || ( Checked && ( data == end ) ) )
+    {
+        return false;
+    }
+    const uint32_t aux = *data++;
+    if ( !DecodeVertex<Checked>( state, aux >> 4, data, end, b ) || !DecodeVertex<Checked>( state, aux & 15, data, end, c ) )
+    {
+        return false;
+    }
+
+    state.PushEdge( b, a );
+    state.PushEdge( c, b );
+    state.PushEdge( a, c );
+    tri[ 0 ] = static_cast<Index>( a );
+    tri[ 1 ] = static_cast<Index>( b );
+    tri[ 2 ] = static_cast<Index>( c );
+    return true;
+}
+
+
+template< class Index >
+static bool DecodeIndices( const uint8_t* data, const size_t size, Index* indices, const size_t indexCount )
+{
+    if ( ( indexCount % 3 ) != 0 )
+    {
+        return false;
+    }
+    const size_t triCount = indexCount / 3;
+    if ( size < triCount )
+    {
+        return false;
+    }
+
+    const uint8_t* codes = data;
+    const uint8_t* cursor = data + triCount;
+    const uint8_t* end = data + size;
+
+    indexCodecState_t state;
+
+    for ( size_t triIx = 0; triIx < triCount; ++triIx )
+    {
+        const bool decoded = ( static_cast<size_t>( end - cursor ) >= MaxTriangleData ) ?
+            DecodeTriangle<false, Index>( state, codes[ triIx ], cursor, end, indices + 3 * triIx ) :
+            DecodeTriangle<true, Index>( state, codes[ triIx ], cursor, end, indices + 3 * triIx );
+        if ( !decoded )
+        {
+            return false;
+        }
+    }
+
+    return ( cursor == end );
+}
+
+
+bool DecodeIndexBuffer( const uint8_t* data, const size_t size, uint32_t* indices, const size_t indexCount )
+{
+    return DecodeIndices( data, size, indices, indexCount );
+}
+
+
+bool DecodeIndexBuffer( const uint8_t* data, const size_t size, uint16_t* indices, const size_t indexCount )
+{
+    return DecodeIndices( data, size, indices, indexCount );
+}
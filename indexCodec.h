@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Triangle list codec. Each triangle is predicted from a FIFO of recent edges and
+// a FIFO of recent vertices, with a 4-bit code per prediction and LEB128 deltas
+// for the vertices that can't be predicted. Triangles may come back rotated, but
+// winding and triangle order are kept.
+//
+// The stream is a byte of codes per triangle followed by the varint data.
+
+// Appends the encoded stream to out. indexCount must be a multiple of 3.
+void    EncodeIndexBuffer( const uint32_t* indices, const size_t indexCount, std::vector<uint8_t>& out );
+
+// Returns false if the stream is malformed or does not hold exactly indexCount indices.
+// The 16-bit overload is for streams known to index fewer than 65536 vertices.
+bool    DecodeIndexBuffer( const uint8_t* data, const size_t size, uint32_t* indices, const size_t indexCount );
+bool    DecodeIndexBuffer( const uint8_t* data, const size_t size, uint16_t* indices, const size_t indexCount );
@@ -0,0 +1,196 @@
+#include <string.h>
+#include <algorithm>
+#include "lzCodec.h"
+
+static const uint32_t HashBits = 14;
+static const size_t MaxOffset = 65535;
+static const size_t NibbleMax = 15;
+
+
+static inline uint32_t Read32( const uint8_t* data )
+{
+    uint32_t value;
+    memcpy( &value, data, sizeof( value ) );
+    return value;
+}
+
+
+static inline uint32_t Hash( const uint32_t value )
+{
+    return ( value * 2654435761u ) >> ( 32 - HashBits );
+}
+
+
+static void WriteLength( std::vector<uint8_t>& out, size_t length )
+{
+    while ( length >= 255 )
+    {
+        out.push_back( 255 );
+        length -= 255;
+    }
+    out.push_back( static_cast<uint8_t>( length ) );
+}
+
+
+// matchLength 0 writes the closing literals-only sequence
+static void WriteSequence( std::vector<uint8_t>& out, const uint8_t* literals, const size_t literalCount, const size_t offset, const size_t matchLength )
+{
+    const size_t matchCode = ( matchLength > 0 ) ? ( matchLength - LzMinMatch ) : 0;
+    out.push_back( static_cast<uint8_t>( ( std::min( literalCount, NibbleMax ) << 4 ) | std::min( matchCode, NibbleMax ) ) );
+    if ( literalCount >= NibbleMax )
+    {
+        WriteLength( out, literalCount - NibbleMax );
+    }
+    out.insert( out.end(), literals, literals + literalCount );
+
+    if ( matchLength == 0 )
+    {
+        return;
+    }
+    out.push_back( static_cast<uint8_t>( offset ) );
+    out.push_back( static_cast<uint8_t>( offset >> 8 ) );
+    if ( matchCode >= NibbleMax )
+    {
+        WriteLength( out, matchCode - NibbleMax );
+    }
+}
+
+
+void LzCompress( const uint8_t* data, const size_t size, std::vector<uint8_t>& out )
+{
+    // Last position seen for each hash of 4 bytes. Candidates are verified, so
+    // stale or colliding entries only cost a compare.
+    std::vector<uint32_t> table( static_cast<size_t>( 1 ) << HashBits, 0 );
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while ( ( pos + LzMinMatch ) <= size )
+    {
+        const uint32_t value = Read32( data + pos );
+        uint32_t& slot = table[ Hash( value ) ];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>( pos );
+
+        if ( ( candidate >= pos ) || ( ( pos - candidate ) > MaxOffset ) || ( Read32( data + candidate ) != value ) )
+        {
+            // Step faster the longer nothing has matched, incompressible data stays cheap
+            pos += 1 + ( ( pos - anchor ) >> 5 );
+            continue;
+        }
+
+        size_t length = LzMinMatch;
+        while ( ( ( pos + length ) < size ) && ( data[ candidate + length ] == data[ pos + length ] ) )
+        {
+            ++length;
+        }
+        while ( ( pos > anchor ) && ( candidate > 0 ) && ( data[ candidate - 1 ] == data[ pos - 1 ] ) )
+        {
+            --pos;
+            --candidate;
+            ++length;
+        }
+
+        WriteSequence( out, data + anchor, pos - anchor, pos - candidate, length );
+        pos += length;
+        anchor = pos;
+
+        // The match skipped hashing its own bytes; seed its tail for the next search
+        if ( ( pos + 2 ) <= size )
+        {
+            table[ Hash( Read32( data + pos - 2 ) ) ] = static_cast<uint32_t>( pos - 2 );
+        }
+    }
+    WriteSequence( out, data + anchor, size - anchor, 0, 0 );
+}
+
+
+static inline bool ReadLength( const uint8_t*& data, const uint8_t* end, size_t& length )
+{
+    uint8_t byte;
+    do
+    {
+        if ( data == end )
+        {
+            return false;
+        }
+        byte = *data++;
+        length += byte;
+    } while ( byte == 255 );
+    return true;
+}
+
+
+bool LzDecompress( const uint8_t* data, const size_t size, uint8_t* raw, const size_t rawSize )
+{
+    const uint8_t* end = data + size;
+    uint8_t* out = raw;
+    uint8_t* const outEnd = raw + rawSize;
+
+    for ( ;; )
+    {
+        if ( data == end )
+        {
+            return false;
+        }
+        const uint32_t token = *data++;
+
+        size_t literalCount = token >> 4;
+        if ( ( literalCount == NibbleMax ) && !ReadLength( data, end, literalCount ) )
+        {
+            return false;
+        }
+        if ( ( literalCount > static_cast<size_t>( end - data ) ) || ( literalCount > static_cast<size_t>( outEnd - out ) ) )
+        {
+            return false;
+        }
+        memcpy( out, data, literalCount );
+        out += literalCount;
+        data += literalCount;
+
+        if ( data == end )
+        {
+            return ( out == outEnd );
+        }
+        if ( ( end - data ) < 2 )
+        {
+            return false;
+        }
+        const size_t offset = static_cast<size_t>( data[ 0 ] ) | ( static_cast<size_t>( data[ 1 ] ) << 8 );
+        data += 2;
+
+        size_t matchLength = token & NibbleMax;
+        if ( ( matchLength == NibbleMax ) && !ReadLength( data, end, matchLength ) )
+        {
+            return false;
+        }
+        matchLength += LzMinMatch;
+        if ( ( offset == 0 ) || ( offset > static_cast<size_t>( out - raw ) ) || ( matchLength > static_cast<size_t>( outEnd - out ) ) )
+        {
+            return false;
+        }
+
+        const uint8_t* match = out - offset;
+        if ( ( offset >= 8 ) && ( ( matchLength + 8 ) <= static_cast<size_t>( outEnd - out ) ) )
+        {
+            // 8 bytes at a time may write past the match, but only into output
+            // that the following sequences overwrite
+            uint8_t* const copyEnd = out + matchLength;
+            do
+            {
+                memcpy( out, match, 8 );
+                out += 8;
+                match += 8;
+            } while ( out < copyEnd );
+            out = copyEnd;
+        }
+        else
+        {
+            // Overlapping: each byte may be one this match just wrote
+            for ( size_t i = 0; i < matchLength; ++i )
+            {
+                out[ i ] = match[ i ];
+            }
+            out += matchLength;
+        }
+    }
+}
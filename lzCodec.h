@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Byte-oriented LZ77 block codec, for when reading fewer bytes beats the decode.
+//
+// A block is a run of sequences. Each sequence is a token byte holding a 4-bit
+// literal length and a 4-bit match length, extra length bytes when a nibble is
+// 15, the literals, then a 16-bit little-endian match offset. The last sequence
+// is literals only. Matches are at least LzMinMatch bytes and may overlap their
+// output, so runs compress too.
+
+static const uint32_t LzMinMatch = 4;
+
+// Appends the compressed block to out
+void    LzCompress( const uint8_t* data, const size_t size, std::vector<uint8_t>& out );
+
+// Returns false if the block is malformed or does not expand to exactly rawSize bytes
+bool    LzDecompress( const uint8_t* data, const size_t size, uint8_t* raw, const size_t rawSize );
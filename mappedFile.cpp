@@ -0,0 +1,137 @@
+#include "mappedFile.h"
+
+#if defined( _WIN32 )
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+{
+    data = nullptr;
+    size = 0;
+    opened = false;
+#if defined( _WIN32 )
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    fileHandle = -1;
+#endif
+}
+
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+
+bool MappedFile::Open( const std::string& path )
+{
+    Close();
+
+#if defined( _WIN32 )
+    fileHandle = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+    if ( fileHandle == INVALID_HANDLE_VALUE )
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if ( !GetFileSizeEx( fileHandle, &fileSize ) )
+    {
+        Close();
+        return false;
+    }
+    size = static_cast<uint64_t>( fileSize.QuadPart );
+    opened = true;
+
+    // Zero-length files cannot be mapped, but are valid and simply empty
+    if ( size == 0 )
+    {
+        return true;
+    }
+
+    mappingHandle = CreateFileMappingA( fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    if ( mappingHandle == nullptr )
+    {
+        Close();
+        return false;
+    }
+
+    data = static_cast<const uint8_t*>( MapViewOfFile( mappingHandle, FILE_MAP_READ, 0, 0, 0 ) );
+#else
+    fileHandle = open( path.c_str(), O_RDONLY );
+    if ( fileHandle < 0 )
+    {
+        return false;
+    }
+
+    struct stat fileStat;
+    if ( fstat( fileHandle, &fileStat ) != 0 )
+    {
+        Close();
+        return false;
+    }
+    size = static_cast<uint64_t>( fileStat.st_size );
+    opened = true;
+
+    if ( size == 0 )
+    {
+        return true;
+    }
+
+    void* view = mmap( nullptr, static_cast<size_t>( size ), PROT_READ, MAP_PRIVATE, fileHandle, 0 );
+    data = ( view != MAP_FAILED ) ? static_cast<const uint8_t*>( view ) : nullptr;
+    if ( data != nullptr )
+    {
+        madvise( view, static_cast<size_t>( size ), MADV_SEQUENTIAL );
+    }
+#endif
+
+    if ( data == nullptr )
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+
+void MappedFile::Close()
+{
+#if defined( _WIN32 )
+    if ( data != nullptr )
+    {
+        UnmapViewOfFile( data );
+    }
+    if ( mappingHandle != nullptr )
+    {
+        CloseHandle( mappingHandle );
+    }
+    if ( fileHandle != INVALID_HANDLE_VALUE )
+    {
+        CloseHandle( fileHandle );
+    }
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#else
+    if ( data != nullptr )
+    {
+        munmap( const_cast<uint8_t*>( data ), static_cast<size_t>( size ) );
+    }
+    if ( fileHandle >= 0 )
+    {
+        close( fileHandle );
+    }
+    fileHandle = -1;
+#endif
+    data = nullptr;
+    size = 0;
+    opened = false;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <string>
+#include <stdint.h>
+
+// Read-only view of a whole file mapped into the address space.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile( const MappedFile& ) = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    bool            Open( const std::string& path );
+    void            Close();
+
+    bool            IsOpen() const { return opened; }
+    const uint8_t*  GetData() const { return data; }
+    uint64_t        GetSize() const { return size; }
+
+private:
+    const uint8_t*  data;
+    uint64_t        size;
+    bool            opened;
+#if defined( _WIN32 )
+    void*           fileHandle;
+    void*           mappingHandle;
+#else
+    int             fileHandle;
+#endif
+};
@@ -0,0 +1,455 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+#include "meshOptimizer.h"
+
+static const uint32_t MaxValenceScore = 32;
+static const uint32_t NoTriangle = ~0u;
+
+void IndexRange( const uint32_t* indices, const size_t indexCount, uint32_t& baseIx, uint32_t& vertexCount )
+{
+    if ( indexCount == 0 )
+    {
+        baseIx = 0;
+        vertexCount = 0;
+        return;
+    }
+    uint32_t minIx = indices[ 0 ];
+    uint32_t maxIx = indices[ 0 ];
+    for ( size_t i = 1; i < indexCount; ++i )
+    {
+        minIx = std::min( minIx, indices[ i ] );
+        maxIx = std::max( maxIx, indices[ i ] );
+    }
+    baseIx = minIx;
+    vertexCount = maxIx - minIx + 1;
+}
+
+
+// Forsyth's scoring constants, tabulated
+struct vertexScoreTable_t
+{
+    float   cache[ VertexCacheSize + 1 ];   // By cache position + 1, 0 is not cached
+    float   live[ MaxValenceScore + 1 ];    // By remaining triangles
+
+    vertexScoreTable_t()
+    {
+        static const float CacheDecayPower = 1.5f;
+        static const float LastTriangleScore = 0.75f;
+        static const float ValenceBoostScale = 2.0f;
+        static const float ValenceBoostPower = 0.5f;
+
+        cache[ 0 ] = 0.0f;
+        for ( uint32_t pos = 0; pos < VertexCacheSize; ++pos )
+        {
+            // The last triangle's vertices get a fixed score so that its
+            // neighbours don't win just by being in the same strip direction
+            const float scaler = 1.0f / ( VertexCacheSize - 3 );
+            cache[ pos + 1 ] = ( pos < 3 ) ? LastTriangleScore : powf( 1.0f - ( pos - 3 ) * scaler, CacheDecayPower );
+        }
+        live[ 0 ] = 0.0f;
+        for ( uint32_t count = 1; count <= MaxValenceScore; ++count )
+        {
+            // Favours vertices with few triangles left, so they get finished off
+            live[ count ] = ValenceBoostScale * powf( static_cast<float>( count ), -ValenceBoostPower );
+        }
+    }
+
+    float Score( const int32_t cachePos, const uint32_t liveCount ) const
+    {
+        if ( liveCount == 0 )
+        {
+            return -1.0f;
+        }
+        return cache[ cachePos + 1 ] + live[ std::min( liveCount, MaxValenceScore ) ];
+    }
+};
+
+
+void OptimizeVertexCache( uint32_t* dst, const uint32_t* indices, const size_t indexCount )
+{
+    static const vertexScoreTable_t table;
+
+    uint32_t baseIx;
+    uint32_t vertexCount;
+    IndexRange( indices, indexCount, baseIx, vertexCount );
+    const size_t triangleCount = indexCount / 3;
+
+    // Triangles of each vertex. The first liveCounts[ v ] of its list are the ones
+    // not emitted yet.
+    std::vector<uint32_t> liveCounts( vertexCount, 0 );
+    for ( size_t i = 0; i < ( triangleCount * 3 ); ++i )
+    {
+        ++liveCounts[ indices[ i ] - baseIx ];
+    }
+    std::vector<uint32_t> adjacencyOffsets( vertexCount );
+    uint32_t offset = 0;
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        adjacencyOffsets[ v ] = offset;
+        offset += liveCounts[ v ];
+    }
+    std::vector<uint32_t> adjacency( triangleCount * 3 );
+    {
+        std::vector<uint32_t> fill( adjacencyOffsets );
+        for ( size_t i = 0; i < ( triangleCount * 3 ); ++i )
+        {
+            adjacency[ fill[ indices[ i ] - baseIx ]++ ] = static_cast<uint32_t>( i / 3 );
+        }
+    }
+
+    std::vector<float> vertexScores( vertexCount );
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        vertexScores[ v ] = table.Score( -1, liveCounts[ v ] );
+    }
+    std::vector<float> triangleScores( triangleCount );
+    for ( size_t t = 0; t < triangleCount; ++t )
+    {
+        const uint32_t* tri = indices + t * 3;
+        triangleScores[ t ] = vertexScores[ tri[ 0 ] - baseIx ] + vertexScores[ tri[ 1 ] - baseIx ] + vertexScores[ tri[ 2 ] - baseIx ];
+    }
+
+    std::vector<uint8_t> emitted( triangleCount, 0 );
+    uint32_t cache[ VertexCacheSize + 3 ];
+    uint32_t newCache[ VertexCacheSize + 3 ];
+    uint32_t cacheCount = 0;
+    size_t inputCursor = 0;
+
+    uint32_t current = ( triangleCount > 0 ) ? 0 : NoTriangle;
+    size_t outCount = 0;
+    while ( current != NoTriangle )
+    {
+        const uint32_t* tri = indices + static_cast<size_t>( current ) * 3;
+        dst[ outCount++ ] = tri[ 0 ];
+        dst[ outCount++ ] = tri[ 1 ];
+        dst[ outCount++ ] = tri[ 2 ];
+        emitted[ current ] = 1;
+
+        // The emitted triangle's vertices move to the front, the rest shift back
+        uint32_t newCount = 0;
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+            const uint32_t v = tri[ k ] - baseIx;
+            if ( std::find( newCache, newCache + newCount, v ) == ( newCache + newCount ) )
+            {
+                newCache[ newCount++ ] = v;
+            }
+
+            uint32_t* live = adjacency.data() + adjacencyOffsets[ v ];
+            uint32_t* last = live + liveCounts[ v ] - 1;
+            *std::find( live, last, current ) = *last;
+            --liveCounts[ v ];
+        }
+        for ( uint32_t i = 0; i < cacheCount; ++i )
+        {
+            const uint32_t v = cache[ i ];
+            if ( ( v != ( tri[ 0 ] - baseIx ) ) && ( v != ( tri[ 1 ] - baseIx ) ) && ( v != ( tri[ 2 ] - baseIx ) ) )
+            {
+                newCache[ newCount++ ] = v;
+            }
+        }
+
+        // Rescore everything that was or is now cached; the ones pushed past the
+        // end drop to an uncached score
+        for ( uint32_t i = 0; i < newCount; ++i )
+        {
+            const uint32_t v = newCache[ i ];
+            const float score = table.Score( ( i < VertexCacheSize ) ? static_cast<int32_t>( i ) : -1, liveCounts[ v ] );
+            const float delta = score - vertexScores[ v ];
+            vertexScores[ v ] = score;
+
+            const uint32_t* live = adjacency.data() + adjacencyOffsets[ v ];
+            for ( uint32_t j = 0; j < liveCounts[ v ]; ++j )
+            {
+                triangleScores[ live[ j ] ] += delta;
+            }
+        }
+
+        // Only triangles touching the cache changed, so the best one is among them
+        current = NoTriangle;
+        float bestScore = 0.0f;
+        cacheCount = std::min( newCount, VertexCacheSize );
+        for ( uint32_t i = 0; i < cacheCount; ++i )
+        {
+            const uint32_t v = newCache[ i ];
+            cache[ i ] = v;
+
+            const uint32_t* live = adjacency.data() + adjacencyOffsets[ v ];
+            for ( uint32_t j = 0; j < liveCounts[ v ]; ++j )
+            {
+                if ( ( current == NoTriangle ) || ( triangleScores[ live[ j ] ] > bestScore ) )
+                {
+                    current = live[ j ];
+                    bestScore = triangleScores[ current ];
+                }
+            }
+        }
+
+        if ( current == NoTriangle )
+        {
+            while ( ( inputCursor < triangleCount ) && ( emitted[ inputCursor ] != 0 ) )
+            {
+                ++inputCursor;
+            }
+            current = ( inputCursor < triangleCount ) ? static_cast<uint32_t>( inputCursor ) : NoTriangle;
+        }
+    }
+}
+
+
+// FIFO cache by timestamp: a vertex is cached if fewer than size misses happened
+// since its own. A miss time of 0 means never seen.
+struct fifoCache_t
+{
+    std::vector<size_t> missTimes;
+    size_t              time;
+    size_t              size;
+
+    fifoCache_t( const uint32_t vertexCount, const uint32_t cacheSize ) : missTimes( vertexCount, 0 ), time( cacheSize + 1 ), size( cacheSize ) {}
+
+    bool IsSeen( const uint32_t v ) const { return missTimes[ v ] != 0; }
+
+    // Returns 1 on a miss
+    uint32_t Access( const uint32_t v )
+    {
+        if ( ( time - missTimes[ v ] ) <= size )
+        {
+            return 0;
+        }
+        missTimes[ v ] = time++;
+        return 1;
+    }
+
+    void Flush() { time += size + 1; }
+};
+
+
+vertexCacheStats_t AnalyzeVertexCache( const uint32_t* indices, const size_t indexCount, const uint32_t cacheSize )
+{
+    vertexCacheStats_t stats;
+    memset( &stats, 0, sizeof( stats ) );
+    stats.triangleCount = indexCount / 3;
+
+    uint32_t baseIx;
+    uint32_t vertexCount;
+    IndexRange( indices, indexCount, baseIx, vertexCount );
+
+    fifoCache_t cache( vertexCount, cacheSize );
+    for ( size_t i = 0; i < ( stats.triangleCount * 3 ); ++i )
+    {
+        const uint32_t v = indices[ i ] - baseIx;
+        stats.vertexCount += cache.IsSeen( v ) ? 0 : 1;
+        stats.transformCount += cache.Access( v );
+    }
+    return stats;
+}
+
+
+static uint32_t AccessTriangle( fifoCache_t& cache, const uint32_t* tri, const uint32_t baseIx )
+{
+    return cache.Access( tri[ 0 ] - baseIx ) + cache.Access( tri[ 1 ] - baseIx ) + cache.Access( tri[ 2 ] - baseIx );
+}
+
+
+size_t OptimizeOverdraw( uint32_t* dst, const uint32_t* indices, const size_t indexCount, const vertex_t* vertices, const float threshold )
+{
+    uint32_t baseIx;
+    uint32_t vertexCount;
+    IndexRange( indices, indexCount, baseIx, vertexCount );
+    const uint32_t triangleCount = static_cast<uint32_t>( indexCount / 3 );
+    if ( triangleCount == 0 )
+    {
+        return 0;
+    }
+
+    // Hard boundaries: a triangle missing on all three vertices usually starts a
+    // patch disjoint from what came before
+    fifoCache_t cache( vertexCount, VertexCacheSize );
+    std::vector<uint32_t> patches;
+    for ( uint32_t t = 0; t < triangleCount; ++t )
+    {
+        if ( ( AccessTriangle( cache, indices + t * 3, baseIx ) == 3 ) || ( t == 0 ) )
+        {
+            patches.push_back( t );
+        }
+    }
+    patches.push_back( triangleCount );
+
+    // Soft boundaries: within a patch, cut a cluster as soon as its own ACMR,
+    // from a cold cache, is within threshold of the whole patch's. Every cut
+    // costs a cold start, so a lower threshold gives fewer, larger clusters.
+    std::vector<uint32_t> clusters;
+    for ( size_t patchIx = 0; ( patchIx + 1 ) < patches.size(); ++patchIx )
+    {
+        const uint32_t start = patches[ patchIx ];
+        const uint32_t end = patches[ patchIx + 1 ];
+
+        cache.Flush();
+        uint32_t patchMisses = 0;
+        for ( uint32_t t = start; t < end; ++t )
+        {
+            patchMisses += AccessTriangle( cache, indices + t * 3, baseIx );
+        }
+        const float patchThreshold = threshold * patchMisses / ( end - start );
+
+        clusters.push_back( start );
+        cache.Flush();
+        uint32_t misses = 0;
+        uint32_t faces = 0;
+        for ( uint32_t t = start; t < end; ++t )
+        {
+            misses += AccessTriangle( cache, indices + t * 3, baseIx );
+            ++faces;
+            if ( ( static_cast<float>( misses ) / faces ) <= patchThreshold )
+            {
+                clusters.push_back( t + 1 );
+                cache.Flush();
+                misses = 0;
+                faces = 0;
+            }
+        }
+        // A cut on the last triangle leaves an empty cluster behind
+        if ( clusters.back() == end )
+        {
+            clusters.pop_back();
+        }
+    }
+    const size_t clusterCount = clusters.size();
+    clusters.push_back( triangleCount );
+
+    // Area weighted centroid and summed normal of each cluster. Triangle areas
+    // are left doubled, which cancels out of every weighted average.
+    std::vector<float> clusterAreas( clusterCount );
+    std::vector<float> clusterCentroids( clusterCount * 3 );     // Area weighted sums
+    std::vector<float> clusterNormals( clusterCount * 3 );
+    float meshArea = 0.0f;
+    float meshCentroid[ 3 ] = { 0.0f, 0.0f, 0.0f };
+    for ( size_t clusterIx = 0; clusterIx < clusterCount; ++clusterIx )
+    {
+        float area = 0.0f;
+        float* centroid = &clusterCentroids[ clusterIx * 3 ];
+        float* normal = &clusterNormals[ clusterIx * 3 ];
+        for ( uint32_t t = clusters[ clusterIx ]; t < clusters[ clusterIx + 1 ]; ++t )
+        {
+            const float* p0 = &vertices[ indices[ t * 3 + 0 ] ].pos[ 0 ];
+            const float* p1 = &vertices[ indices[ t * 3 + 1 ] ].pos[ 0 ];
+            const float* p2 = &vertices[ indices[ t * 3 + 2 ] ].pos[ 0 ];
+            const float e1[ 3 ] = { p1[ 0 ] - p0[ 0 ], p1[ 1 ] - p0[ 1 ], p1[ 2 ] - p0[ 2 ] };
+            const float e2[ 3 ] = { p2[ 0 ] - p0[ 0 ], p2[ 1 ] - p0[ 1 ], p2[ 2 ] - p0[ 2 ] };
+            const float n[ 3 ] = { e1[ 1 ] * e2[ 2 ] - e1[ 2 ] * e2[ 1 ], e1[ 2 ] * e2[ 0 ] - e1[ 0 ] * e2[ 2 ], e1[ 0 ] * e2[ 1 ] - e1[ 1 ] * e2[ 0 ] };
+            const float triArea = sqrtf( n[ 0 ] * n[ 0 ] + n[ 1 ] * n[ 1 ] + n[ 2 ] * n[ 2 ] );
+            for ( uint32_t axis = 0; axis < 3; ++axis )
+            {
+                centroid[ axis ] += ( p0[ axis ] + p1[ axis ] + p2[ axis ] ) * ( triArea / 3.0f );
+                normal[ axis ] += n[ axis ];
+            }
+            area += triArea;
+        }
+        clusterAreas[ clusterIx ] = area;
+        meshArea += area;
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            meshCentroid[ axis ] += centroid[ axis ];
+        }
+    }
+    const float invMeshArea = ( meshArea > 0.0f ) ? ( 1.0f / meshArea ) : 0.0f;
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        meshCentroid[ axis ] *= invMeshArea;
+    }
+
+    // View-independent occlusion potential: clusters far out from the centroid
+    // along their own facing tend to occlude the rest, so they draw first
+    std::vector<float> sortKeys( clusterCount );
+    for ( size_t clusterIx = 0; clusterIx < clusterCount; ++clusterIx )
+    {
+        const float* centroid = &clusterCentroids[ clusterIx * 3 ];
+        const float* normal = &clusterNormals[ clusterIx * 3 ];
+        const float area = clusterAreas[ clusterIx ];
+        const float invArea = ( area > 0.0f ) ? ( 1.0f / area ) : 0.0f;
+        const float normalLength = sqrtf( normal[ 0 ] * normal[ 0 ] + normal[ 1 ] * normal[ 1 ] + normal[ 2 ] * normal[ 2 ] );
+        const float invNormalLength = ( normalLength > 0.0f ) ? ( 1.0f / normalLength ) : 0.0f;
+        float key = 0.0f;
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            key += ( centroid[ axis ] * invArea - meshCentroid[ axis ] ) * normal[ axis ] * invNormalLength;
+        }
+        sortKeys[ clusterIx ] = key;
+    }
+
+    std::vector<uint32_t> order( clusterCount );
+    for ( uint32_t clusterIx = 0; clusterIx < clusterCount; ++clusterIx )
+    {
+        order[ clusterIx ] = clusterIx;
+    }
+    std::stable_sort( order.begin(), order.end(), [&]( const uint32_t a, const uint32_t b )
+    {
+        return sortKeys[ a ] > sortKeys[ b ];
+    } );
+
+    size_t outCount = 0;
+    for ( const uint32_t clusterIx : order )
+    {
+        const size_t first = static_cast<size_t>( clusters[ clusterIx ] ) * 3;
+        const size_t count = static_cast<size_t>( clusters[ clusterIx + 1 ] - clusters[ clusterIx ] ) * 3;
+        memcpy( dst + outCount, indices + first, count * sizeof( uint32_t ) );
+        outCount += count;
+    }
+    return clusterCount;
+}
+
+
+uint32_t BuildVertexFetchRemap( uint32_t* remap, const uint32_t* indices, const size_t indexCount, uint32_t nextVertex )
+{
+    for ( size_t i = 0; i < indexCount; ++i )
+    {
+        uint32_t& newIx = remap[ indices[ i ] ];
+        if ( newIx == NoVertex )
+        {
+            newIx = nextVertex++;
+        }
+    }
+    return nextVertex;
+}
+
+
+vertexFetchStats_t AnalyzeVertexFetch( const uint32_t* indices, const size_t indexCount, const size_t vertexSize )
+{
+    static const uint64_t LineSize = 64;
+    static const uint32_t LineCount = 256;
+
+    uint32_t baseIx;
+    uint32_t vertexCount;
+    IndexRange( indices, indexCount, baseIx, vertexCount );
+
+    // Vertices are only fetched when they miss the post-transform cache, and then
+    // line by line through a small direct mapped cache
+    fifoCache_t vertexCache( vertexCount, VertexCacheSize );
+    std::vector<uint64_t> lineTags( LineCount, ~0ull );
+    vertexFetchStats_t stats;
+    stats.fetchedBytes = 0;
+    stats.uniqueBytes = 0;
+    for ( size_t i = 0; i < indexCount; ++i )
+    {
+        const uint32_t v = indices[ i ] - baseIx;
+        stats.uniqueBytes += vertexCache.IsSeen( v ) ? 0 : vertexSize;
+        if ( vertexCache.Access( v ) == 0 )
+        {
+            continue;
+        }
+        const uint64_t first = ( static_cast<uint64_t>( indices[ i ] ) * vertexSize ) / LineSize;
+        const uint64_t last = ( static_cast<uint64_t>( indices[ i ] ) * vertexSize + vertexSize - 1 ) / LineSize;
+        for ( uint64_t line = first; line <= last; ++line )
+        {
+            uint64_t& tag = lineTags[ line % LineCount ];
+            if ( tag != line )
+            {
+                tag = line;
+                stats.fetchedBytes += LineSize;
+            }
+        }
+    }
+    return stats;
+}
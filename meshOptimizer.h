@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "../GfxCore/geom.h"
+
+// Reorders triangle lists for the GPU. Indices may be any range of a shared vertex
+// buffer; passes only allocate for the span between the lowest and highest index.
+
+// Entries of the FIFO cache the optimizer targets and the analyzer simulates by default
+static const uint32_t VertexCacheSize = 16;
+static const uint32_t NoVertex = ~0u;
+
+struct vertexCacheStats_t
+{
+    size_t  triangleCount;
+    size_t  vertexCount;        // Distinct vertices referenced
+    size_t  transformCount;     // Cache misses
+
+    void    Add( const vertexCacheStats_t& other )
+    {
+        triangleCount += other.triangleCount;
+        vertexCount += other.vertexCount;
+        transformCount += other.transformCount;
+    }
+
+    // Average cache miss ratio, transforms per triangle. 0.5 is the floor for a regular grid.
+    double  Acmr() const { return ( triangleCount > 0 ) ? static_cast<double>( transformCount ) / triangleCount : 0.0; }
+    // Average transform to vertex ratio. 1.0 means every vertex is transformed once.
+    double  Atvr() const { return ( vertexCount > 0 ) ? static_cast<double>( transformCount ) / vertexCount : 0.0; }
+};
+
+struct vertexFetchStats_t
+{
+    uint64_t    fetchedBytes;
+    uint64_t    uniqueBytes;        // Size of the distinct vertices referenced
+
+    void        Add( const vertexFetchStats_t& other )
+    {
+        fetchedBytes += other.fetchedBytes;
+        uniqueBytes += other.uniqueBytes;
+    }
+
+    // 1.0 means each vertex is read once
+    double      Overfetch() const { return ( uniqueBytes > 0 ) ? static_cast<double>( fetchedBytes ) / uniqueBytes : 0.0; }
+};
+
+// Lowest index and span of a triangle list, so passes can size per-vertex arrays
+// to the vertices actually used
+void                IndexRange( const uint32_t* indices, const size_t indexCount, uint32_t& baseIx, uint32_t& vertexCount );
+
+// Forsyth's linear-speed optimizer. Each step emits the best scoring triangle
+// adjacent to the simulated cache, scored by the cache position and remaining
+// triangle count of its vertices; dead ends restart from the first unemitted
+// triangle in input order. indexCount must be a multiple of 3 and dst may not
+// alias indices.
+void                OptimizeVertexCache( uint32_t* dst, const uint32_t* indices, const size_t indexCount );
+
+vertexCacheStats_t  AnalyzeVertexCache( const uint32_t* indices, const size_t indexCount, const uint32_t cacheSize = VertexCacheSize );
+
+// Splits a vertex cache optimized list into clusters and sorts them so the ones
+// most likely to occlude others, judged from their facing and distance from the
+// surface centroid, draw first. threshold is the ACMR a cluster may reach relative
+// to its patch, e.g. 1.05; higher allows smaller clusters. Returns the cluster count.
+size_t              OptimizeOverdraw( uint32_t* dst, const uint32_t* indices, const size_t indexCount, const vertex_t* vertices, const float threshold );
+
+// Numbers vertices by first use, remap[ old ] = new. remap starts out filled with
+// NoVertex; call once per index buffer sharing the VB, in draw order, passing the
+// previous return value as nextVertex. Entries still NoVertex were never used.
+uint32_t            BuildVertexFetchRemap( uint32_t* remap, const uint32_t* indices, const size_t indexCount, uint32_t nextVertex );
+
+// Simulates vertex reads behind the post-transform cache through a 16KB direct
+// mapped cache of 64-byte lines
+vertexFetchStats_t  AnalyzeVertexFetch( const uint32_t* indices, const size_t indexCount, const size_t vertexSize );
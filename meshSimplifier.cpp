@@ -0,0 +1,665 @@
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <numeric>
+#include "meshSimplifier.h"
+#include "meshOptimizer.h"
+
+// Open edges get planes through them, perpendicular to their triangle, weighted
+// well above the surface so borders and seams keep their shape
+static const float EdgeWeight = 10.0f;
+static const uint32_t CollapseSortBits = 11;
+// A collapse may not turn a triangle further than this, cos( 75 degrees ), which
+// also keeps it from folding into a sliver
+static const float FlipCosine = 0.25f;
+
+
+static inline void Cross( const float a[ 3 ], const float b[ 3 ], float result[ 3 ] )
+{
+    result[ 0 ] = a[ 1 ] * b[ 2 ] - a[ 2 ] * b[ 1 ];
+    result[ 1 ] = a[ 2 ] * b[ 0 ] - a[ 0 ] * b[ 2 ];
+    result[ 2 ] = a[ 0 ] * b[ 1 ] - a[ 1 ] * b[ 0 ];
+}
+
+
+static inline float Dot( const float a[ 3 ], const float b[ 3 ] )
+{
+    return a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ];
+}
+
+
+static inline void Subtract( const float a[ 3 ], const float b[ 3 ], float result[ 3 ] )
+{
+    result[ 0 ] = a[ 0 ] - b[ 0 ];
+    result[ 1 ] = a[ 1 ] - b[ 1 ];
+    result[ 2 ] = a[ 2 ] - b[ 2 ];
+}
+
+
+// Scales v to unit length and returns its length, leaving zero vectors alone
+static inline float Normalize( float v[ 3 ] )
+{
+    const float length = sqrtf( Dot( v, v ) );
+    if ( length > 0.0f )
+    {
+        v[ 0 ] /= length;
+        v[ 1 ] /= length;
+        v[ 2 ] /= length;
+    }
+    return length;
+}
+
+
+static inline uint32_t HashPosition( const uint32_t bits[ 3 ] )
+{
+    uint32_t h = bits[ 0 ] * 0x9E3779B1u;
+    h = ( h ^ ( h >> 15 ) ^ bits[ 1 ] ) * 0x85EBCA77u;
+    h = ( h ^ ( h >> 13 ) ^ bits[ 2 ] ) * 0xC2B2AE3Du;
+    return h ^ ( h >> 16 );
+}
+
+
+void MeshSimplifier::quadric_t::AddPlane( const float normal[ 3 ], const float distance, const float planeWeight )
+{
+    a00 += planeWeight * normal[ 0 ] * normal[ 0 ];
+    a11 += planeWeight * normal[ 1 ] * normal[ 1 ];
+    a22 += planeWeight * normal[ 2 ] * normal[ 2 ];
+    a10 += planeWeight * normal[ 1 ] * normal[ 0 ];
+    a20 += planeWeight * normal[ 2 ] * normal[ 0 ];
+    a21 += planeWeight * normal[ 2 ] * normal[ 1 ];
+    b0 += planeWeight * normal[ 0 ] * distance;
+    b1 += planeWeight * normal[ 1 ] * distance;
+    b2 += planeWeight * normal[ 2 ] * distance;
+    c += planeWeight * distance * distance;
+    weight += planeWeight;
+}
+
+
+void MeshSimplifier::quadric_t::Add( const quadric_t& other )
+{
+    a00 += other.a00;
+    a11 += other.a11;
+    a22 += other.a22;
+    a10 += other.a10;
+    a20 += other.a20;
+    a21 += other.a21;
+    b0 += other.b0;
+    b1 += other.b1;
+    b2 += other.b2;
+    c += other.c;
+    weight += other.weight;
+}
+
+
+float MeshSimplifier::quadric_t::Error( const float p[ 3 ] ) const
+{
+    const float rx = a00 * p[ 0 ] + a10 * p[ 1 ] + a20 * p[ 2 ];
+    const float ry = a10 * p[ 0 ] + a11 * p[ 1 ] + a21 * p[ 2 ];
+    const float rz = a20 * p[ 0 ] + a21 * p[ 1 ] + a22 * p[ 2 ];
+    const float r = rx * p[ 0 ] + ry * p[ 1 ] + rz * p[ 2 ] + 2.0f * ( b0 * p[ 0 ] + b1 * p[ 1 ] + b2 * p[ 2 ] ) + c;
+    return ( weight > 0.0f ) ? ( fabsf( r ) / weight ) : 0.0f;
+}
+
+
+MeshSimplifier::MeshSimplifier( const uint32_t* srcIndices, const size_t indexCount, const vertex_t* vertices )
+{
+    IndexRange( srcIndices, indexCount, baseIx, vertexCount );
+    maxError = 0.0f;
+
+    // Triangles with a repeated index have no edges to collapse
+    indices.reserve( indexCount );
+    for ( size_t i = 0; ( i + 3 ) <= indexCount; i += 3 )
+    {
+        const uint32_t a = srcIndices[ i + 0 ] - baseIx;
+        const uint32_t b = srcIndices[ i + 1 ] - baseIx;
+        const uint32_t c = srcIndices[ i + 2 ] - baseIx;
+        if ( ( a != b ) && ( a != c ) && ( b != c ) )
+        {
+            indices.push_back( a );
+            indices.push_back( b );
+            indices.push_back( c );
+        }
+    }
+
+    BuildPositionRemap( vertices + baseIx );
+    BuildAdjacency();
+    BuildQuadrics();
+}
+
+
+// Welds positions bit for bit, ignoring the other attributes. Positions are also
+// rescaled so that errors and float precision don't depend on the model's units.
+void MeshSimplifier::BuildPositionRemap( const vertex_t* vertices )
+{
+    float minPos[ 3 ] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxPos[ 3 ] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            minPos[ axis ] = std::min( minPos[ axis ], vertices[ v ].pos[ axis ] );
+            maxPos[ axis ] = std::max( maxPos[ axis ], vertices[ v ].pos[ axis ] );
+        }
+    }
+    float extent = 0.0f;
+    for ( uint32_t axis = 0; ( axis < 3 ) && ( vertexCount > 0 ); ++axis )
+    {
+        extent = std::max( extent, maxPos[ axis ] - minPos[ axis ] );
+    }
+    const float scale = ( extent > 0.0f ) ? ( 1.0f / extent ) : 0.0f;
+
+    positions.resize( static_cast<size_t>( vertexCount ) * 3 );
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            positions[ v * 3 + axis ] = ( vertices[ v ].pos[ axis ] - minPos[ axis ] ) * scale;
+        }
+    }
+
+    size_t slotCount = 16;
+    while ( slotCount < ( static_cast<size_t>( vertexCount ) * 2 ) )
+    {
+        slotCount *= 2;
+    }
+    const size_t slotMask = slotCount - 1;
+    std::vector<uint32_t> slots( slotCount, NoVertex );
+
+    remap.resize( vertexCount );
+    wedge.resize( vertexCount );
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        uint32_t bits[ 3 ];
+        memcpy( bits, &vertices[ v ].pos[ 0 ], sizeof( bits ) );
+
+        for ( size_t slot = HashPosition( bits ) & slotMask; ; slot = ( slot + 1 ) & slotMask )
+        {
+            uint32_t& entry = slots[ slot ];
+            if ( entry == NoVertex )
+            {
+                entry = v;
+                remap[ v ] = v;
+                break;
+            }
+            if ( memcmp( &vertices[ entry ].pos[ 0 ], bits, sizeof( bits ) ) == 0 )
+            {
+                remap[ v ] = entry;
+                break;
+            }
+        }
+
+        wedge[ v ] = v;
+        if ( remap[ v ] != v )
+        {
+            wedge[ v ] = wedge[ remap[ v ] ];
+            wedge[ remap[ v ] ] = v;
+        }
+    }
+}
+
+
+void MeshSimplifier::BuildAdjacency()
+{
+    adjacencyOffsets.assign( static_cast<size_t>( vertexCount ) + 1, 0 );
+    for ( const uint32_t v : indices )
+    {
+        ++adjacencyOffsets[ v + 1 ];
+    }
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        adjacencyOffsets[ v + 1 ] += adjacencyOffsets[ v ];
+    }
+
+    adjacency.resize( indices.size() );
+    std::vector<uint32_t> fill( adjacencyOffsets.begin(), adjacencyOffsets.end() - 1 );
+    for ( size_t i = 0; i < indices.size(); i += 3 )
+    {
+        const uint32_t a = indices[ i + 0 ];
+        const uint32_t b = indices[ i + 1 ];
+        const uint32_t c = indices[ i + 2 ];
+        adjacency[ fill[ a ]++ ] = { b, c };
+        adjacency[ fill[ b ]++ ] = { c, a };
+        adjacency[ fill[ c ]++ ] = { a, b };
+    }
+}
+
+
+bool MeshSimplifier::HasEdge( const uint32_t a, const uint32_t b ) const
+{
+    for ( uint32_t i = adjacencyOffsets[ a ]; i < adjacencyOffsets[ a + 1 ]; ++i )
+    {
+        if ( adjacency[ i ].next == b )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+// Whether some triangle has an edge from a's position to b's
+bool MeshSimplifier::HasPositionEdge( const uint32_t a, const uint32_t b ) const
+{
+    uint32_t w = a;
+    do
+    {
+        for ( uint32_t i = adjacencyOffsets[ w ]; i < adjacencyOffsets[ w + 1 ]; ++i )
+        {
+            if ( remap[ adjacency[ i ].next ] == remap[ b ] )
+            {
+                return true;
+            }
+        }
+        w = wedge[ w ];
+    } while ( w != a );
+    return false;
+}
+
+
+// The other vertex in use at v's position, for vertices on a seam
+uint32_t MeshSimplifier::SeamPartner( const uint32_t v ) const
+{
+    for ( uint32_t w = wedge[ v ]; w != v; w = wedge[ w ] )
+    {
+        if ( adjacencyOffsets[ w + 1 ] > adjacencyOffsets[ w ] )
+        {
+            return w;
+        }
+    }
+    return NoVertex;
+}
+
+
+void MeshSimplifier::BuildQuadrics()
+{
+    quadric_t zero;
+    memset( &zero, 0, sizeof( zero ) );
+    quadrics.assign( vertexCount, zero );
+
+    for ( size_t i = 0; i < indices.size(); i += 3 )
+    {
+        const uint32_t* tri = &indices[ i ];
+        float e1[ 3 ];
+        float e2[ 3 ];
+        float normal[ 3 ];
+        Subtract( Position( tri[ 1 ] ), Position( tri[ 0 ] ), e1 );
+        Subtract( Position( tri[ 2 ] ), Position( tri[ 0 ] ), e2 );
+        Cross( e1, e2, normal );
+        const float area = Normalize( normal );
+        if ( area == 0.0f )
+        {
+            continue;
+        }
+
+        const float distance = -Dot( normal, Position( tri[ 0 ] ) );
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+            quadrics[ remap[ tri[ k ] ] ].AddPlane( normal, distance, area );
+        }
+
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+            const uint32_t a = tri[ k ];
+            const uint32_t b = tri[ ( k + 1 ) % 3 ];
+            if ( HasEdge( b, a ) )
+            {
+                continue;
+            }
+
+            float edge[ 3 ];
+            Subtract( Position( b ), Position( a ), edge );
+            const float length = Normalize( edge );
+            float edgeNormal[ 3 ];
+            Cross( edge, normal, edgeNormal );
+            Normalize( edgeNormal );
+
+            // A seam edge is open on both of its sides, and each adds a plane
+            const float weight = HasPositionEdge( b, a ) ? ( EdgeWeight * 0.5f ) : EdgeWeight;
+            const float edgeDistance = -Dot( edgeNormal, Position( a ) );
+            quadrics[ remap[ a ] ].AddPlane( edgeNormal, edgeDistance, length * length * weight );
+            quadrics[ remap[ b ] ].AddPlane( edgeNormal, edgeDistance, length * length * weight );
+        }
+    }
+}
+
+
+// A vertex is on a border when it has one open edge each way and nothing else is
+// at its position. It is on a seam when the same holds for it and the one other
+// vertex at its position, and their open edges face each other.
+void MeshSimplifier::ClassifyVertices()
+{
+    kinds.assign( vertexCount, VERTEX_LOCKED );
+    loopOut.assign( vertexCount, NoVertex );
+    loopIn.assign( vertexCount, NoVertex );
+
+    std::vector<uint8_t> openOut( vertexCount, 0 );
+    std::vector<uint8_t> openIn( vertexCount, 0 );
+    std::vector<uint8_t> wedgeCounts( vertexCount, 0 );
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        if ( adjacencyOffsets[ v + 1 ] == adjacencyOffsets[ v ] )
+        {
+            continue;
+        }
+        wedgeCounts[ remap[ v ] ] = static_cast<uint8_t>( std::min( wedgeCounts[ remap[ v ] ] + 1, 3 ) );
+
+        for ( uint32_t i = adjacencyOffsets[ v ]; i < adjacencyOffsets[ v + 1 ]; ++i )
+        {
+            const uint32_t next = adjacency[ i ].next;
+            if ( !HasEdge( next, v ) )
+            {
+                openOut[ v ] = static_cast<uint8_t>( std::min( openOut[ v ] + 1, 2 ) );
+                openIn[ next ] = static_cast<uint8_t>( std::min( openIn[ next ] + 1, 2 ) );
+                loopOut[ v ] = next;
+                loopIn[ next ] = v;
+            }
+        }
+    }
+
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        const uint32_t wedgeCount = wedgeCounts[ remap[ v ] ];
+        const bool oneLoop = ( openOut[ v ] == 1 ) && ( openIn[ v ] == 1 );
+        if ( ( adjacencyOffsets[ v + 1 ] == adjacencyOffsets[ v ] ) || ( wedgeCount > 2 ) )
+        {
+            continue;
+        }
+        if ( ( wedgeCount == 1 ) && ( openOut[ v ] == 0 ) && ( openIn[ v ] == 0 ) )
+        {
+            kinds[ v ] = VERTEX_MANIFOLD;
+        }
+        else if ( oneLoop && ( HasPositionEdge( loopOut[ v ], v ) == ( wedgeCount == 2 ) ) && ( HasPositionEdge( v, loopIn[ v ] ) == ( wedgeCount == 2 ) ) )
+        {
+            kinds[ v ] = ( wedgeCount == 2 ) ? VERTEX_SEAM : VERTEX_BORDER;
+        }
+    }
+
+    // Both sides of a seam have to qualify
+    for ( uint32_t v = 0; v < vertexCount; ++v )
+    {
+        if ( ( kinds[ v ] == VERTEX_SEAM ) && ( kinds[ SeamPartner( v ) ] != VERTEX_SEAM ) )
+        {
+            kinds[ v ] = VERTEX_LOCKED;
+        }
+    }
+}
+
+
+bool MeshSimplifier::CanCollapse( const uint32_t v0, const uint32_t v1 ) const
+{
+    const bool alongLoop = ( loopOut[ v0 ] == v1 ) || ( loopIn[ v0 ] == v1 );
+    switch ( kinds[ v0 ] )
+    {
+    case VERTEX_MANIFOLD:
+        // Not when v0 also touches another vertex at v1's position, since those
+        // triangles would take on v1's attributes
+        for ( uint32_t i = adjacencyOffsets[ v0 ]; i < adjacencyOffsets[ v0 + 1 ]; ++i )
+        {
+            const corner_t& corner = adjacency[ i ];
+            if ( ( ( remap[ corner.next ] == remap[ v1 ] ) && ( corner.next != v1 ) ) || ( ( remap[ corner.prev ] == remap[ v1 ] ) && ( corner.prev != v1 ) ) )
+            {
+                return false;
+            }
+        }
+        return true;
+    case VERTEX_BORDER:
+        return alongLoop && ( kinds[ v1 ] == VERTEX_BORDER );
+    case VERTEX_SEAM:
+    {
+        if ( !alongLoop || ( kinds[ v1 ] != VERTEX_SEAM ) )
+        {
+            return false;
+        }
+        // The other side runs the opposite way
+        const uint32_t s0 = SeamPartner( v0 );
+        const uint32_t s1 = ( loopOut[ v0 ] == v1 ) ? loopIn[ s0 ] : loopOut[ s0 ];
+        return ( s1 != NoVertex ) && ( remap[ s1 ] == remap[ v1 ] );
+    }
+    default:
+        return false;
+    }
+}
+
+
+float MeshSimplifier::CollapseError( const uint32_t v0, const uint32_t v1 ) const
+{
+    quadric_t q = quadrics[ remap[ v0 ] ];
+    q.Add( quadrics[ remap[ v1 ] ] );
+    return q.Error( Position( v1 ) );
+}
+
+
+// Whether moving v0 onto v1 turns any of the triangles around v0's position over
+// or on edge
+bool MeshSimplifier::FlipsTriangle( const uint32_t v0, const uint32_t v1 ) const
+{
+    const float* p1 = Position( v1 );
+    uint32_t w = v0;
+    do
+    {
+        const float* p0 = Position( w );
+        for ( uint32_t i = adjacencyOffsets[ w ]; i < adjacencyOffsets[ w + 1 ]; ++i )
+        {
+            const corner_t& corner = adjacency[ i ];
+            if ( ( remap[ corner.next ] == remap[ v1 ] ) || ( remap[ corner.prev ] == remap[ v1 ] ) )
+            {
+                // Collapses away
+                continue;
+            }
+
+            const float* pb = Position( corner.next );
+            const float* pc = Position( corner.prev );
+            float e1[ 3 ];
+            float e2[ 3 ];
+            float before[ 3 ];
+            float after[ 3 ];
+            Subtract( pb, p0, e1 );
+            Subtract( pc, p0, e2 );
+            Cross( e1, e2, before );
+            Subtract( pb, p1, e1 );
+            Subtract( pc, p1, e2 );
+            Cross( e1, e2, after );
+            if ( Dot( before, after ) <= ( FlipCosine * sqrtf( Dot( before, before ) * Dot( after, after ) ) ) )
+            {
+                return true;
+            }
+        }
+        w = wedge[ w ];
+    } while ( w != v0 );
+    return false;
+}
+
+
+// Counting sort on the top bits of the errors, which order like the non-negative
+// floats they are. Close errors may come out of order, which costs nothing.
+void MeshSimplifier::SortCollapses( std::vector<collapse_t>& collapses )
+{
+    static const uint32_t BucketCount = 1u << CollapseSortBits;
+
+    std::vector<uint32_t> bucketOffsets( BucketCount + 1, 0 );
+    const auto key = []( const collapse_t& collapse )
+    {
+        uint32_t bits;
+        memcpy( &bits, &collapse.error, sizeof( bits ) );
+        return bits >> ( 32 - CollapseSortBits );
+    };
+    for ( const collapse_t& collapse : collapses )
+    {
+        ++bucketOffsets[ key( collapse ) + 1 ];
+    }
+    std::partial_sum( bucketOffsets.begin(), bucketOffsets.end(), bucketOffsets.begin() );
+
+    std::vector<collapse_t> sorted( collapses.size() );
+    for ( const collapse_t& collapse : collapses )
+    {
+        sorted[ bucketOffsets[ key( collapse ) ]++ ] = collapse;
+    }
+    collapses.swap( sorted );
+}
+
+
+// Performs collapses in order until the pass has removed about triangleGoal
+// triangles, or errors grow well past the one a collapse per two triangles would
+// have reached.
+size_t MeshSimplifier::PerformCollapses( const std::vector<collapse_t>& collapses, const size_t triangleGoal, const float errorLimit )
+{
+    const size_t edgeGoal = triangleGoal / 2;
+
+    collapseRemap.resize( vertexCount );
+    std::iota( collapseRemap.begin(), collapseRemap.end(), 0 );
+    collapseLocked.assign( vertexCount, 0 );
+
+    size_t performed = 0;
+    size_t triangles = 0;
+    size_t flipped = 0;
+    for ( const collapse_t& collapse : collapses )
+    {
+        // Collapses that would flip stay that way, so they don't count toward the
+        // goal. Locked ones can go next pass.
+        const size_t limitIx = edgeGoal + flipped;
+        const float passLimit = ( limitIx < collapses.size() ) ? ( collapses[ limitIx ].error * 1.5f ) : FLT_MAX;
+        if ( ( collapse.error > errorLimit ) || ( collapse.error > passLimit ) || ( triangles >= triangleGoal ) )
+        {
+            break;
+        }
+
+        const uint32_t v0 = collapse.v0;
+        const uint32_t v1 = collapse.v1;
+        const uint32_t r0 = remap[ v0 ];
+        const uint32_t r1 = remap[ v1 ];
+        if ( ( collapseLocked[ r0 ] != 0 ) || ( collapseLocked[ r1 ] != 0 ) )
+        {
+            continue;
+        }
+        if ( FlipsTriangle( v0, v1 ) )
+        {
+            ++flipped;
+            continue;
+        }
+
+        if ( kinds[ v0 ] == VERTEX_SEAM )
+        {
+            const uint32_t s0 = SeamPartner( v0 );
+            collapseRemap[ s0 ] = ( loopOut[ v0 ] == v1 ) ? loopIn[ s0 ] : loopOut[ s0 ];
+        }
+        collapseRemap[ v0 ] = v1;
+        quadrics[ r1 ].Add( quadrics[ r0 ] );
+
+        // Every triangle this changes is around v0, and locking its neighbors too
+        // leaves them to this collapse alone, so the flip test saw them as they end up
+        uint32_t w = v0;
+        do
+        {
+            for ( uint32_t i = adjacencyOffsets[ w ]; i < adjacencyOffsets[ w + 1 ]; ++i )
+            {
+                collapseLocked[ remap[ adjacency[ i ].next ] ] = 1;
+                collapseLocked[ remap[ adjacency[ i ].prev ] ] = 1;
+            }
+            w = wedge[ w ];
+        } while ( w != v0 );
+        collapseLocked[ r0 ] = 1;
+
+        maxError = std::max( maxError, collapse.error );
+        triangles += ( kinds[ v0 ] == VERTEX_BORDER ) ? 1 : 2;
+        ++performed;
+    }
+    return performed;
+}
+
+
+void MeshSimplifier::Simplify( const size_t targetIndexCount, const float maxError )
+{
+    const size_t target = targetIndexCount - ( targetIndexCount % 3 );
+    const float errorLimit = maxError * maxError;
+    std::vector<collapse_t> collapses;
+
+    while ( indices.size() > target )
+    {
+        ClassifyVertices();
+
+        collapses.clear();
+        for ( size_t i = 0; i < indices.size(); i += 3 )
+        {
+            for ( uint32_t k = 0; k < 3; ++k )
+            {
+                const uint32_t a = indices[ i + k ];
+                const uint32_t b = indices[ i + ( k + 1 ) % 3 ];
+
+                // Interior edges are in two triangles, take them from one
+                if ( ( a > b ) && HasEdge( b, a ) )
+                {
+                    continue;
+                }
+                const bool forward = CanCollapse( a, b );
+                const bool backward = CanCollapse( b, a );
+                if ( !forward && !backward )
+                {
+                    continue;
+                }
+
+                collapse_t collapse;
+                collapse.v0 = forward ? a : b;
+                collapse.v1 = forward ? b : a;
+                collapse.bidirectional = ( forward && backward ) ? 1 : 0;
+                collapses.push_back( collapse );
+            }
+        }
+        if ( collapses.empty() )
+        {
+            break;
+        }
+
+        for ( collapse_t& collapse : collapses )
+        {
+            collapse.error = CollapseError( collapse.v0, collapse.v1 );
+            if ( collapse.bidirectional != 0 )
+            {
+                const float reverseError = CollapseError( collapse.v1, collapse.v0 );
+                if ( reverseError < collapse.error )
+                {
+                    std::swap( collapse.v0, collapse.v1 );
+                    collapse.error = reverseError;
+                }
+            }
+        }
+        SortCollapses( collapses );
+
+        if ( PerformCollapses( collapses, ( indices.size() - target ) / 3, errorLimit ) == 0 )
+        {
+            break;
+        }
+
+        // Triangles left with two corners at one position have no area either
+        size_t kept = 0;
+        for ( size_t i = 0; i < indices.size(); i += 3 )
+        {
+            const uint32_t a = collapseRemap[ indices[ i + 0 ] ];
+            const uint32_t b = collapseRemap[ indices[ i + 1 ] ];
+            const uint32_t c = collapseRemap[ indices[ i + 2 ] ];
+            if ( ( remap[ a ] != remap[ b ] ) && ( remap[ a ] != remap[ c ] ) && ( remap[ b ] != remap[ c ] ) )
+            {
+                indices[ kept++ ] = a;
+                indices[ kept++ ] = b;
+                indices[ kept++ ] = c;
+            }
+        }
+        indices.resize( kept );
+        BuildAdjacency();
+    }
+}
+
+
+void MeshSimplifier::GetIndices( uint32_t* dst ) const
+{
+    for ( size_t i = 0; i < indices.size(); ++i )
+    {
+        dst[ i ] = indices[ i ] + baseIx;
+    }
+}
+
+
+float MeshSimplifier::GetError() const
+{
+    return sqrtf( maxError );
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include "../GfxCore/geom.h"
+
+// Quadric error edge collapse over an indexed triangle list. Vertices are only
+// moved onto other existing vertices, so every level indexes the input's vertex
+// buffer. Vertices that share a position but differ in normal or uv form a seam,
+// which can only collapse along itself with both sides together; open borders
+// likewise collapse only along the border. Vertices where neither holds stay put.
+//
+// Each pass picks a candidate collapse per edge, sorts them by error and performs
+// the cheapest that don't touch a vertex already moved in the pass, so a pass is
+// linear in the triangle count and each removes a large fraction of them.
+class MeshSimplifier
+{
+public:
+    MeshSimplifier( const uint32_t* indices, const size_t indexCount, const vertex_t* vertices );
+
+    // Collapses edges until at most targetIndexCount indices are left, or no edge
+    // can collapse without an error over maxError, relative to the mesh extent.
+    // Call again with a lower target to continue from the result.
+    void                    Simplify( const size_t targetIndexCount, const float maxError );
+
+    size_t                  GetIndexCount() const { return indices.size(); }
+    void                    GetIndices( uint32_t* dst ) const;
+    // Largest collapse so far, as a distance relative to the mesh extent
+    float                   GetError() const;
+
+private:
+    enum vertexKind_t : uint8_t
+    {
+        VERTEX_MANIFOLD,
+        VERTEX_BORDER,
+        VERTEX_SEAM,
+        VERTEX_LOCKED,
+    };
+
+    // Symmetric 4x4 plane quadric, with the weight summed into it so errors come
+    // out as a weighted mean of squared distances
+    struct quadric_t
+    {
+        float   a00, a11, a22, a10, a20, a21;
+        float   b0, b1, b2;
+        float   c;
+        float   weight;
+
+        void    AddPlane( const float normal[ 3 ], const float distance, const float planeWeight );
+        void    Add( const quadric_t& other );
+        float   Error( const float p[ 3 ] ) const;
+    };
+
+    // Triangle corner v as seen from v
+    struct corner_t
+    {
+        uint32_t    next;
+        uint32_t    prev;
+    };
+
+    struct collapse_t
+    {
+        uint32_t    v0;                 // Moves onto v1
+        uint32_t    v1;
+        float       error;
+        uint32_t    bidirectional;      // v1 may move onto v0 instead
+    };
+
+    const float*            Position( const uint32_t v ) const { return &positions[ v * 3 ]; }
+    void                    BuildPositionRemap( const vertex_t* vertices );
+    void                    BuildAdjacency();
+    bool                    HasEdge( const uint32_t a, const uint32_t b ) const;
+    bool                    HasPositionEdge( const uint32_t a, const uint32_t b ) const;
+    uint32_t                SeamPartner( const uint32_t v ) const;
+    void                    BuildQuadrics();
+    void                    ClassifyVertices();
+    bool                    CanCollapse( const uint32_t v0, const uint32_t v1 ) const;
+    float                   CollapseError( const uint32_t v0, const uint32_t v1 ) const;
+    bool                    FlipsTriangle( const uint32_t v0, const uint32_t v1 ) const;
+    static void             SortCollapses( std::vector<collapse_t>& collapses );
+    size_t                  PerformCollapses( const std::vector<collapse_t>& collapses, const size_t triangleGoal, const float errorLimit );
+
+    uint32_t                baseIx;
+    uint32_t                vertexCount;
+    std::vector<uint32_t>   indices;            // Relative to baseIx
+    std::vector<float>      positions;          // Scaled into the unit cube
+    std::vector<uint32_t>   remap;              // First vertex with the same position
+    std::vector<uint32_t>   wedge;              // Next vertex with the same position, a ring
+    std::vector<quadric_t>  quadrics;           // By remap
+    std::vector<uint32_t>   adjacencyOffsets;   // Corners of each vertex, rebuilt every pass
+    std::vector<corner_t>   adjacency;
+    std::vector<uint8_t>    kinds;
+    std::vector<uint32_t>   loopOut;            // Open edge leaving a border or seam vertex
+    std::vector<uint32_t>   loopIn;             // Open edge arriving at it
+    std::vector<uint32_t>   collapseRemap;
+    std::vector<uint8_t>    collapseLocked;     // By remap
+    float                   maxError;
+};
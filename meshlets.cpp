@@ -0,0 +1,175 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "meshlets.h"
+#include "bounds.h"
+
+static const uint8_t NotInMeshlet = 0xFF;
+
+
+static void Normalize( float v[ 3 ] )
+{
+    const float length = sqrtf( v[ 0 ] * v[ 0 ] + v[ 1 ] * v[ 1 ] + v[ 2 ] * v[ 2 ] );
+    const float scale = ( length > 0.0f ) ? ( 1.0f / length ) : 0.0f;
+    v[ 0 ] *= scale;
+    v[ 1 ] *= scale;
+    v[ 2 ] *= scale;
+}
+
+
+static float Dot( const float* a, const float* b )
+{
+    return a[ 0 ] * b[ 0 ] + a[ 1 ] * b[ 1 ] + a[ 2 ] * b[ 2 ];
+}
+
+
+// Sphere over the meshlet's triangle corners, and the cone that holds all of its
+// triangle normals
+static void ComputeMeshletBounds( mdlMeshlet_t& meshlet, const meshletSet_t& set, const vertex_t* vertices )
+{
+    if ( meshlet.triangleCount == 0 )
+    {
+        // Nothing to bound; a point sphere that is never backface culled
+        memset( meshlet.center, 0, sizeof( meshlet.center ) );
+        meshlet.radius = 0.0f;
+        memset( meshlet.coneApex, 0, sizeof( meshlet.coneApex ) );
+        memset( meshlet.coneAxis, 0, sizeof( meshlet.coneAxis ) );
+        meshlet.coneCutoff = 1.0f;
+        return;
+    }
+
+    const uint32_t* meshletVertices = set.vertices.data() + meshlet.vertexOffset;
+    const uint8_t* triangles = set.triangles.data() + meshlet.triangleOffset;
+
+    float corners[ MeshletMaxTriangles * 3 ][ 3 ];
+    float normals[ MeshletMaxTriangles ][ 3 ];  // Unit, zero for degenerate triangles
+    float facing[ MeshletMaxTriangles ][ 3 ];   // The non-zero normals, packed
+    uint32_t facingCount = 0;
+    for ( uint32_t t = 0; t < meshlet.triangleCount; ++t )
+    {
+        const float* p[ 3 ];
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+            p[ k ] = &vertices[ meshletVertices[ triangles[ t * 3 + k ] ] ].pos[ 0 ];
+            memcpy( corners[ t * 3 + k ], p[ k ], sizeof( corners[ 0 ] ) );
+        }
+
+        const float e1[ 3 ] = { p[ 1 ][ 0 ] - p[ 0 ][ 0 ], p[ 1 ][ 1 ] - p[ 0 ][ 1 ], p[ 1 ][ 2 ] - p[ 0 ][ 2 ] };
+        const float e2[ 3 ] = { p[ 2 ][ 0 ] - p[ 0 ][ 0 ], p[ 2 ][ 1 ] - p[ 0 ][ 1 ], p[ 2 ][ 2 ] - p[ 0 ][ 2 ] };
+        float* n = normals[ t ];
+        n[ 0 ] = e1[ 1 ] * e2[ 2 ] - e1[ 2 ] * e2[ 1 ];
+        n[ 1 ] = e1[ 2 ] * e2[ 0 ] - e1[ 0 ] * e2[ 2 ];
+        n[ 2 ] = e1[ 0 ] * e2[ 1 ] - e1[ 1 ] * e2[ 0 ];
+        Normalize( n );
+        if ( Dot( n, n ) > 0.0f )
+        {
+            // Degenerate triangles have no facing and don't constrain the cone
+            memcpy( facing[ facingCount++ ], n, sizeof( facing[ 0 ] ) );
+        }
+    }
+
+    ComputeBoundingSphere( corners[ 0 ], meshlet.triangleCount * 3, sizeof( corners[ 0 ] ), meshlet.center, meshlet.radius );
+
+    // The axis is the center of the normals' bounding sphere, the half angle the
+    // widest normal from it
+    float axisRadius;
+    ComputeBoundingSphere( facing[ 0 ], facingCount, sizeof( facing[ 0 ] ), meshlet.coneAxis, axisRadius );
+    Normalize( meshlet.coneAxis );
+
+    float minDot = 1.0f;
+    for ( uint32_t i = 0; i < facingCount; ++i )
+    {
+        minDot = std::min( minDot, Dot( facing[ i ], meshlet.coneAxis ) );
+    }
+
+    memcpy( meshlet.coneApex, meshlet.center, sizeof( meshlet.coneApex ) );
+    if ( ( facingCount == 0 ) || ( minDot <= 0.1f ) )
+    {
+        // Spans close to a hemisphere or more, can't be backface culled
+        meshlet.coneCutoff = 1.0f;
+        return;
+    }
+
+    // Pull the apex back along the axis until every triangle plane is in front of
+    // it, so the cone test holds for any camera position and not just distant ones
+    float maxT = 0.0f;
+    for ( uint32_t t = 0; t < meshlet.triangleCount; ++t )
+    {
+        const float* n = normals[ t ];
+        if ( Dot( n, n ) <= 0.0f )
+        {
+            continue;
+        }
+        const float* p0 = corners[ t * 3 ];
+        const float toCenter[ 3 ] = { meshlet.center[ 0 ] - p0[ 0 ], meshlet.center[ 1 ] - p0[ 1 ], meshlet.center[ 2 ] - p0[ 2 ] };
+        maxT = std::max( maxT, Dot( toCenter, n ) / Dot( meshlet.coneAxis, n ) );
+    }
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        meshlet.coneApex[ axis ] = meshlet.center[ axis ] - meshlet.coneAxis[ axis ] * maxT;
+    }
+
+    // Every normal is within a = acos( minDot ) of the axis, so a view direction
+    // within 90 - a degrees of the axis sees only backs: cos( 90 - a ) = sin( a )
+    meshlet.coneCutoff = sqrtf( 1.0f - minDot * minDot );
+}
+
+
+void BuildMeshlets( const uint32_t* indices, const size_t indexCount, const vertex_t* vertices, meshletSet_t& set )
+{
+    uint32_t maxIx = 0;
+    for ( size_t i = 0; i < indexCount; ++i )
+    {
+        maxIx = std::max( maxIx, indices[ i ] );
+    }
+    std::vector<uint8_t> local( ( indexCount > 0 ) ? ( static_cast<size_t>( maxIx ) + 1 ) : 0, NotInMeshlet );
+
+    mdlMeshlet_t meshlet;
+    memset( &meshlet, 0, sizeof( meshlet ) );
+    meshlet.vertexOffset = static_cast<uint32_t>( set.vertices.size() );
+    meshlet.triangleOffset = static_cast<uint32_t>( set.triangles.size() );
+
+    const auto close = [&]()
+    {
+        for ( uint32_t i = 0; i < meshlet.vertexCount; ++i )
+        {
+            local[ set.vertices[ meshlet.vertexOffset + i ] ] = NotInMeshlet;
+        }
+        ComputeMeshletBounds( meshlet, set, vertices );
+        set.meshlets.push_back( meshlet );
+        set.triangles.resize( ( set.triangles.size() + 3 ) & ~static_cast<size_t>( 3 ), 0 );
+
+        memset( &meshlet, 0, sizeof( meshlet ) );
+        meshlet.vertexOffset = static_cast<uint32_t>( set.vertices.size() );
+        meshlet.triangleOffset = static_cast<uint32_t>( set.triangles.size() );
+    };
+
+    for ( size_t t = 0; t < ( indexCount / 3 ); ++t )
+    {
+        const uint32_t* tri = indices + t * 3;
+        uint32_t newVertices = 0;
+        newVertices += ( local[ tri[ 0 ] ] == NotInMeshlet ) ? 1 : 0;
+        newVertices += ( ( local[ tri[ 1 ] ] == NotInMeshlet ) && ( tri[ 1 ] != tri[ 0 ] ) ) ? 1 : 0;
+        newVertices += ( ( local[ tri[ 2 ] ] == NotInMeshlet ) && ( tri[ 2 ] != tri[ 0 ] ) && ( tri[ 2 ] != tri[ 1 ] ) ) ? 1 : 0;
+        if ( ( ( meshlet.vertexCount + newVertices ) > MeshletMaxVertices ) || ( meshlet.triangleCount == MeshletMaxTriangles ) )
+        {
+            close();
+        }
+
+        for ( uint32_t k = 0; k < 3; ++k )
+        {
+            uint8_t& slot = local[ tri[ k ] ];
+            if ( slot == NotInMeshlet )
+            {
+                slot = static_cast<uint8_t>( meshlet.vertexCount++ );
+                set.vertices.push_back( tri[ k ] );
+            }
+            set.triangles.push_back( slot );
+        }
+        ++meshlet.triangleCount;
+    }
+    if ( meshlet.triangleCount > 0 )
+    {
+        close();
+    }
+}
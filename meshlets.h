@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "../GfxCore/geom.h"
+#include "modelFile.h"
+
+// Limits that suit mesh shaders on current GPUs. 124 triangles leaves room for
+// the primitive count in a 128-entry output.
+static const uint32_t MeshletMaxVertices = 64;
+static const uint32_t MeshletMaxTriangles = 124;
+
+// Meshlets of one or more triangle lists, laid out as in the .mdl sections
+struct meshletSet_t
+{
+    std::vector<mdlMeshlet_t>   meshlets;
+    std::vector<uint32_t>       vertices;
+    std::vector<uint8_t>        triangles;
+};
+
+// Appends the meshlets of a triangle list to set. Triangles are taken in order and
+// a meshlet closes when the next one would exceed either limit, so a vertex cache
+// optimized list gives compact meshlets. indices are relative to vertices, and
+// the meshlet vertices hold them as they are.
+void    BuildMeshlets( const uint32_t* indices, const size_t indexCount, const vertex_t* vertices, meshletSet_t& set );
@@ -0,0 +1,1715 @@
+#include <assert.h>
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <unordered_map>
+#include <iostream>
+#include "../GfxCore/util.h"
+#include "converter.h"
+#include "modelFile.h"
+#include "parallel.h"
+#include "vertexQuantizer.h"
+#include "indexCodec.h"
+#include "vertexCodec.h"
+#include "lzCodec.h"
+#include "checksum.h"
+#include "meshlets.h"
+#include "meshSimplifier.h"
+#include "meshOptimizer.h"
+#include "bounds.h"
+
+MdlWriter::MdlWriter()
+{
+    file = nullptr;
+    offset = 0;
+    sectionOpen = false;
+    compress = false;
+    threadCount = 0;
+    memset( &bounds, 0, sizeof( bounds ) );
+}
+
+
+MdlWriter::~MdlWriter()
+{
+    if ( file != nullptr )
+    {
+        // Abandoned before Finish(), don't leave a truncated model behind
+        fclose( file );
+        remove( path.c_str() );
+    }
+}
+
+
+void MdlWriter::Open( const std::string& path, const uint32_t threadCount )
+{
+#if defined( _WIN32 )
+    if ( fopen_s( &file, path.c_str(), "wb" ) != 0 )
+    {
+        file = nullptr;
+    }
+#else
+    file = fopen( path.c_str(), "wb" );
+#endif
+    if ( file == nullptr )
+    {
+        throw std::runtime_error( "Cannot create model file [" + path + "]" );
+    }
+
+    this->path = path;
+    this->threadCount = threadCount;
+    offset = 0;
+    sections.clear();
+    checksums.clear();
+    memset( &bounds, 0, sizeof( bounds ) );
+
+    // Placeholder, patched by Finish()
+    mdlHeader_t header;
+    memset( &header, 0, sizeof( header ) );
+    WriteFile( &header, sizeof( header ) );
+}
+
+
+void MdlWriter::Write( const void* data, const size_t size )
+{
+    if ( compress )
+    {
+        const uint8_t* bytes = static_cast<const uint8_t*>( data );
+        pending.insert( pending.end(), bytes, bytes + size );
+        return;
+    }
+    WriteFile( data, size );
+}
+
+
+void MdlWriter::WriteFile( const void* data, const size_t size )
+{
+    if ( ( size > 0 ) && ( fwrite( data, 1, size, file ) != size ) )
+    {
+        throw std::runtime_error( "Failed to write model file [" + path + "]" );
+    }
+    offset += size;
+    if ( sectionOpen )
+    {
+        checksums.back() = Crc32c( data, size, checksums.back() );
+    }
+}
+
+
+void MdlWriter::Pad()
+{
+    static const uint8_t zeros[ MdlSectionAlignment ] = {};
+    const size_t padding = static_cast<size_t>( ( MdlSectionAlignment - ( offset % MdlSectionAlignment ) ) % MdlSectionAlignment );
+    WriteFile( zeros, padding );
+}
+
+
+void MdlWriter::BeginSection( const uint32_t type, const uint32_t flags )
+{
+    assert( !sectionOpen );
+    Pad();
+
+    mdlSection_t section;
+    section.type = type;
+    section.flags = flags;
+    section.offset = offset;
+    section.size = 0;
+    section.count = 0;
+    sections.push_back( section );
+    checksums.push_back( 0 );
+    sectionOpen = true;
+    compress = ( flags & MDL_SECTION_FLAG_LZ ) != 0;
+    pending.clear();
+}
+
+
+void MdlWriter::WriteCompressed()
+{
+    const size_t rawSize = pending.size();
+    const uint32_t blockCount = static_cast<uint32_t>( ( rawSize + MdlLzBlockSize - 1 ) / MdlLzBlockSize );
+
+    std::vector<std::vector<uint8_t>> blocks( blockCount );
+    ParallelFor( blockCount, threadCount, [&]( const uint32_t blockIx )
+    {
+        const uint8_t* raw = pending.data() + static_cast<size_t>( blockIx ) * MdlLzBlockSize;
+        const size_t size = std::min<size_t>( MdlLzBlockSize, rawSize - static_cast<size_t>( blockIx ) * MdlLzBlockSize );
+        LzCompress( raw, size, blocks[ blockIx ] );
+        if ( blocks[ blockIx ].size() >= size )
+        {
+            blocks[ blockIx ].assign( raw, raw + size );
+        }
+    } );
+
+    mdlLzHeader_t header;
+    header.rawSize = rawSize;
+    header.blockSize = MdlLzBlockSize;
+    header.blockCount = blockCount;
+
+    std::vector<uint64_t> blockOffsets( blockCount + 1 );
+    blockOffsets[ 0 ] = sizeof( header ) + blockOffsets.size() * sizeof( uint64_t );
+    for ( uint32_t blockIx = 0; blockIx < blockCount; ++blockIx )
+    {
+        blockOffsets[ blockIx + 1 ] = blockOffsets[ blockIx ] + blocks[ blockIx ].size();
+    }
+
+    WriteFile( &header, sizeof( header ) );
+    WriteFile( blockOffsets.data(), blockOffsets.size() * sizeof( uint64_t ) );
+    for ( const std::vector<uint8_t>& block : blocks )
+    {
+        WriteFile( block.data(), block.size() );
+    }
+
+    pending.clear();
+    pending.shrink_to_fit();
+}
+
+
+void MdlWriter::EndSection( const uint64_t count )
+{
+    assert( sectionOpen );
+    if ( compress )
+    {
+        compress = false;
+        WriteCompressed();
+    }
+
+    mdlSection_t& section = sections.back();
+    section.size = offset - section.offset;
+    section.count = count;
+    sectionOpen = false;
+}
+
+
+void MdlWriter::Finish()
+{
+    assert( !sectionOpen );
+
+    // Taken before this section is added, so its own slot stays 0
+    std::vector<uint32_t> stored = checksums;
+    stored.push_back( 0 );
+    BeginSection( MDL_SECTION_CHECKSUMS );
+    Write( stored.data(), stored.size() * sizeof( uint32_t ) );
+    EndSection( stored.size() );
+    Pad();
+
+    mdlHeader_t header;
+    memset( &header, 0, sizeof( header ) );
+    header.magic = MdlMagic;
+    header.version = MdlVersion;
+    header.headerSize = sizeof( mdlHeader_t );
+    header.sectionCount = static_cast<uint32_t>( sections.size() );
+    header.sectionTableOffset = offset;
+    header.vertexStride = sizeof( vertex_t );
+    header.sectionTableChecksum = Crc32c( sections.data(), sections.size() * sizeof( mdlSection_t ) );
+    header.bounds = bounds;
+
+    WriteFile( sections.data(), sections.size() * sizeof( mdlSection_t ) );
+    header.fileSize = offset;
+
+    if ( ( fseek( file, 0, SEEK_SET ) != 0 ) || ( fwrite( &header, 1, sizeof( header ), file ) != sizeof( header ) ) )
+    {
+        throw std::runtime_error( "Failed to write model file [" + path + "]" );
+    }
+
+    const bool closed = ( fclose( file ) == 0 );
+    file = nullptr;
+    if ( !closed )
+    {
+        remove( path.c_str() );
+        throw std::runtime_error( "Failed to write model file [" + path + "]" );
+    }
+}
+
+
+static void CopyName( char* dst, const size_t dstSize, const std::string& src )
+{
+    const size_t length = std::min( src.size(), dstSize - 1 );
+    memset( dst, 0, dstSize );
+    memcpy( dst, src.c_str(), length );
+}
+
+
+static void CopyColor( float* dst, const tinyobj::real_t* src )
+{
+    dst[ 0 ] = src[ 0 ];
+    dst[ 1 ] = src[ 1 ];
+    dst[ 2 ] = src[ 2 ];
+}
+
+
+// Geometry in the order it is written. Indices are relative to their surface's vbOffset.
+struct mdlGeometry_t
+{
+    const vertex_t*                     vertices;
+    size_t                              vertexCount;
+    std::vector<const uint32_t*>        indices;
+    std::vector<mdlSurface_t>           surfaces;
+
+    std::vector<vertex_t>               rangeVertices;  // Storage for BuildSurfaceRanges()
+    std::vector<std::vector<uint32_t>>  rangeIndices;
+};
+
+
+static void BuildSharedRange( const importedModel_t& imported, mdlGeometry_t& geometry )
+{
+    const uint32_t surfaceCount = static_cast<uint32_t>( imported.indexBuffers.size() );
+
+    geometry.vertices = imported.vertices.data();
+    geometry.vertexCount = imported.vertices.size();
+    geometry.indices.resize( surfaceCount );
+    geometry.surfaces.resize( surfaceCount );
+
+    uint32_t indexCount = 0;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        mdlSurface_t& surface = geometry.surfaces[ surfaceIx ];
+        memset( &surface, 0, sizeof( surface ) );
+        surface.vbOffset = 0;
+        surface.vbCount = static_cast<uint32_t>( imported.vertices.size() );
+        surface.ibOffset = indexCount;
+        surface.ibCount = static_cast<uint32_t>( imported.indexBuffers[ surfaceIx ].size() );
+        surface.materialId = imported.materialIds[ surfaceIx ];
+
+        geometry.indices[ surfaceIx ] = imported.indexBuffers[ surfaceIx ].data();
+        indexCount += surface.ibCount;
+    }
+}
+
+
+// Gives every surface its own vertex range, in first-use order, so it can be
+// loaded without the rest of the model. Vertices shared by surfaces are duplicated.
+static void BuildSurfaceRanges( const importedModel_t& imported, mdlGeometry_t& geometry )
+{
+    const uint32_t surfaceCount = static_cast<uint32_t>( imported.indexBuffers.size() );
+
+    geometry.indices.resize( surfaceCount );
+    geometry.surfaces.resize( surfaceCount );
+    geometry.rangeIndices.resize( surfaceCount );
+    geometry.rangeVertices.clear();
+
+    // Local ids are only valid while stamp matches the surface being remapped
+    std::vector<uint32_t> localIds( imported.vertices.size() );
+    std::vector<uint32_t> stamps( imported.vertices.size(), UINT32_MAX );
+
+    uint32_t indexCount = 0;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        const indexBuffer_t& srcIndices = imported.indexBuffers[ surfaceIx ];
+        std::vector<uint32_t>& dstIndices = geometry.rangeIndices[ surfaceIx ];
+        dstIndices.resize( srcIndices.size() );
+
+        const uint32_t vbOffset = static_cast<uint32_t>( geometry.rangeVertices.size() );
+        for ( size_t i = 0; i < srcIndices.size(); ++i )
+        {
+            const uint32_t index = srcIndices[ i ];
+            if ( stamps[ index ] != surfaceIx )
+            {
+                stamps[ index ] = surfaceIx;
+                localIds[ index ] = static_cast<uint32_t>( geometry.rangeVertices.size() ) - vbOffset;
+                geometry.rangeVertices.push_back( imported.vertices[ index ] );
+            }
+            dstIndices[ i ] = localIds[ index ];
+        }
+
+        mdlSurface_t& surface = geometry.surfaces[ surfaceIx ];
+        memset( &surface, 0, sizeof( surface ) );
+        surface.vbOffset = vbOffset;
+        surface.vbCount = static_cast<uint32_t>( geometry.rangeVertices.size() ) - vbOffset;
+        surface.ibOffset = indexCount;
+        surface.ibCount = static_cast<uint32_t>( dstIndices.size() );
+        surface.materialId = imported.materialIds[ surfaceIx ];
+
+        geometry.indices[ surfaceIx ] = dstIndices.data();
+        indexCount += surface.ibCount;
+    }
+
+    geometry.vertices = geometry.rangeVertices.data();
+    geometry.vertexCount = geometry.rangeVertices.size();
+}
+
+
+// Writes the vertex section and each surface's vertex byte range. Encoded vertices
+// are one stream per surface when surfaces have their own ranges, so that each
+// range can be decoded alone.
+static void WriteVertexSection( MdlWriter& writer, const uint32_t type, const void* vertices, const size_t vertexCount, const size_t stride,
+                                const bool encode, const bool surfaceStreams, const uint32_t sectionFlags, const std::vector<mdlSurface_t>& surfaces, std::vector<mdlSurfaceToc_t>& toc )
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>( vertices );
+    const uint32_t surfaceCount = static_cast<uint32_t>( surfaces.size() );
+
+    uint32_t flags = sectionFlags;
+    if ( encode )
+    {
+        flags |= MDL_SECTION_FLAG_VERTEX_CODEC;
+        if ( surfaceStreams )
+        {
+            flags |= MDL_SECTION_FLAG_SURFACE_STREAMS;
+        }
+    }
+
+    writer.BeginSection( type, flags );
+    const uint64_t sectionOffset = writer.GetOffset();
+
+    if ( !encode )
+    {
+        writer.Write( vertices, vertexCount * stride );
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            toc[ surfaceIx ].vbFileOffset = sectionOffset + surfaces[ surfaceIx ].vbOffset * stride;
+            toc[ surfaceIx ].vbByteSize = surfaces[ surfaceIx ].vbCount * stride;
+        }
+    }
+    else if ( surfaceStreams )
+    {
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            std::vector<uint8_t> encoded;
+            EncodeVertexBuffer( bytes + surfaces[ surfaceIx ].vbOffset * stride, surfaces[ surfaceIx ].vbCount, stride, encoded );
+
+            toc[ surfaceIx ].vbFileOffset = writer.GetOffset();
+            toc[ surfaceIx ].vbByteSize = encoded.size();
+            writer.Write( encoded.data(), encoded.size() );
+        }
+    }
+    else
+    {
+        std::vector<uint8_t> encoded;
+        EncodeVertexBuffer( vertices, vertexCount, stride, encoded );
+        writer.Write( encoded.data(), encoded.size() );
+
+        // A single stream, every surface has to decode all of it
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            toc[ surfaceIx ].vbFileOffset = sectionOffset;
+            toc[ surfaceIx ].vbByteSize = encoded.size();
+        }
+    }
+    writer.EndSection( vertexCount );
+}
+
+
+// Builds each surface's meshlets on its own worker, then appends them in surface
+// order and points the surfaces at their runs.
+static void WriteMeshletSections( MdlWriter& writer, mdlGeometry_t& geometry, const uint32_t threadCount )
+{
+    const uint32_t surfaceCount = static_cast<uint32_t>( geometry.surfaces.size() );
+
+    std::vector<meshletSet_t> surfaceSets( surfaceCount );
+    ParallelFor( surfaceCount, threadCount, [&]( const uint32_t surfaceIx )
+    {
+        const mdlSurface_t& surface = geometry.surfaces[ surfaceIx ];
+        BuildMeshlets( geometry.indices[ surfaceIx ], surface.ibCount, geometry.vertices + surface.vbOffset, surfaceSets[ surfaceIx ] );
+    } );
+
+    meshletSet_t set;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        const meshletSet_t& surfaceSet = surfaceSets[ surfaceIx ];
+        mdlSurface_t& surface = geometry.surfaces[ surfaceIx ];
+        surface.meshletOffset = static_cast<uint32_t>( set.meshlets.size() );
+        surface.meshletCount = static_cast<uint32_t>( surfaceSet.meshlets.size() );
+
+        const uint32_t vertexOffset = static_cast<uint32_t>( set.vertices.size() );
+        const uint32_t triangleOffset = static_cast<uint32_t>( set.triangles.size() );
+        for ( mdlMeshlet_t meshlet : surfaceSet.meshlets )
+        {
+            meshlet.vertexOffset += vertexOffset;
+            meshlet.triangleOffset += triangleOffset;
+            set.meshlets.push_back( meshlet );
+        }
+        set.vertices.insert( set.vertices.end(), surfaceSet.vertices.begin(), surfaceSet.vertices.end() );
+        set.triangles.insert( set.triangles.end(), surfaceSet.triangles.begin(), surfaceSet.triangles.end() );
+    }
+
+    writer.BeginSection( MDL_SECTION_MESHLETS );
+    writer.Write( set.meshlets.data(), set.meshlets.size() * sizeof( mdlMeshlet_t ) );
+    writer.EndSection( set.meshlets.size() );
+
+    writer.BeginSection( MDL_SECTION_MESHLET_VERTICES );
+    writer.Write( set.vertices.data(), set.vertices.size() * sizeof( uint32_t ) );
+    writer.EndSection( set.vertices.size() );
+
+    writer.BeginSection( MDL_SECTION_MESHLET_TRIANGLES );
+    writer.Write( set.triangles.data(), set.triangles.size() );
+    writer.EndSection( set.triangles.size() );
+
+    std::cout << "  " << set.meshlets.size() << " meshlets" << std::endl;
+}
+
+
+// Simplifies each surface on its own worker. Every level continues from the one
+// before, with the ratios relative to the full surface. A level that would exceed
+// maxError stops short of its ratio.
+static void WriteLodSections( MdlWriter& writer, const mdlGeometry_t& geometry, const std::vector<float>& ratios, const float maxError, const uint32_t threadCount )
+{
+    const uint32_t surfaceCount = static_cast<uint32_t>( geometry.surfaces.size() );
+    const uint32_t levelCount = static_cast<uint32_t>( ratios.size() );
+
+    std::vector<mdlLod_t> lods( surfaceCount * levelCount );
+    std::vector<std::vector<uint32_t>> surfaceIndices( surfaceCount );
+    ParallelFor( surfaceCount, threadCount, [&]( const uint32_t surfaceIx )
+    {
+        const mdlSurface_t& surface = geometry.surfaces[ surfaceIx ];
+        std::vector<uint32_t>& dst = surfaceIndices[ surfaceIx ];
+
+        MeshSimplifier simplifier( geometry.indices[ surfaceIx ], surface.ibCount, geometry.vertices + surface.vbOffset );
+        for ( uint32_t level = 0; level < levelCount; ++level )
+        {
+            simplifier.Simplify( static_cast<size_t>( surface.ibCount * static_cast<double>( ratios[ level ] ) ), maxError );
+
+            mdlLod_t& lod = lods[ surfaceIx * levelCount + level ];
+            memset( &lod, 0, sizeof( lod ) );
+            lod.ibOffset = static_cast<uint32_t>( dst.size() );
+            lod.ibCount = static_cast<uint32_t>( simplifier.GetIndexCount() );
+            lod.error = simplifier.GetError();
+
+            dst.resize( dst.size() + lod.ibCount );
+            simplifier.GetIndices( dst.data() + lod.ibOffset );
+        }
+    } );
+
+    uint32_t indexCount = 0;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        for ( uint32_t level = 0; level < levelCount; ++level )
+        {
+            lods[ surfaceIx * levelCount + level ].ibOffset += indexCount;
+        }
+        indexCount += static_cast<uint32_t>( surfaceIndices[ surfaceIx ].size() );
+    }
+
+    writer.BeginSection( MDL_SECTION_LODS );
+    writer.Write( lods.data(), lods.size() * sizeof( mdlLod_t ) );
+    writer.EndSection( lods.size() );
+
+    writer.BeginSection( MDL_SECTION_LOD_INDICES );
+    for ( const std::vector<uint32_t>& indices : surfaceIndices )
+    {
+        writer.Write( indices.data(), indices.size() * sizeof( uint32_t ) );
+    }
+    writer.EndSection( indexCount );
+
+    for ( uint32_t level = 0; level < levelCount; ++level )
+    {
+        size_t triangleCount = 0;
+        float error = 0.0f;
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            triangleCount += lods[ surfaceIx * levelCount + level ].ibCount / 3;
+            error = std::max( error, lods[ surfaceIx * levelCount + level ].error );
+        }
+        std::cout << "  LOD " << ( level + 1 ) << ": " << triangleCount << " triangles, error " << error << std::endl;
+    }
+}
+
+
+// The grown sphere is usually the tighter one, but boxy shapes do better around
+// the box center, so both are tried
+void ComputeBounds( const float* points, const size_t count, const size_t stride, mdlBounds_t& bounds )
+{
+    ComputeAabb( points, count, stride, bounds.min, bounds.max );
+    ComputeBoundingSphere( points, count, stride, bounds.center, bounds.radius );
+
+    float boxCenter[ 3 ];
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        boxCenter[ axis ] = ( bounds.min[ axis ] + bounds.max[ axis ] ) * 0.5f;
+    }
+    const float boxRadius = ComputeEnclosingRadius( points, count, stride, boxCenter );
+    if ( boxRadius < bounds.radius )
+    {
+        memcpy( bounds.center, boxCenter, sizeof( boxCenter ) );
+        bounds.radius = boxRadius;
+    }
+}
+
+
+// Bounds of the vertices each surface indexes, gathered so the SIMD box reads
+// them back to back, and of the whole vertex buffer for the header. vertices are
+// as a loader decodes them, so quantized models are bounded after rounding.
+static void WriteBoundsSection( MdlWriter& writer, const mdlGeometry_t& geometry, const vertex_t* vertices, const uint32_t threadCount )
+{
+    const uint32_t surfaceCount = static_cast<uint32_t>( geometry.surfaces.size() );
+
+    std::vector<mdlBounds_t> surfaceBounds( surfaceCount );
+    ParallelFor( surfaceCount, threadCount, [&]( const uint32_t surfaceIx )
+    {
+        const mdlSurface_t& surface = geometry.surfaces[ surfaceIx ];
+        const uint32_t* indices = geometry.indices[ surfaceIx ];
+        const vertex_t* surfaceVertices = vertices + surface.vbOffset;
+
+        uint32_t baseIx = 0;
+        uint32_t vertexCount = 0;
+        IndexRange( indices, surface.ibCount, baseIx, vertexCount );
+
+        std::vector<uint8_t> used( vertexCount, 0 );
+        std::vector<float> points;
+        points.reserve( vertexCount * 4 );
+        for ( uint32_t i = 0; i < surface.ibCount; ++i )
+        {
+            const uint32_t local = indices[ i ] - baseIx;
+            if ( used[ local ] == 0 )
+            {
+                used[ local ] = 1;
+                const vec4f& pos = surfaceVertices[ indices[ i ] ].pos;
+                points.insert( points.end(), { pos[ 0 ], pos[ 1 ], pos[ 2 ], 0.0f } );
+            }
+        }
+        ComputeBounds( points.data(), points.size() / 4, 4 * sizeof( float ), surfaceBounds[ surfaceIx ] );
+    } );
+
+    writer.BeginSection( MDL_SECTION_SURFACE_BOUNDS );
+    writer.Write( surfaceBounds.data(), surfaceBounds.size() * sizeof( mdlBounds_t ) );
+    writer.EndSection( surfaceCount );
+
+    mdlBounds_t modelBounds;
+    memset( &modelBounds, 0, sizeof( modelBounds ) );
+    if ( geometry.vertexCount > 0 )
+    {
+        ComputeBounds( &vertices[ 0 ].pos[ 0 ], geometry.vertexCount, sizeof( vertex_t ), modelBounds );
+    }
+    writer.SetBounds( modelBounds );
+}
+
+
+void WriteMaterialSection( MdlWriter& writer, const std::vector<tinyobj::material_t>& materials )
+{
+    const uint32_t materialCount = static_cast<uint32_t>( materials.size() );
+    writer.BeginSection( MDL_SECTION_MATERIALS );
+    for ( uint32_t i = 0; i < materialCount; ++i )
+    {
+        const tinyobj::material_t& material = materials[ i ];
+
+        mdlMaterial_t m;
+        memset( &m, 0, sizeof( m ) );
+        CopyName( m.name, sizeof( m.name ), material.name );
+        CopyName( m.colorMap, sizeof( m.colorMap ), material.diffuse_texname );
+        CopyColor( m.Ka, material.ambient );
+        CopyColor( m.Ke, material.emission );
+        CopyColor( m.Kd, material.diffuse );
+        CopyColor( m.Ks, material.specular );
+        CopyColor( m.Tf, material.transmittance );
+        m.Ni = material.ior;
+        m.Ns = material.shininess;
+        m.Tr = static_cast<float>( 1.0 - Saturate( material.dissolve ) );
+        m.d = material.dissolve;
+        m.illum = material.illum;
+
+        writer.Write( &m, sizeof( m ) );
+    }
+    writer.EndSection( materialCount );
+}
+
+
+void StoreModelMapped( const std::string& path, const std::string& name, const importedModel_t& imported, const convertOptions_t& options )
+{
+    MdlWriter writer;
+    writer.Open( path, options.threadCount );
+
+    writer.BeginSection( MDL_SECTION_NAME );
+    writer.Write( name.c_str(), name.size() + 1 );
+    writer.EndSection( name.size() + 1 );
+
+    // Local ranges are what lets most surfaces fit in 16 bits
+    const bool surfaceRanges = options.surfaceRanges || options.index16;
+
+    mdlGeometry_t geometry;
+    if ( surfaceRanges )
+    {
+        BuildSurfaceRanges( imported, geometry );
+    }
+    else
+    {
+        BuildSharedRange( imported, geometry );
+    }
+
+    const uint32_t surfaceCount = static_cast<uint32_t>( geometry.surfaces.size() );
+    std::vector<mdlSurface_t>& surfaces = geometry.surfaces;
+    const uint32_t geometryFlags = options.compressSections ? static_cast<uint32_t>( MDL_SECTION_FLAG_LZ ) : 0;
+    std::vector<mdlSurfaceToc_t> toc( surfaceCount );
+
+    bool mixedIndexSize = false;
+    if ( options.index16 )
+    {
+        for ( mdlSurface_t& surface : surfaces )
+        {
+            if ( surface.vbCount <= ( UINT16_MAX + 1 ) )
+            {
+                surface.flags |= MDL_SURFACE_FLAG_INDEX16;
+                mixedIndexSize = true;
+            }
+        }
+    }
+
+    mdlVertexQuantization_t quantization;
+    std::vector<mdlPackedVertex_t> packed;
+    const bool quantized = options.quantizeVertices && QuantizeVertices( geometry.vertices, geometry.vertexCount, quantization, packed );
+    if ( options.quantizeVertices && !quantized )
+    {
+        std::cout << "  Vertex colors or w vary, writing full vertices" << std::endl;
+    }
+
+    if ( quantized )
+    {
+        writer.BeginSection( MDL_SECTION_QUANTIZATION );
+        writer.Write( &quantization, sizeof( quantization ) );
+        writer.EndSection( 1 );
+
+        WriteVertexSection( writer, MDL_SECTION_PACKED_VERTICES, packed.data(), packed.size(), sizeof( mdlPackedVertex_t ), options.encodeVertices, surfaceRanges, geometryFlags, surfaces, toc );
+    }
+    else
+    {
+        WriteVertexSection( writer, MDL_SECTION_VERTICES, geometry.vertices, geometry.vertexCount, sizeof( vertex_t ), options.encodeVertices, surfaceRanges, geometryFlags, surfaces, toc );
+    }
+
+    uint32_t indexCount = 0;
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        indexCount += surfaces[ surfaceIx ].ibCount;
+    }
+
+    if ( options.encodeIndices )
+    {
+        // Stream offsets are relative to the start of the section
+        std::vector<uint64_t> streamOffsets( surfaceCount + 1 );
+        std::vector<uint8_t> streams;
+        const uint64_t tableSize = streamOffsets.size() * sizeof( uint64_t );
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            streamOffsets[ surfaceIx ] = tableSize + streams.size();
+            EncodeIndexBuffer( geometry.indices[ surfaceIx ], surfaces[ surfaceIx ].ibCount, streams );
+        }
+        streamOffsets[ surfaceCount ] = tableSize + streams.size();
+
+        writer.BeginSection( MDL_SECTION_ENCODED_INDICES, geometryFlags );
+        const uint64_t sectionOffset = writer.GetOffset();
+        writer.Write( streamOffsets.data(), tableSize );
+        writer.Write( streams.data(), streams.size() );
+        writer.EndSection( indexCount );
+
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            toc[ surfaceIx ].ibFileOffset = sectionOffset + streamOffsets[ surfaceIx ];
+            toc[ surfaceIx ].ibByteSize = streamOffsets[ surfaceIx + 1 ] - streamOffsets[ surfaceIx ];
+        }
+    }
+    else if ( mixedIndexSize )
+    {
+        static const uint8_t zeros[ 4 ] = {};
+
+        writer.BeginSection( MDL_SECTION_INDICES, MDL_SECTION_FLAG_MIXED_INDEX_SIZE | geometryFlags );
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            const mdlSurface_t& surface = surfaces[ surfaceIx ];
+            const uint32_t* indices = geometry.indices[ surfaceIx ];
+
+            toc[ surfaceIx ].ibFileOffset = writer.GetOffset();
+            if ( ( surface.flags & MDL_SURFACE_FLAG_INDEX16 ) != 0 )
+            {
+                std::vector<uint16_t> narrow( indices, indices + surface.ibCount );
+                toc[ surfaceIx ].ibByteSize = narrow.size() * sizeof( uint16_t );
+                writer.Write( narrow.data(), narrow.size() * sizeof( uint16_t ) );
+                writer.Write( zeros, ( 4 - ( writer.GetOffset() % 4 ) ) % 4 );
+            }
+            else
+            {
+                toc[ surfaceIx ].ibByteSize = surface.ibCount * sizeof( uint32_t );
+                writer.Write( indices, surface.ibCount * sizeof( uint32_t ) );
+            }
+        }
+        writer.EndSection( indexCount );
+    }
+    else
+    {
+        writer.BeginSection( MDL_SECTION_INDICES, geometryFlags );
+        for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+        {
+            toc[ surfaceIx ].ibFileOffset = writer.GetOffset();
+            toc[ surfaceIx ].ibByteSize = surfaces[ surfaceIx ].ibCount * sizeof( uint32_t );
+            writer.Write( geometry.indices[ surfaceIx ], surfaces[ surfaceIx ].ibCount * sizeof( uint32_t ) );
+        }
+        writer.EndSection( indexCount );
+    }
+
+    if ( options.buildMeshlets )
+    {
+        WriteMeshletSections( writer, geometry, options.threadCount );
+    }
+
+    if ( !options.lodRatios.empty() )
+    {
+        WriteLodSections( writer, geometry, options.lodRatios, options.lodMaxError, options.threadCount );
+    }
+
+    if ( quantized )
+    {
+        std::vector<vertex_t> decoded( packed.size() );
+        DequantizeVertices( quantization, packed.data(), packed.size(), decoded.data() );
+        WriteBoundsSection( writer, geometry, decoded.data(), options.threadCount );
+    }
+    else
+    {
+        WriteBoundsSection( writer, geometry, geometry.vertices, options.threadCount );
+    }
+
+    writer.BeginSection( MDL_SECTION_SURFACE_TOC );
+    writer.Write( toc.data(), toc.size() * sizeof( mdlSurfaceToc_t ) );
+    writer.EndSection( surfaceCount );
+
+    writer.BeginSection( MDL_SECTION_SURFACES );
+    writer.Write( surfaces.data(), surfaces.size() * sizeof( mdlSurface_t ) );
+    writer.EndSection( surfaceCount );
+
+    WriteMaterialSection( writer, imported.materials );
+
+    writer.Finish();
+}
+
+
+// Vertices per dequantization task
+static const uint32_t DequantizeChunkSize = 64 * 1024;
+
+// ParallelFor for tasks that can fail. Once one has, the rest return early.
+static bool ParallelAll( const uint32_t count, const uint32_t threadCount, const std::function<bool( uint32_t )>& task )
+{
+    std::atomic<bool> succeeded( true );
+    ParallelFor( count, threadCount, [&]( const uint32_t i )
+    {
+        if ( succeeded && !task( i ) )
+        {
+            succeeded = false;
+        }
+    } );
+    return succeeded;
+}
+
+
+MappedModel::MappedModel()
+{
+    threadCount = 0;
+    Close();
+}
+
+
+void MappedModel::Close()
+{
+    file.Close();
+    fileData = nullptr;
+    fileSize = 0;
+    header = nullptr;
+    sections = nullptr;
+    name = "";
+    vertices = nullptr;
+    vertexCount = 0;
+    packedVertices = nullptr;
+    decodedPacked.clear();
+    decodedPacked.shrink_to_fit();
+    quantization = nullptr;
+    decodedVertices.clear();
+    decodedVertices.shrink_to_fit();
+    indices = nullptr;
+    indexCount = 0;
+    decodedIndices.clear();
+    decodedIndices.shrink_to_fit();
+    surfaces = nullptr;
+    surfaceCount = 0;
+    materials = nullptr;
+    materialCount = 0;
+    toc = nullptr;
+    meshlets = nullptr;
+    meshletCount = 0;
+    meshletVertices = nullptr;
+    meshletVertexCount = 0;
+    meshletTriangles = nullptr;
+    meshletTriangleBytes = 0;
+    lods = nullptr;
+    lodCount = 0;
+    lodIndices = nullptr;
+    lodIndexCount = 0;
+    bounds = nullptr;
+    surfaceBounds = nullptr;
+    vertexSection = nullptr;
+    indexSection = nullptr;
+    for ( geometrySection_t* geometry : { &vertexGeometry, &indexGeometry } )
+    {
+        memset( &geometry->view, 0, sizeof( geometry->view ) );
+        geometry->lz = nullptr;
+        geometry->blockOffsets = nullptr;
+        geometry->inflated.clear();
+        geometry->inflated.shrink_to_fit();
+    }
+}
+
+
+const mdlSection_t* MappedModel::FindSection( const uint32_t type ) const
+{
+    if ( header == nullptr )
+    {
+        return nullptr;
+    }
+    for ( uint32_t i = 0; i < header->sectionCount; ++i )
+    {
+        if ( sections[ i ].type == type )
+        {
+            return &sections[ i ];
+        }
+    }
+    return nullptr;
+}
+
+
+bool MappedModel::Open( const std::string& path, std::string* err, const uint32_t openFlags, const uint32_t threadCount )
+{
+    Close();
+    this->threadCount = threadCount;
+
+    if ( !file.Open( path ) )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Cannot open model file [" + path + "]";
+        }
+        return false;
+    }
+    fileData = file.GetData();
+    fileSize = file.GetSize();
+    return OpenData( err, openFlags );
+}
+
+
+bool MappedModel::Open( const uint8_t* data, const uint64_t size, std::string* err, const uint32_t openFlags, const uint32_t threadCount )
+{
+    Close();
+    this->threadCount = threadCount;
+
+    if ( ( reinterpret_cast<uintptr_t>( data ) % MdlSectionAlignment ) != 0 )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Bad model file: data is not aligned";
+        }
+        return false;
+    }
+    fileData = data;
+    fileSize = size;
+    return OpenData( err, openFlags );
+}
+
+
+bool MappedModel::OpenData( std::string* err, const uint32_t openFlags )
+{
+    if ( !Validate( err ) || ( ( ( openFlags & MDL_OPEN_VERIFY ) != 0 ) && !Verify( err ) ) )
+    {
+        Close();
+        return false;
+    }
+
+    if ( ( ( openFlags & MDL_OPEN_DEFER_DECODE ) == 0 ) && ( !InflateSections() || !DecodeAll() ) )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Bad model file: geometry does not decode";
+        }
+        Close();
+        return false;
+    }
+    return true;
+}
+
+
+// Missing sections read as empty. Present ones must hold exactly count elements.
+template< class T >
+static bool SectionData( const uint8_t* base, const mdlSection_t* section, const T*& data, uint32_t& count )
+{
+    data = nullptr;
+    count = 0;
+    if ( section == nullptr )
+    {
+        return true;
+    }
+    if ( ( section->count > UINT32_MAX ) || ( section->size != ( section->count * sizeof( T ) ) ) )
+    {
+        return false;
+    }
+    data = reinterpret_cast<const T*>( base + section->offset );
+    count = static_cast<uint32_t>( section->count );
+    return true;
+}
+
+
+static bool InSection( const mdlSection_t* section, const uint64_t offset, const uint64_t size )
+{
+    if ( section == nullptr )
+    {
+        return ( size == 0 );
+    }
+    return ( offset >= section->offset ) && ( offset <= ( section->offset + section->size ) ) && ( size <= ( section->offset + section->size - offset ) );
+}
+
+
+bool MappedModel::Validate( std::string* err )
+{
+    const uint8_t* base = fileData;
+
+    std::string problem;
+    if ( fileSize < sizeof( mdlHeader_t ) )
+    {
+        problem = "file is too small";
+    }
+    else
+    {
+        header = reinterpret_cast<const mdlHeader_t*>( base );
+        if ( header->magic != MdlMagic )
+        {
+            problem = "not a mapped model";
+        }
+        else if ( header->version != MdlVersion )
+        {
+            problem = "unsupported version " + std::to_string( header->version );
+        }
+        else if ( ( header->fileSize != fileSize ) || ( header->headerSize < sizeof( mdlHeader_t ) ) )
+        {
+            problem = "truncated file";
+        }
+        else if ( header->vertexStride != sizeof( vertex_t ) )
+        {
+            problem = "vertex layout does not match";
+        }
+        else if ( ( header->sectionTableOffset % MdlSectionAlignment ) != 0 ||
+                  ( header->sectionTableOffset + header->sectionCount * sizeof( mdlSection_t ) ) > fileSize )
+        {
+            problem = "bad section table";
+        }
+    }
+
+    if ( problem.empty() )
+    {
+        bounds = &header->bounds;
+        sections = reinterpret_cast<const mdlSection_t*>( base + header->sectionTableOffset );
+        for ( uint32_t i = 0; i < header->sectionCount; ++i )
+        {
+            const mdlSection_t& section = sections[ i ];
+            if ( ( ( section.offset % MdlSectionAlignment ) != 0 ) || ( section.offset > fileSize ) || ( section.size > ( fileSize - section.offset ) ) )
+            {
+                problem = "section " + std::to_string( i ) + " is out of bounds";
+                break;
+            }
+        }
+    }
+
+    if ( problem.empty() )
+    {
+        const mdlSection_t* nameSection = FindSection( MDL_SECTION_NAME );
+        if ( ( nameSection != nullptr ) && ( nameSection->size > 0 ) && ( base[ nameSection->offset + nameSection->size - 1 ] == '\0' ) )
+        {
+            name = reinterpret_cast<const char*>( base + nameSection->offset );
+        }
+
+        uint32_t tocCount = 0;
+        uint32_t quantizationCount = 0;
+        uint32_t surfaceBoundsCount = 0;
+        if ( !SectionData( base, FindSection( MDL_SECTION_SURFACES ), surfaces, surfaceCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_MATERIALS ), materials, materialCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_SURFACE_TOC ), toc, tocCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_QUANTIZATION ), quantization, quantizationCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_MESHLETS ), meshlets, meshletCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_MESHLET_VERTICES ), meshletVertices, meshletVertexCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_MESHLET_TRIANGLES ), meshletTriangles, meshletTriangleBytes ) ||
+             !SectionData( base, FindSection( MDL_SECTION_LODS ), lods, lodCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_LOD_INDICES ), lodIndices, lodIndexCount ) ||
+             !SectionData( base, FindSection( MDL_SECTION_SURFACE_BOUNDS ), surfaceBounds, surfaceBoundsCount ) )
+        {
+            problem = "section size does not match its count";
+        }
+        else if ( ( toc != nullptr ) && ( tocCount != surfaceCount ) )
+        {
+            problem = "surface table does not match the surfaces";
+        }
+        else if ( ( surfaceBounds != nullptr ) && ( surfaceBoundsCount != surfaceCount ) )
+        {
+            problem = "surface bounds do not match the surfaces";
+        }
+        else if ( ( lodCount > 0 ) && ( ( surfaceCount == 0 ) || ( ( lodCount % surfaceCount ) != 0 ) ) )
+        {
+            problem = "LODs do not match the surfaces";
+        }
+    }
+
+    if ( problem.empty() )
+    {
+        const mdlSection_t* storedVertices = FindSection( MDL_SECTION_VERTICES );
+        size_t stride = sizeof( vertex_t );
+        if ( storedVertices == nullptr )
+        {
+            storedVertices = FindSection( MDL_SECTION_PACKED_VERTICES );
+            stride = sizeof( mdlPackedVertex_t );
+        }
+        else
+        {
+            quantization = nullptr;
+        }
+
+        const mdlSection_t* storedIndices = FindSection( MDL_SECTION_INDICES );
+        const bool encodedIndices = ( storedIndices == nullptr );
+        if ( encodedIndices )
+        {
+            storedIndices = FindSection( MDL_SECTION_ENCODED_INDICES );
+        }
+
+        vertexSection = OpenGeometrySection( storedVertices, vertexGeometry, problem );
+        indexSection = OpenGeometrySection( storedIndices, indexGeometry, problem );
+
+        if ( problem.empty() && ( vertexSection != nullptr ) )
+        {
+            const bool encoded = ( vertexSection->flags & MDL_SECTION_FLAG_VERTEX_CODEC ) != 0;
+
+            // Encoded blocks have at least a header byte per plane, which bounds the decode allocation
+            const uint64_t blockCount = ( vertexSection->count + VertexBlockSize - 1 ) / VertexBlockSize;
+            if ( ( vertexSection->count > UINT32_MAX ) || ( encoded && ( vertexSection->size < blockCount * stride ) ) ||
+                 ( !encoded && ( vertexSection->size != vertexSection->count * stride ) ) )
+            {
+                problem = "bad vertices";
+            }
+            else if ( ( stride == sizeof( mdlPackedVertex_t ) ) && ( quantization == nullptr ) )
+            {
+                problem = "packed vertices without quantization";
+            }
+            else if ( ( ( vertexSection->flags & MDL_SECTION_FLAG_SURFACE_STREAMS ) != 0 ) && ( toc == nullptr ) )
+            {
+                problem = "surface streams without a surface table";
+            }
+            else
+            {
+                vertexCount = static_cast<uint32_t>( vertexSection->count );
+            }
+        }
+
+        if ( problem.empty() && ( indexSection != nullptr ) )
+        {
+            const bool mixedSize = !encodedIndices && ( ( indexSection->flags & MDL_SECTION_FLAG_MIXED_INDEX_SIZE ) != 0 );
+            if ( ( indexSection->count > UINT32_MAX ) || ( !encodedIndices && !mixedSize && ( indexSection->size != indexSection->count * sizeof( uint32_t ) ) ) )
+            {
+                problem = "bad indices";
+            }
+            else if ( mixedSize && ( toc == nullptr ) )
+            {
+                problem = "mixed index sizes without a surface table";
+            }
+            else
+            {
+                indexCount = static_cast<uint32_t>( indexSection->count );
+            }
+        }
+    }
+
+    if ( problem.empty() )
+    {
+        // Surface ranges are checked so callers can index without bounds checks.
+        // Index values themselves are not scanned; that would touch every page.
+        for ( uint32_t i = 0; i < surfaceCount; ++i )
+        {
+            const mdlSurface_t& surface = surfaces[ i ];
+            if ( ( static_cast<uint64_t>( surface.ibOffset ) + surface.ibCount > indexCount ) ||
+                 ( static_cast<uint64_t>( surface.vbOffset ) + surface.vbCount > vertexCount ) )
+            {
+                problem = "surface " + std::to_string( i ) + " is out of range";
+                break;
+            }
+            if ( ( toc != nullptr ) && ( !InSection( vertexSection, toc[ i ].vbFileOffset, toc[ i ].vbByteSize ) || !InSection( indexSection, toc[ i ].ibFileOffset, toc[ i ].ibByteSize ) ) )
+            {
+                problem = "surface " + std::to_string( i ) + " table entry is out of range";
+                break;
+            }
+            if ( ( indexSection != nullptr ) && ( indexSection->type == MDL_SECTION_INDICES ) && ( ( indexSection->flags & MDL_SECTION_FLAG_MIXED_INDEX_SIZE ) != 0 ) &&
+                 ( ( toc[ i ].ibByteSize != static_cast<uint64_t>( surface.ibCount ) * GetIndexSize( i ) ) || ( ( toc[ i ].ibFileOffset % GetIndexSize( i ) ) != 0 ) ) )
+            {
+                problem = "surface " + std::to_string( i ) + " indices do not match its width";
+                break;
+            }
+            if ( static_cast<uint64_t>( surface.meshletOffset ) + surface.meshletCount > meshletCount )
+            {
+                problem = "surface " + std::to_string( i ) + " meshlets are out of range";
+                break;
+            }
+        }
+    }
+
+    if ( problem.empty() )
+    {
+        // Local vertex numbers are bytes, so no meshlet can hold more than 256
+        for ( uint32_t i = 0; i < meshletCount; ++i )
+        {
+            const mdlMeshlet_t& meshlet = meshlets[ i ];
+            if ( ( meshlet.vertexCount > 256 ) ||
+                 ( static_cast<uint64_t>( meshlet.vertexOffset ) + meshlet.vertexCount > meshletVertexCount ) ||
+                 ( static_cast<uint64_t>( meshlet.triangleOffset ) + meshlet.triangleCount * 3ull > meshletTriangleBytes ) )
+            {
+                problem = "meshlet " + std::to_string( i ) + " is out of range";
+                break;
+            }
+        }
+        for ( uint32_t i = 0; i < lodCount; ++i )
+        {
+            if ( static_cast<uint64_t>( lods[ i ].ibOffset ) + lods[ i ].ibCount > lodIndexCount )
+            {
+                problem = "LOD " + std::to_string( i ) + " is out of range";
+                break;
+            }
+        }
+    }
+
+    if ( !problem.empty() )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Bad model file: " + problem;
+        }
+        return false;
+    }
+
+    MapGeometry();
+    return true;
+}
+
+
+// Needs the section table bounds checked by Validate(). Sections are checked in parallel.
+bool MappedModel::Verify( std::string* err ) const
+{
+    const uint8_t* base = fileData;
+    const mdlSection_t* checksumSection = FindSection( MDL_SECTION_CHECKSUMS );
+
+    std::string problem;
+    if ( Crc32c( sections, header->sectionCount * sizeof( mdlSection_t ) ) != header->sectionTableChecksum )
+    {
+        problem = "section table checksum does not match";
+    }
+    else if ( ( checksumSection == nullptr ) || ( checksumSection->count != header->sectionCount ) || ( checksumSection->size != header->sectionCount * sizeof( uint32_t ) ) )
+    {
+        problem = "no section checksums";
+    }
+    else
+    {
+        const uint32_t* checksums = reinterpret_cast<const uint32_t*>( base + checksumSection->offset );
+        std::atomic<uint32_t> firstBad( UINT32_MAX );
+        ParallelFor( header->sectionCount, threadCount, [&]( const uint32_t sectionIx )
+        {
+            const mdlSection_t& section = sections[ sectionIx ];
+            if ( ( &section != checksumSection ) && ( Crc32c( base + section.offset, static_cast<size_t>( section.size ) ) != checksums[ sectionIx ] ) )
+            {
+                uint32_t expected = firstBad;
+                while ( ( sectionIx < expected ) && !firstBad.compare_exchange_weak( expected, sectionIx ) )
+                {
+                }
+            }
+        } );
+        if ( firstBad != UINT32_MAX )
+        {
+            problem = "section " + std::to_string( firstBad ) + " checksum does not match";
+        }
+    }
+
+    if ( !problem.empty() )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Bad model file: " + problem;
+        }
+        return false;
+    }
+    return true;
+}
+
+
+// Sets up geometry's view of a vertex or index section, checking the block table
+// of LZ sections. Returns the view, or null if the section is missing or bad.
+const mdlSection_t* MappedModel::OpenGeometrySection( const mdlSection_t* section, geometrySection_t& geometry, std::string& problem )
+{
+    if ( ( section == nullptr ) || !problem.empty() )
+    {
+        return nullptr;
+    }
+
+    geometry.view = *section;
+    geometry.lz = nullptr;
+    geometry.blockOffsets = nullptr;
+    if ( ( section->flags & MDL_SECTION_FLAG_LZ ) == 0 )
+    {
+        return &geometry.view;
+    }
+
+    if ( section->size < sizeof( mdlLzHeader_t ) )
+    {
+        problem = "bad compressed section";
+        return nullptr;
+    }
+
+    const uint8_t* base = fileData + section->offset;
+    const mdlLzHeader_t* lz = reinterpret_cast<const mdlLzHeader_t*>( base );
+    const uint64_t* blockOffsets = reinterpret_cast<const uint64_t*>( base + sizeof( mdlLzHeader_t ) );
+    const uint64_t tableSize = sizeof( mdlLzHeader_t ) + ( static_cast<uint64_t>( lz->blockCount ) + 1 ) * sizeof( uint64_t );
+
+    bool valid = ( section->size >= tableSize ) && ( lz->blockSize > 0 ) && ( lz->blockSize <= MdlLzMaxBlockSize ) &&
+                 ( lz->rawSize <= static_cast<uint64_t>( lz->blockCount ) * lz->blockSize ) &&
+                 ( ( lz->blockCount == 0 ) || ( lz->rawSize > static_cast<uint64_t>( lz->blockCount - 1 ) * lz->blockSize ) );
+    for ( uint32_t blockIx = 0; valid && ( blockIx < lz->blockCount ); ++blockIx )
+    {
+        // Stored blocks are never bigger than inflated ones, which bounds what a
+        // corrupt table can make the loader allocate
+        const uint64_t rawSize = std::min<uint64_t>( lz->blockSize, lz->rawSize - static_cast<uint64_t>( blockIx ) * lz->blockSize );
+        valid = ( blockOffsets[ blockIx ] >= tableSize ) && ( blockOffsets[ blockIx ] <= blockOffsets[ blockIx + 1 ] ) &&
+                ( blockOffsets[ blockIx + 1 ] <= section->size ) && ( ( blockOffsets[ blockIx + 1 ] - blockOffsets[ blockIx ] ) <= rawSize );
+    }
+    if ( !valid )
+    {
+        problem = "bad compressed section";
+        return nullptr;
+    }
+
+    geometry.view.flags &= ~MDL_SECTION_FLAG_LZ;
+    geometry.view.size = lz->rawSize;
+    geometry.lz = lz;
+    geometry.blockOffsets = blockOffsets;
+    return &geometry.view;
+}
+
+
+// Points the accessors at geometry that is usable as stored, in the mapping or
+// inflated. Everything else is left to DecodeAll() or LoadSurfaces().
+void MappedModel::MapGeometry()
+{
+    const uint8_t* vertexBytes = ( vertexSection != nullptr ) ? SectionBytes( vertexGeometry ) : nullptr;
+    if ( ( vertexBytes != nullptr ) && ( ( vertexSection->flags & MDL_SECTION_FLAG_VERTEX_CODEC ) == 0 ) )
+    {
+        if ( vertexSection->type == MDL_SECTION_VERTICES )
+        {
+            vertices = reinterpret_cast<const vertex_t*>( vertexBytes );
+        }
+        else
+        {
+            packedVertices = reinterpret_cast<const mdlPackedVertex_t*>( vertexBytes );
+        }
+    }
+
+    const uint8_t* indexBytes = ( indexSection != nullptr ) ? SectionBytes( indexGeometry ) : nullptr;
+    if ( ( indexBytes != nullptr ) && ( indexSection->type == MDL_SECTION_INDICES ) && ( ( indexSection->flags & MDL_SECTION_FLAG_MIXED_INDEX_SIZE ) == 0 ) )
+    {
+        indices = reinterpret_cast<const uint32_t*>( indexBytes );
+    }
+}
+
+
+bool MappedModel::InflateBlock( const geometrySection_t& geometry, const uint32_t blockIx, uint8_t* dst ) const
+{
+    const uint8_t* stored = fileData + geometry.view.offset + geometry.blockOffsets[ blockIx ];
+    const size_t storedSize = static_cast<size_t>( geometry.blockOffsets[ blockIx + 1 ] - geometry.blockOffsets[ blockIx ] );
+    const size_t rawSize = static_cast<size_t>( std::min<uint64_t>( geometry.lz->blockSize, geometry.lz->rawSize - static_cast<uint64_t>( blockIx ) * geometry.lz->blockSize ) );
+
+    if ( storedSize == rawSize )
+    {
+        memcpy( dst, stored, rawSize );
+        return true;
+    }
+    return LzDecompress( stored, storedSize, dst, rawSize );
+}
+
+
+// Inflates LZ sections whole, blocks in parallel, then maps them like raw ones
+bool MappedModel::InflateSections()
+{
+    for ( geometrySection_t* geometry : { &vertexGeometry, &indexGeometry } )
+    {
+        if ( geometry->lz == nullptr )
+        {
+            continue;
+        }
+
+        geometry->inflated.resize( static_cast<size_t>( geometry->lz->rawSize ) );
+        const bool inflated = ParallelAll( geometry->lz->blockCount, threadCount, [&]( const uint32_t blockIx )
+        {
+            return InflateBlock( *geometry, blockIx, geometry->inflated.data() + static_cast<size_t>( blockIx ) * geometry->lz->blockSize );
+        } );
+        if ( !inflated )
+        {
+            return false;
+        }
+    }
+
+    MapGeometry();
+    return true;
+}
+
+
+// Start of a section's bytes as if stored inflated, or null for an LZ section
+// that has not been inflated
+const uint8_t* MappedModel::SectionBytes( const geometrySection_t& geometry ) const
+{
+    if ( geometry.lz == nullptr )
+    {
+        return fileData + geometry.view.offset;
+    }
+    return geometry.inflated.empty() ? nullptr : geometry.inflated.data();
+}
+
+
+// Bytes [fileOffset, fileOffset + size) of a section, which must lie inside its view.
+// LZ sections not inflated at Open() have only the blocks covering the range
+// inflated, into scratch.
+const uint8_t* MappedModel::ReadSection( const geometrySection_t& geometry, const uint64_t fileOffset, const uint64_t size, std::vector<uint8_t>& scratch ) const
+{
+    const uint8_t* bytes = SectionBytes( geometry );
+    if ( bytes != nullptr )
+    {
+        return bytes + ( fileOffset - geometry.view.offset );
+    }
+
+    const uint64_t begin = fileOffset - geometry.view.offset;
+    const uint64_t blockSize = geometry.lz->blockSize;
+    const uint32_t firstBlock = static_cast<uint32_t>( begin / blockSize );
+    const uint32_t endBlock = static_cast<uint32_t>( std::max<uint64_t>( ( begin + size + blockSize - 1 ) / blockSize, firstBlock + 1 ) );
+
+    const uint64_t scratchEnd = std::min<uint64_t>( endBlock * blockSize, geometry.lz->rawSize );
+    scratch.resize( static_cast<size_t>( std::max<uint64_t>( scratchEnd - firstBlock * blockSize, 1 ) ) );
+    for ( uint32_t blockIx = firstBlock; blockIx < std::min( endBlock, geometry.lz->blockCount ); ++blockIx )
+    {
+        if ( !InflateBlock( geometry, blockIx, scratch.data() + static_cast<size_t>( ( blockIx - firstBlock ) * blockSize ) ) )
+        {
+            return nullptr;
+        }
+    }
+    return scratch.data() + static_cast<size_t>( begin - firstBlock * blockSize );
+}
+
+
+// Decodes encoded vertices into dst, one stream per surface or one for the section.
+// bytes is the start of the section.
+template< class T >
+static bool DecodeVertexStreams( const uint8_t* bytes, const mdlSection_t& section, const mdlSurface_t* surfaces, const mdlSurfaceToc_t* toc,
+                                 const uint32_t surfaceCount, const uint32_t threadCount, T* dst )
+{
+    if ( ( section.flags & MDL_SECTION_FLAG_SURFACE_STREAMS ) == 0 )
+    {
+        return DecodeVertexBuffer( bytes, static_cast<size_t>( section.size ), dst, static_cast<size_t>( section.count ), sizeof( T ) );
+    }
+
+    return ParallelAll( surfaceCount, threadCount, [&]( const uint32_t i )
+    {
+        return DecodeVertexBuffer( bytes + ( toc[ i ].vbFileOffset - section.offset ), static_cast<size_t>( toc[ i ].vbByteSize ), dst + surfaces[ i ].vbOffset, surfaces[ i ].vbCount, sizeof( T ) );
+    } );
+}
+
+
+// Surfaces decode independently, each into its own range of the decoded buffers
+bool MappedModel::DecodeAll()
+{
+    if ( ( vertexSection != nullptr ) && ( ( vertexSection->flags & MDL_SECTION_FLAG_VERTEX_CODEC ) != 0 ) )
+    {
+        if ( quantization != nullptr )
+        {
+            decodedPacked.resize( vertexCount );
+            if ( !DecodeVertexStreams( SectionBytes( vertexGeometry ), *vertexSection, surfaces, toc, surfaceCount, threadCount, decodedPacked.data() ) )
+            {
+                return false;
+            }
+            packedVertices = decodedPacked.data();
+        }
+        else
+        {
+            decodedVertices.resize( vertexCount );
+            if ( !DecodeVertexStreams( SectionBytes( vertexGeometry ), *vertexSection, surfaces, toc, surfaceCount, threadCount, decodedVertices.data() ) )
+            {
+                return false;
+            }
+            vertices = decodedVertices.data();
+        }
+    }
+
+    if ( packedVertices != nullptr )
+    {
+        const uint32_t chunkCount = ( vertexCount + DequantizeChunkSize - 1 ) / DequantizeChunkSize;
+        decodedVertices.resize( vertexCount );
+        ParallelFor( chunkCount, threadCount, [&]( const uint32_t chunkIx )
+        {
+            const uint32_t first = chunkIx * DequantizeChunkSize;
+            DequantizeVertices( *quantization, packedVertices + first, std::min( DequantizeChunkSize, vertexCount - first ), decodedVertices.data() + first );
+        } );
+        vertices = decodedVertices.data();
+    }
+
+    if ( ( indexSection != nullptr ) && ( indexSection->type == MDL_SECTION_INDICES ) && ( ( indexSection->flags & MDL_SECTION_FLAG_MIXED_INDEX_SIZE ) != 0 ) )
+    {
+        // Mixed widths; GetIndices() is always 32-bit, the narrow data stays
+        // reachable through GetSurfaceIndices()
+        decodedIndices.resize( indexCount );
+        if ( !ParallelAll( surfaceCount, threadCount, [&]( const uint32_t i ) { return DecodeIndexRange( i, decodedIndices.data() + surfaces[ i ].ibOffset ); } ) )
+        {
+            return false;
+        }
+        indices = decodedIndices.data();
+    }
+
+    if ( ( indexSection != nullptr ) && ( indexSection->type == MDL_SECTION_ENCODED_INDICES ) )
+    {
+        // The stream table at the start of the section is checked like the TOC,
+        // so files without a TOC still decode
+        const uint64_t tableSize = ( static_cast<uint64_t>( surfaceCount ) + 1 ) * sizeof( uint64_t );
+        if ( indexSection->size < tableSize )
+        {
+            return false;
+        }
+
+        const uint8_t* data = SectionBytes( indexGeometry );
+        std::vector<uint64_t> streamOffsets( surfaceCount + 1 );
+        memcpy( streamOffsets.data(), data, static_cast<size_t>( tableSize ) );
+
+        decodedIndices.resize( indexCount );
+        const bool decoded = ParallelAll( surfaceCount, threadCount, [&]( const uint32_t i )
+        {
+            const uint64_t begin = streamOffsets[ i ];
+            const uint64_t end = streamOffsets[ i + 1 ];
+            return ( begin >= tableSize ) && ( begin <= end ) && ( end <= indexSection->size ) &&
+                   DecodeIndexBuffer( data + begin, static_cast<size_t>( end - begin ), decodedIndices.data() + surfaces[ i ].ibOffset, surfaces[ i ].ibCount );
+        } );
+        if ( !decoded )
+        {
+            return false;
+        }
+        indices = decodedIndices.data();
+    }
+    return true;
+}
+
+
+bool MappedModel::DecodeVertexRange( const uint32_t surfaceIx, vertex_t* dst ) const
+{
+    const mdlSurface_t& surface = surfaces[ surfaceIx ];
+    const mdlSurfaceToc_t& entry = toc[ surfaceIx ];
+    std::vector<uint8_t> scratch;
+    const uint8_t* data = ReadSection( vertexGeometry, entry.vbFileOffset, entry.vbByteSize, scratch );
+    if ( data == nullptr )
+    {
+        return false;
+    }
+    const bool encoded = ( vertexSection->flags & MDL_SECTION_FLAG_VERTEX_CODEC ) != 0;
+
+    if ( !encoded )
+    {
+        const size_t stride = ( quantization != nullptr ) ? sizeof( mdlPackedVertex_t ) : sizeof( vertex_t );
+        if ( entry.vbByteSize != surface.vbCount * stride )
+        {
+            return false;
+        }
+        if ( quantization != nullptr )
+        {
+            DequantizeVertices( *quantization, reinterpret_cast<const mdlPackedVertex_t*>( data ), surface.vbCount, dst );
+        }
+        else
+        {
+            memcpy( dst, data, surface.vbCount * sizeof( vertex_t ) );
+        }
+        return true;
+    }
+
+    // A shared stream has to be decoded whole, then the range picked out of it
+    const bool ownStream = ( vertexSection->flags & MDL_SECTION_FLAG_SURFACE_STREAMS ) != 0;
+    const uint32_t streamCount = ownStream ? surface.vbCount : vertexCount;
+    const uint32_t first = ownStream ? 0 : surface.vbOffset;
+
+    if ( quantization != nullptr )
+    {
+        std::vector<mdlPackedVertex_t> packed( streamCount );
+        if ( !DecodeVertexBuffer( data, static_cast<size_t>( entry.vbByteSize ), packed.data(), streamCount, sizeof( mdlPackedVertex_t ) ) )
+        {
+            return false;
+        }
+        DequantizeVertices( *quantization, packed.data() + first, surface.vbCount, dst );
+    }
+    else if ( ownStream )
+    {
+        return DecodeVertexBuffer( data, static_cast<size_t>( entry.vbByteSize ), dst, streamCount, sizeof( vertex_t ) );
+    }
+    else
+    {
+        std::vector<vertex_t> stream( streamCount );
+        if ( !DecodeVertexBuffer( data, static_cast<size_t>( entry.vbByteSize ), stream.data(), streamCount, sizeof( vertex_t ) ) )
+        {
+            return false;
+        }
+        memcpy( dst, stream.data() + first, surface.vbCount * sizeof( vertex_t ) );
+    }
+    return true;
+}
+
+
+template< class Index >
+bool MappedModel::DecodeIndexRange( const uint32_t surfaceIx, Index* dst ) const
+{
+    const mdlSurface_t& surface = surfaces[ surfaceIx ];
+    const mdlSurfaceToc_t& entry = toc[ surfaceIx ];
+    std::vector<uint8_t> scratch;
+    const uint8_t* data = ReadSection( indexGeometry, entry.ibFileOffset, entry.ibByteSize, scratch );
+    if ( data == nullptr )
+    {
+        return false;
+    }
+
+    if ( indexSection->type == MDL_SECTION_ENCODED_INDICES )
+    {
+        return DecodeIndexBuffer( data, static_cast<size_t>( entry.ibByteSize ), dst, surface.ibCount );
+    }
+
+    const uint32_t indexSize = ( ( indexSection->flags & MDL_SECTION_FLAG_MIXED_INDEX_SIZE ) != 0 ) ? GetIndexSize( surfaceIx ) : sizeof( uint32_t );
+    if ( entry.ibByteSize != static_cast<uint64_t>( surface.ibCount ) * indexSize )
+    {
+        return false;
+    }
+    if ( indexSize == sizeof( uint16_t ) )
+    {
+        const uint16_t* src = reinterpret_cast<const uint16_t*>( data );
+        std::copy( src, src + surface.ibCount, dst );
+    }
+    else
+    {
+        const uint32_t* src = reinterpret_cast<const uint32_t*>( data );
+        std::transform( src, src + surface.ibCount, dst, []( const uint32_t index ) { return static_cast<Index>( index ); } );
+    }
+    return true;
+}
+
+
+uint32_t MappedModel::GetIndexSize( const uint32_t surfaceIx ) const
+{
+    return ( ( surfaces[ surfaceIx ].flags & MDL_SURFACE_FLAG_INDEX16 ) != 0 ) ? sizeof( uint16_t ) : sizeof( uint32_t );
+}
+
+
+const void* MappedModel::GetSurfaceIndices( const uint32_t surfaceIx, uint32_t& indexSize ) const
+{
+    const bool mixedSize = ( indexSection != nullptr ) && ( indexSection->type == MDL_SECTION_INDICES ) && ( ( indexSection->flags & MDL_SECTION_FLAG_MIXED_INDEX_SIZE ) != 0 );
+    if ( mixedSize )
+    {
+        const uint8_t* bytes = SectionBytes( indexGeometry );
+        indexSize = GetIndexSize( surfaceIx );
+        return ( bytes != nullptr ) ? ( bytes + ( toc[ surfaceIx ].ibFileOffset - indexSection->offset ) ) : nullptr;
+    }
+
+    indexSize = sizeof( uint32_t );
+    return ( indices != nullptr ) ? ( indices + surfaces[ surfaceIx ].ibOffset ) : nullptr;
+}
+
+
+bool MappedModel::LoadSurfaces( const uint32_t* surfaceIds, const uint32_t count, mdlSurfaceSet_t& set, std::string* err ) const
+{
+    set.vertices.clear();
+    set.indices.clear();
+    set.indices16.clear();
+    set.surfaces.clear();
+
+    std::string problem;
+    if ( fileData == nullptr )
+    {
+        problem = "model is not open";
+    }
+    else if ( ( toc == nullptr ) && ( count > 0 ) )
+    {
+        problem = "model has no surface table";
+    }
+
+    // Surfaces sharing a vertex range share it in the set too. Every range and
+    // surface gets its place in the set first, so they can all decode at once.
+    struct rangeKey_t
+    {
+        uint64_t    fileOffset;
+        uint32_t    vbOffset;
+        uint32_t    vbCount;
+
+        bool operator==( const rangeKey_t& other ) const
+        {
+            return ( fileOffset == other.fileOffset ) && ( vbOffset == other.vbOffset ) && ( vbCount == other.vbCount );
+        }
+    };
+    struct rangeKeyHash_t
+    {
+        size_t operator()( const rangeKey_t& key ) const
+        {
+            uint64_t hash = key.fileOffset * 0x9E3779B97F4A7C15ull;
+            hash ^= ( ( static_cast<uint64_t>( key.vbOffset ) << 32 ) | key.vbCount ) + ( hash >> 29 );
+            return static_cast<size_t>( hash * 0xBF58476D1CE4E5B9ull );
+        }
+    };
+    std::unordered_map<rangeKey_t, uint32_t, rangeKeyHash_t> setOffsets;     // Of each range in set.vertices
+    std::vector<uint8_t> decodesRange( count, 0 );
+    size_t vertexTotal = 0;
+    size_t indexTotal = 0;
+    size_t index16Total = 0;
+
+    for ( uint32_t i = 0; problem.empty() && ( i < count ); ++i )
+    {
+        const uint32_t surfaceIx = surfaceIds[ i ];
+        if ( surfaceIx >= surfaceCount )
+        {
+            problem = "surface " + std::to_string( surfaceIx ) + " does not exist";
+            break;
+        }
+
+        mdlSurface_t surface = surfaces[ surfaceIx ];
+        const rangeKey_t key = { toc[ surfaceIx ].vbFileOffset, surface.vbOffset, surface.vbCount };
+
+        const auto inserted = setOffsets.insert( std::make_pair( key, static_cast<uint32_t>( vertexTotal ) ) );
+        surface.vbOffset = inserted.first->second;
+        if ( inserted.second )
+        {
+            decodesRange[ i ] = 1;
+            vertexTotal += surface.vbCount;
+        }
+
+        size_t& ibTotal = ( ( surface.flags & MDL_SURFACE_FLAG_INDEX16 ) != 0 ) ? index16Total : indexTotal;
+        surface.ibOffset = static_cast<uint32_t>( ibTotal );
+        ibTotal += surface.ibCount;
+        set.surfaces.push_back( surface );
+    }
+
+    if ( problem.empty() )
+    {
+        set.vertices.resize( vertexTotal );
+        set.indices.resize( indexTotal );
+        set.indices16.resize( index16Total );
+
+        // 1 if the vertices failed, 2 if the indices did
+        std::vector<uint8_t> failures( count, 0 );
+        ParallelFor( count, threadCount, [&]( const uint32_t i )
+        {
+            const mdlSurface_t& surface = set.surfaces[ i ];
+            if ( ( decodesRange[ i ] != 0 ) && !DecodeVertexRange( surfaceIds[ i ], set.vertices.data() + surface.vbOffset ) )
+            {
+                failures[ i ] = 1;
+            }
+            else if ( ( surface.flags & MDL_SURFACE_FLAG_INDEX16 ) != 0 )
+            {
+                failures[ i ] = DecodeIndexRange( surfaceIds[ i ], set.indices16.data() + surface.ibOffset ) ? 0 : 2;
+            }
+            else
+            {
+                failures[ i ] = DecodeIndexRange( surfaceIds[ i ], set.indices.data() + surface.ibOffset ) ? 0 : 2;
+            }
+        } );
+
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            if ( failures[ i ] != 0 )
+            {
+                problem = "surface " + std::to_string( surfaceIds[ i ] ) + ( ( failures[ i ] == 1 ) ? " vertices do not decode" : " indices do not decode" );
+                break;
+            }
+        }
+    }
+
+    if ( !problem.empty() )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Cannot load surfaces: " + problem;
+        }
+        return false;
+    }
+    return true;
+}
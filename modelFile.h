@@ -0,0 +1,401 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "../GfxCore/geom.h"
+#include "mappedFile.h"
+
+struct importedModel_t;
+struct convertOptions_t;
+namespace tinyobj
+{
+struct material_t;
+}
+
+// Versioned .mdl layout that can be used straight from a memory mapping.
+//
+// The file is a fixed header, a run of sections and a section table. Every
+// section starts on a MdlSectionAlignment boundary and all references are
+// offsets from the start of the file or counts, so nothing needs fixing up after
+// mapping. Sections a loader does not know are skipped.
+//
+// Legacy StoreModelBin files start with a zero word and never match the magic.
+
+static const uint32_t MdlMagic = 0x584C444D;    // "MDLX"
+static const uint32_t MdlVersion = 11;
+static const uint32_t MdlSectionAlignment = 64;
+static const uint32_t MdlLzBlockSize = 128 * 1024;
+static const uint32_t MdlLzMaxBlockSize = 1024 * 1024;
+
+enum mdlSectionType_t : uint32_t
+{
+    MDL_SECTION_NAME            = 1,    // char[], null terminated
+    MDL_SECTION_VERTICES        = 2,    // vertex_t[]
+    MDL_SECTION_INDICES         = 3,    // uint32_t[], relative to the surface's vbOffset
+    MDL_SECTION_SURFACES        = 4,    // mdlSurface_t[]
+    MDL_SECTION_MATERIALS       = 5,    // mdlMaterial_t[]
+    MDL_SECTION_QUANTIZATION    = 6,    // mdlVertexQuantization_t, v2
+    MDL_SECTION_PACKED_VERTICES = 7,    // mdlPackedVertex_t[], in place of MDL_SECTION_VERTICES, v2
+    MDL_SECTION_ENCODED_INDICES = 8,    // uint64_t streamOffsets[ surfaces + 1 ] then EncodeIndexBuffer() streams, v3
+    MDL_SECTION_SURFACE_TOC     = 9,    // mdlSurfaceToc_t[], one per surface, v5
+    MDL_SECTION_CHECKSUMS       = 10,   // uint32_t[], CRC32C of each section as stored, in table order, 0 for itself, v8
+    MDL_SECTION_MESHLETS        = 11,   // mdlMeshlet_t[], each surface's run located by its meshletOffset, v9
+    MDL_SECTION_MESHLET_VERTICES = 12,  // uint32_t[], relative to the surface's vbOffset, v9
+    MDL_SECTION_MESHLET_TRIANGLES = 13, // uint8_t[], three meshlet vertex numbers per triangle, each meshlet 4-byte aligned, v9
+    MDL_SECTION_LODS            = 14,   // mdlLod_t[ surfaces * levels ], each surface's levels together, v10
+    MDL_SECTION_LOD_INDICES     = 15,   // uint32_t[], relative to the surface's vbOffset like its full indices, v10
+    MDL_SECTION_SURFACE_BOUNDS  = 16,   // mdlBounds_t[], one per surface, v11
+};
+
+enum mdlSectionFlags_t : uint32_t
+{
+    MDL_SECTION_FLAG_VERTEX_CODEC       = ( 1 << 0 ),   // Vertex section stored with EncodeVertexBuffer(), v4
+    MDL_SECTION_FLAG_SURFACE_STREAMS    = ( 1 << 1 ),   // One vertex stream per surface, located by the TOC, v5
+    MDL_SECTION_FLAG_MIXED_INDEX_SIZE   = ( 1 << 2 ),   // Raw indices at each surface's width, 4-byte aligned, located by the TOC, v6
+    MDL_SECTION_FLAG_LZ                 = ( 1 << 3 ),   // Payload is LZ blocks, see mdlLzHeader_t, v7
+};
+
+enum mdlSurfaceFlags_t : uint32_t
+{
+    MDL_SURFACE_FLAG_INDEX16            = ( 1 << 0 ),   // Indices fit in 16 bits and are stored that way when raw, v6
+};
+
+enum mdlUvEncoding_t : uint32_t
+{
+    MDL_UV_UNORM16  = 0,    // UVs all in [0, 1]
+    MDL_UV_HALF     = 1,
+};
+
+// Box and sphere around the vertices a surface or model uses, as they decode
+struct mdlBounds_t
+{
+    float       min[ 3 ];
+    float       max[ 3 ];
+    float       center[ 3 ];
+    float       radius;
+};
+
+struct mdlHeader_t
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    headerSize;
+    uint32_t    sectionCount;
+    uint64_t    sectionTableOffset;
+    uint64_t    fileSize;
+    uint32_t    vertexStride;       // sizeof( vertex_t ) of the writer
+    uint32_t    sectionTableChecksum; // CRC32C of the section table, v8
+    mdlBounds_t bounds;             // Whole model, v11
+    uint32_t    reserved[ 12 ];
+};
+
+struct mdlSection_t
+{
+    uint32_t    type;
+    uint32_t    flags;
+    uint64_t    offset;
+    uint64_t    size;
+    uint64_t    count;
+};
+
+struct mdlSurface_t
+{
+    uint32_t    vbOffset;
+    uint32_t    vbCount;
+    uint32_t    ibOffset;
+    uint32_t    ibCount;
+    int32_t     materialId;
+    uint32_t    flags;              // mdlSurfaceFlags_t, v6
+    uint32_t    meshletOffset;      // v9, 0 and 0 without meshlets
+    uint32_t    meshletCount;
+};
+
+// Where each surface's vertex and index bytes are, raw or encoded, so a subset
+// of surfaces can be read without touching the rest of the file
+struct mdlSurfaceToc_t
+{
+    uint64_t    vbFileOffset;
+    uint64_t    vbByteSize;
+    uint64_t    ibFileOffset;
+    uint64_t    ibByteSize;
+};
+
+// Start of a MDL_SECTION_FLAG_LZ section, followed by uint64_t blockOffsets[ blockCount + 1 ]
+// relative to the section, then the blocks. Every block but the last inflates to
+// blockSize bytes, and a block stored at its inflated size is not compressed.
+//
+// The section's count and every offset into it, from the TOC or within the
+// payload, are as if it were stored inflated.
+struct mdlLzHeader_t
+{
+    uint64_t    rawSize;
+    uint32_t    blockSize;
+    uint32_t    blockCount;
+};
+
+// Up to 256 vertices and their triangles, with bounds for cluster culling. Drop
+// the meshlet if it is outside the view, or if
+// dot( normalize( coneApex - cameraPos ), coneAxis ) >= coneCutoff
+// since then every triangle in it faces away.
+struct mdlMeshlet_t
+{
+    uint32_t    vertexOffset;       // Into MDL_SECTION_MESHLET_VERTICES
+    uint32_t    triangleOffset;     // Byte offset into MDL_SECTION_MESHLET_TRIANGLES
+    uint32_t    vertexCount;
+    uint32_t    triangleCount;
+    float       center[ 3 ];        // Bounding sphere
+    float       radius;
+    float       coneApex[ 3 ];
+    float       coneCutoff;         // Sine of the normal cone half angle, 1 when the cone is too wide to cull
+    float       coneAxis[ 3 ];
+    uint32_t    reserved;
+};
+
+// A simplified version of a surface over the same vertices. Levels get coarser
+// in order.
+struct mdlLod_t
+{
+    uint32_t    ibOffset;           // Into MDL_SECTION_LOD_INDICES
+    uint32_t    ibCount;
+    float       error;              // Largest deviation from the full surface, relative to its extent
+    uint32_t    reserved;
+};
+
+struct mdlMaterial_t
+{
+    char        name[ 128 ];
+    char        colorMap[ 128 ];    // Texture file name, empty if untextured
+    float       Ka[ 3 ];
+    float       Ke[ 3 ];
+    float       Kd[ 3 ];
+    float       Ks[ 3 ];
+    float       Tf[ 3 ];
+    float       Ni;
+    float       Ns;
+    float       Tr;
+    float       d;
+    int32_t     illum;
+    uint32_t    reserved[ 4 ];
+};
+
+// Everything a packed vertex needs to be decoded. Attributes that are the same
+// for every vertex, pos.w and color, are stored once here instead of per vertex.
+struct mdlVertexQuantization_t
+{
+    float       posMin[ 3 ];
+    float       posExtent[ 3 ];     // pos = posMin + ( q / 65535 ) * posExtent
+    float       posW;
+    float       color[ 4 ];
+    uint32_t    uvEncoding;         // mdlUvEncoding_t
+    uint32_t    reserved[ 4 ];
+};
+
+struct mdlPackedVertex_t
+{
+    uint16_t    pos[ 3 ];           // unorm16 over the model AABB
+    int16_t     normal[ 2 ];        // Octahedral, snorm16
+    uint16_t    uv[ 2 ];            // unorm16 or half, see mdlUvEncoding_t
+    uint16_t    reserved;
+};
+
+static_assert( sizeof( mdlBounds_t ) == 40, "mdlBounds_t is part of the file format" );
+static_assert( sizeof( mdlHeader_t ) == 128, "mdlHeader_t is part of the file format" );
+static_assert( sizeof( mdlSection_t ) == 32, "mdlSection_t is part of the file format" );
+static_assert( sizeof( mdlSurface_t ) == 32, "mdlSurface_t is part of the file format" );
+static_assert( sizeof( mdlSurfaceToc_t ) == 32, "mdlSurfaceToc_t is part of the file format" );
+static_assert( sizeof( mdlLzHeader_t ) == 16, "mdlLzHeader_t is part of the file format" );
+static_assert( sizeof( mdlMeshlet_t ) == 64, "mdlMeshlet_t is part of the file format" );
+static_assert( sizeof( mdlLod_t ) == 16, "mdlLod_t is part of the file format" );
+static_assert( sizeof( mdlMaterial_t ) == 352, "mdlMaterial_t is part of the file format" );
+static_assert( sizeof( mdlVertexQuantization_t ) == 64, "mdlVertexQuantization_t is part of the file format" );
+static_assert( sizeof( mdlPackedVertex_t ) == 16, "mdlPackedVertex_t is part of the file format" );
+
+
+// Streams sections to disk. Sections are written one at a time, then Finish()
+// appends the section table and patches the header. MDL_SECTION_FLAG_LZ sections
+// are held until EndSection() and compressed a block per task; GetOffset() stays
+// in inflated terms meanwhile. Finish() adds a MDL_SECTION_CHECKSUMS section.
+class MdlWriter
+{
+public:
+    MdlWriter();
+    ~MdlWriter();
+
+    MdlWriter( const MdlWriter& ) = delete;
+    MdlWriter& operator=( const MdlWriter& ) = delete;
+
+    void                Open( const std::string& path, const uint32_t threadCount = 0 );
+    void                BeginSection( const uint32_t type, const uint32_t flags = 0 );
+    void                Write( const void* data, const size_t size );
+    void                EndSection( const uint64_t count );
+    void                SetBounds( const mdlBounds_t& bounds ) { this->bounds = bounds; }
+    void                Finish();
+
+    uint64_t            GetOffset() const { return compress ? ( sections.back().offset + pending.size() ) : offset; }
+
+private:
+    void                WriteFile( const void* data, const size_t size );
+    void                WriteCompressed();
+    void                Pad();
+
+    FILE*                       file;
+    std::string                 path;
+    uint64_t                    offset;
+    std::vector<mdlSection_t>   sections;
+    std::vector<uint32_t>       checksums;
+    bool                        sectionOpen;
+    bool                        compress;
+    std::vector<uint8_t>        pending;
+    uint32_t                    threadCount;
+    mdlBounds_t                 bounds;
+};
+
+
+enum mdlOpenFlags_t : uint32_t
+{
+    MDL_OPEN_DEFER_DECODE   = ( 1 << 0 ),   // Leave packed and encoded geometry alone, see LoadSurfaces()
+    MDL_OPEN_VERIFY         = ( 1 << 1 ),   // Check every section's CRC32C; files without checksums fail
+};
+
+// A subset of a model's surfaces, decoded into buffers of their own. Surfaces
+// flagged MDL_SURFACE_FLAG_INDEX16 have their indices in indices16.
+struct mdlSurfaceSet_t
+{
+    std::vector<vertex_t>       vertices;
+    std::vector<uint32_t>       indices;
+    std::vector<uint16_t>       indices16;
+    std::vector<mdlSurface_t>   surfaces;   // Offsets rebased into the buffers above
+};
+
+// Read-only view of a mapped .mdl. Accessors point into the mapping, except for
+// packed or encoded vertices and encoded or mixed-width indices, which are
+// decoded at Open(), and LZ sections, which are inflated at Open().
+// With MDL_OPEN_DEFER_DECODE those accessors return null instead, and Open() only
+// reads the header, surfaces, TOC and materials.
+class MappedModel
+{
+public:
+    MappedModel();
+
+    // threadCount bounds the workers used to inflate, verify and decode; 0 uses
+    // every hardware thread. LoadSurfaces() uses the same count.
+    bool                            Open( const std::string& path, std::string* err, const uint32_t openFlags = 0, const uint32_t threadCount = 0 );
+    // A model already in memory, such as a pack entry. data must stay valid until
+    // Close() and be MdlSectionAlignment aligned.
+    bool                            Open( const uint8_t* data, const uint64_t size, std::string* err, const uint32_t openFlags = 0, const uint32_t threadCount = 0 );
+    void                            Close();
+
+    const mdlSection_t*             FindSection( const uint32_t type ) const;
+
+    const char*                     GetName() const { return name; }
+    const vertex_t*                 GetVertices() const { return vertices; }
+    uint32_t                        GetVertexCount() const { return vertexCount; }
+    const uint32_t*                 GetIndices() const { return indices; }
+    uint32_t                        GetIndexCount() const { return indexCount; }
+    const mdlSurface_t*             GetSurfaces() const { return surfaces; }
+    uint32_t                        GetSurfaceCount() const { return surfaceCount; }
+    const mdlMaterial_t*            GetMaterials() const { return materials; }
+    uint32_t                        GetMaterialCount() const { return materialCount; }
+
+    // 2 or 4. GetSurfaceIndices() returns the stored width when it can point into
+    // the mapping, otherwise the 32-bit decoded indices.
+    uint32_t                        GetIndexSize( const uint32_t surfaceIx ) const;
+    const void*                     GetSurfaceIndices( const uint32_t surfaceIx, uint32_t& indexSize ) const;
+
+    // Decodes only the listed surfaces. Works whether or not Open() deferred decoding.
+    bool                            LoadSurfaces( const uint32_t* surfaceIds, const uint32_t count, mdlSurfaceSet_t& set, std::string* err ) const;
+
+    // Packed models only; null otherwise. For callers that decode on the GPU.
+    const mdlPackedVertex_t*        GetPackedVertices() const { return packedVertices; }
+    const mdlVertexQuantization_t*  GetQuantization() const { return quantization; }
+
+    // Meshlets of every surface, each surface's run at its meshletOffset. Meshlet
+    // vertices are relative to the surface's vbOffset. Empty without meshlets.
+    const mdlMeshlet_t*             GetMeshlets() const { return meshlets; }
+    uint32_t                        GetMeshletCount() const { return meshletCount; }
+    const uint32_t*                 GetMeshletVertices() const { return meshletVertices; }
+    const uint8_t*                  GetMeshletTriangles() const { return meshletTriangles; }
+
+    // Every surface has the same number of LOD levels, 0 without LODs
+    uint32_t                        GetLodLevelCount() const { return ( surfaceCount > 0 ) ? ( lodCount / surfaceCount ) : 0; }
+    const mdlLod_t*                 GetSurfaceLods( const uint32_t surfaceIx ) const { return ( lods != nullptr ) ? ( lods + surfaceIx * GetLodLevelCount() ) : nullptr; }
+    const uint32_t*                 GetLodIndices() const { return lodIndices; }
+
+    // Bounds of the vertices each surface indexes and of the whole vertex
+    // buffer, so culling needs no vertex data
+    const mdlBounds_t*              GetBounds() const { return bounds; }
+    const mdlBounds_t*              GetSurfaceBounds() const { return surfaceBounds; }
+
+private:
+    // A vertex or index section. view is the table entry as if stored inflated,
+    // lz is set when it is not.
+    struct geometrySection_t
+    {
+        mdlSection_t                view;
+        const mdlLzHeader_t*        lz;
+        const uint64_t*             blockOffsets;
+        std::vector<uint8_t>        inflated;
+    };
+
+    bool                            OpenData( std::string* err, const uint32_t openFlags );
+    bool                            Validate( std::string* err );
+    bool                            Verify( std::string* err ) const;
+    const mdlSection_t*             OpenGeometrySection( const mdlSection_t* section, geometrySection_t& geometry, std::string& problem );
+    void                            MapGeometry();
+    bool                            InflateSections();
+    bool                            InflateBlock( const geometrySection_t& geometry, const uint32_t blockIx, uint8_t* dst ) const;
+    const uint8_t*                  SectionBytes( const geometrySection_t& geometry ) const;
+    const uint8_t*                  ReadSection( const geometrySection_t& geometry, const uint64_t fileOffset, const uint64_t size, std::vector<uint8_t>& scratch ) const;
+    bool                            DecodeAll();
+    bool                            DecodeVertexRange( const uint32_t surfaceIx, vertex_t* dst ) const;
+    template< class Index >
+    bool                            DecodeIndexRange( const uint32_t surfaceIx, Index* dst ) const;
+
+    MappedFile                      file;
+    const uint8_t*                  fileData;           // file's mapping or the caller's bytes
+    uint64_t                        fileSize;
+    const mdlHeader_t*              header;
+    const mdlSection_t*             sections;
+    const char*                     name;
+    const vertex_t*                 vertices;
+    uint32_t                        vertexCount;
+    const mdlPackedVertex_t*        packedVertices;
+    const mdlVertexQuantization_t*  quantization;
+    std::vector<vertex_t>           decodedVertices;
+    std::vector<mdlPackedVertex_t>  decodedPacked;
+    const uint32_t*                 indices;
+    uint32_t                        indexCount;
+    std::vector<uint32_t>           decodedIndices;
+    const mdlSurface_t*             surfaces;
+    uint32_t                        surfaceCount;
+    const mdlMaterial_t*            materials;
+    uint32_t                        materialCount;
+    const mdlSurfaceToc_t*          toc;
+    const mdlMeshlet_t*             meshlets;
+    uint32_t                        meshletCount;
+    const uint32_t*                 meshletVertices;
+    uint32_t                        meshletVertexCount;
+    const uint8_t*                  meshletTriangles;
+    uint32_t                        meshletTriangleBytes;
+    const mdlLod_t*                 lods;
+    uint32_t                        lodCount;
+    const uint32_t*                 lodIndices;
+    uint32_t                        lodIndexCount;
+    const mdlBounds_t*              bounds;             // In the header
+    const mdlBounds_t*              surfaceBounds;
+    const mdlSection_t*             vertexSection;     // &vertexGeometry.view or null
+    const mdlSection_t*             indexSection;
+    uint32_t                        threadCount;
+    geometrySection_t               vertexGeometry;
+    geometrySection_t               indexGeometry;
+};
+
+
+// Writes an imported model, with final UVs, in the mapped layout
+void StoreModelMapped( const std::string& path, const std::string& name, const importedModel_t& imported, const convertOptions_t& options );
+
+// Pieces of StoreModelMapped() for writers that stream their geometry
+void ComputeBounds( const float* points, const size_t count, const size_t stride, mdlBounds_t& bounds );
+void WriteMaterialSection( MdlWriter& writer, const std::vector<tinyobj::material_t>& materials );
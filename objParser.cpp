@@ -0,0 +1,644 @@
+#include <string.h>
+#include <map>
+#include <memory>
+#include <algorithm>
+#include "objParser.h"
+#include "arena.h"
+#include "fastFloat.h"
+#include "mappedFile.h"
+#include "parallel.h"
+
+// Polygon corner as written in the file. Positive OBJ indices are stored
+// already rebased to 0. Negative indices can point into earlier chunks, so they
+// are stored relative to the chunk's first element and flagged until fix-up.
+struct objCorner_t
+{
+    int32_t     v;
+    int32_t     vt;
+    int32_t     vn;
+    uint32_t    relative;
+};
+
+static const uint32_t RelativeV     = ( 1 << 0 );
+static const uint32_t RelativeVt    = ( 1 << 1 );
+static const uint32_t RelativeVn    = ( 1 << 2 );
+
+// Names are short and few, so small blocks keep a chunk's arena from reserving much
+static const size_t NameBlockSize = 16 * 1024;
+
+enum objEventType_t
+{
+    OBJ_EVENT_GROUP,
+    OBJ_EVENT_OBJECT,
+    OBJ_EVENT_USEMTL,
+    OBJ_EVENT_MTLLIB,
+};
+
+// State change that has to be replayed in file order
+struct objEvent_t
+{
+    objEventType_t  type;
+    uint32_t        faceIx;         // Chunk faces before the event
+    uint32_t        cornerIx;       // Chunk triangle corners before the event
+    const char*     name;           // Null terminated, in the chunk's name arena
+};
+
+// Where a run of faces between two events lands in the output shapes
+struct objSegment_t
+{
+    uint32_t        faceIx;
+    uint32_t        shapeIx;
+    uint32_t        writeOffset;
+    int32_t         materialId;
+};
+
+struct objChunk_t
+{
+    const char*                     begin;
+    const char*                     end;
+    const char*                     readBegin;      // Whole mapping, for loads that overrun a token
+    const char*                     readEnd;
+
+    std::vector<tinyobj::real_t>    positions;
+    std::vector<tinyobj::real_t>    normals;
+    std::vector<tinyobj::real_t>    texcoords;
+    std::vector<objCorner_t>        corners;
+    std::vector<uint32_t>           faceSizes;
+    std::vector<objEvent_t>         events;
+    std::unique_ptr<Arena>          names;          // Group, object, material and library names
+    uint32_t                        triangleCornerCount;
+    bool                            failed;
+
+    // Filled by the fix-up pass
+    uint32_t                        positionBase;
+    uint32_t                        normalBase;
+    uint32_t                        texcoordBase;
+    std::vector<objSegment_t>       segments;
+};
+
+
+static inline bool IsSpace( const char c )
+{
+    return ( c == ' ' ) || ( c == '\t' );
+}
+
+
+static inline bool IsDigit( const char c )
+{
+    return ( c >= '0' ) && ( c <= '9' );
+}
+
+
+static inline bool AtLineEnd( const char* p, const char* end )
+{
+    return ( p >= end ) || ( *p == '\r' ) || ( *p == '\n' ) || ( *p == '\0' );
+}
+
+
+static inline const char* SkipSpace( const char* p, const char* end )
+{
+    while ( ( p < end ) && IsSpace( *p ) )
+    {
+        ++p;
+    }
+    return p;
+}
+
+
+static inline const char* TokenEnd( const char* p, const char* end )
+{
+    while ( ( p < end ) && !IsSpace( *p ) && ( *p != '\r' ) )
+    {
+        ++p;
+    }
+    return p;
+}
+
+
+static_assert( sizeof( tinyobj::real_t ) == sizeof( float ), "ParseObjReal produces floats" );
+
+static inline tinyobj::real_t ParseReal( const char** token, const char* end, const objChunk_t& chunk, const float defaultValue )
+{
+    float value = defaultValue;
+    *token = ParseObjReal( SkipSpace( *token, end ), end, chunk.readBegin, chunk.readEnd, &value );
+    return value;
+}
+
+
+// atoi() semantics, bounded by the end of the line
+static inline int ParseInt( const char* p, const char* end )
+{
+    while ( ( p < end ) && ( IsSpace( *p ) || ( *p == '\n' ) || ( *p == '\v' ) || ( *p == '\f' ) || ( *p == '\r' ) ) )
+    {
+        ++p;
+    }
+
+    bool negative = false;
+    if ( ( p < end ) && ( ( *p == '+' ) || ( *p == '-' ) ) )
+    {
+        negative = ( *p == '-' );
+        ++p;
+    }
+
+    int value = 0;
+    while ( ( p < end ) && IsDigit( *p ) )
+    {
+        value = value * 10 + ( *p - '0' );
+        ++p;
+    }
+    return negative ? -value : value;
+}
+
+
+static inline const char* SkipIndexToken( const char* p, const char* end )
+{
+    while ( ( p < end ) && ( *p != '/' ) && !IsSpace( *p ) && ( *p != '\r' ) )
+    {
+        ++p;
+    }
+    return p;
+}
+
+
+static inline bool FixIndex( const int index, const size_t localCount, int32_t* out, uint32_t* relative, const uint32_t relativeBit )
+{
+    if ( index > 0 )
+    {
+        *out = index - 1;
+        return true;
+    }
+    if ( index == 0 )
+    {
+        // Zero is not allowed by the spec
+        return false;
+    }
+    *out = static_cast<int32_t>( localCount ) + index;
+    *relative |= relativeBit;
+    return true;
+}
+
+
+static bool ParseFace( const char* p, const char* end, objChunk_t& chunk )
+{
+    const size_t positionCount = chunk.positions.size() / 3;
+    const size_t normalCount = chunk.normals.size() / 3;
+    const size_t texcoordCount = chunk.texcoords.size() / 2;
+
+    const size_t firstCorner = chunk.corners.size();
+
+    p = SkipSpace( p, end );
+    while ( !AtLineEnd( p, end ) )
+    {
+        objCorner_t corner;
+        corner.v = -1;
+        corner.vt = -1;
+        corner.vn = -1;
+        corner.relative = 0;
+
+        if ( !FixIndex( ParseInt( p, end ), positionCount, &corner.v, &corner.relative, RelativeV ) )
+        {
+            return false;
+        }
+        p = SkipIndexToken( p, end );
+
+        if ( ( p < end ) && ( *p == '/' ) )
+        {
+            p++;
+            if ( ( p < end ) && ( *p == '/' ) )
+            {
+                // i//k
+                p++;
+                if ( !FixIndex( ParseInt( p, end ), normalCount, &corner.vn, &corner.relative, RelativeVn ) )
+                {
+                    return false;
+                }
+                p = SkipIndexToken( p, end );
+            }
+            else
+            {
+                // i/j or i/j/k
+                if ( !FixIndex( ParseInt( p, end ), texcoordCount, &corner.vt, &corner.relative, RelativeVt ) )
+                {
+                    return false;
+                }
+                p = SkipIndexToken( p, end );
+
+                if ( ( p < end ) && ( *p == '/' ) )
+                {
+                    p++;
+                    if ( !FixIndex( ParseInt( p, end ), normalCount, &corner.vn, &corner.relative, RelativeVn ) )
+                    {
+                        return false;
+                    }
+                    p = SkipIndexToken( p, end );
+                }
+            }
+        }
+
+        chunk.corners.push_back( corner );
+        while ( ( p < end ) && ( IsSpace( *p ) || ( *p == '\r' ) ) )
+        {
+            ++p;
+        }
+    }
+
+    const uint32_t cornerCount = static_cast<uint32_t>( chunk.corners.size() - firstCorner );
+    if ( cornerCount < 3 )
+    {
+        // Points and lines written as faces are dropped, as in LoadObj
+        chunk.corners.resize( firstCorner );
+        return true;
+    }
+
+    chunk.faceSizes.push_back( cornerCount );
+    chunk.triangleCornerCount += 3 * ( cornerCount - 2 );
+    return true;
+}
+
+
+static void AddEvent( objChunk_t& chunk, const objEventType_t type, const char* name )
+{
+    objEvent_t event;
+    event.type = type;
+    event.faceIx = static_cast<uint32_t>( chunk.faceSizes.size() );
+    event.cornerIx = chunk.triangleCornerCount;
+    event.name = name;
+    chunk.events.push_back( event );
+}
+
+
+// The line's tokens joined by single spaces. The copy never outgrows the line.
+static const char* JoinNames( Arena& arena, const char* p, const char* end )
+{
+    char* names = static_cast<char*>( arena.Allocate( ( end - p ) + 1, 1 ) );
+    char* dst = names;
+    p = SkipSpace( p, end );
+    while ( !AtLineEnd( p, end ) )
+    {
+        const char* tokenEnd = TokenEnd( p, end );
+        if ( dst != names )
+        {
+            *dst++ = ' ';
+        }
+        memcpy( dst, p, tokenEnd - p );
+        dst += tokenEnd - p;
+        p = SkipSpace( tokenEnd, end );
+    }
+    *dst = '\0';
+    return names;
+}
+
+
+static const char* CopyName( Arena& arena, const char* begin, const char* end )
+{
+    char* name = static_cast<char*>( arena.Allocate( ( end - begin ) + 1, 1 ) );
+    memcpy( name, begin, end - begin );
+    name[ end - begin ] = '\0';
+    return name;
+}
+
+
+static void ParseChunk( objChunk_t& chunk )
+{
+    const char* p = chunk.begin;
+    while ( p < chunk.end )
+    {
+        const char* lineEnd = static_cast<const char*>( memchr( p, '\n', chunk.end - p ) );
+        if ( lineEnd == nullptr )
+        {
+            lineEnd = chunk.end;
+        }
+
+        const char* token = SkipSpace( p, lineEnd );
+        p = lineEnd + 1;
+
+        if ( AtLineEnd( token, lineEnd ) || ( token[ 0 ] == '#' ) )
+        {
+            continue;
+        }
+
+        const size_t lineLength = lineEnd - token;
+        if ( ( lineLength >= 2 ) && ( token[ 0 ] == 'v' ) && IsSpace( token[ 1 ] ) )
+        {
+            token += 2;
+            chunk.positions.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+            chunk.positions.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+            chunk.positions.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+        }
+        else if ( ( lineLength >= 3 ) && ( token[ 0 ] == 'v' ) && ( token[ 1 ] == 'n' ) && IsSpace( token[ 2 ] ) )
+        {
+            token += 3;
+            chunk.normals.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+            chunk.normals.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+            chunk.normals.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+        }
+        else if ( ( lineLength >= 3 ) && ( token[ 0 ] == 'v' ) && ( token[ 1 ] == 't' ) && IsSpace( token[ 2 ] ) )
+        {
+            token += 3;
+            chunk.texcoords.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+            chunk.texcoords.push_back( ParseReal( &token, lineEnd, chunk, 0.0f ) );
+        }
+        else if ( ( lineLength >= 2 ) && ( token[ 0 ] == 'f' ) && IsSpace( token[ 1 ] ) )
+        {
+            if ( !ParseFace( token + 2, lineEnd, chunk ) )
+            {
+                chunk.failed = true;
+                return;
+            }
+        }
+        else if ( ( lineLength >= 2 ) && ( ( token[ 0 ] == 'g' ) || ( token[ 0 ] == 'o' ) ) && IsSpace( token[ 1 ] ) )
+        {
+            AddEvent( chunk, ( token[ 0 ] == 'g' ) ? OBJ_EVENT_GROUP : OBJ_EVENT_OBJECT, JoinNames( *chunk.names, token + 2, lineEnd ) );
+        }
+        else if ( ( lineLength >= 7 ) && ( strncmp( token, "usemtl", 6 ) == 0 ) && IsSpace( token[ 6 ] ) )
+        {
+            const char* name = SkipSpace( token + 7, lineEnd );
+            AddEvent( chunk, OBJ_EVENT_USEMTL, CopyName( *chunk.names, name, TokenEnd( name, lineEnd ) ) );
+        }
+        else if ( ( lineLength >= 7 ) && ( strncmp( token, "mtllib", 6 ) == 0 ) && IsSpace( token[ 6 ] ) )
+        {
+            AddEvent( chunk, OBJ_EVENT_MTLLIB, JoinNames( *chunk.names, token + 7, lineEnd ) );
+        }
+    }
+}
+
+
+static void SplitChunks( const char* data, const size_t size, const uint32_t threadCount, std::vector<objChunk_t>& chunks )
+{
+    // Enough chunks to balance the workers, but not so small that per-chunk overhead shows
+    const size_t minChunkSize = 256 * 1024;
+    const size_t maxChunks = 4 * static_cast<size_t>( ResolveThreadCount( threadCount ) );
+    const size_t chunkCount = std::max<size_t>( 1, std::min( maxChunks, size / minChunkSize ) );
+
+    const char* end = data + size;
+    const char* begin = data;
+    for ( size_t i = 1; i <= chunkCount; ++i )
+    {
+        const char* split = ( i == chunkCount ) ? end : ( data + ( size * i ) / chunkCount );
+        if ( split < begin )
+        {
+            continue;
+        }
+        if ( split < end )
+        {
+            const char* newline = static_cast<const char*>( memchr( split, '\n', end - split ) );
+            split = ( newline != nullptr ) ? ( newline + 1 ) : end;
+        }
+        if ( split == begin )
+        {
+            continue;
+        }
+
+        chunks.emplace_back();
+        objChunk_t& chunk = chunks.back();
+        chunk.begin = begin;
+        chunk.end = split;
+        chunk.readBegin = data;
+        chunk.readEnd = end;
+        chunk.names.reset( new Arena( NameBlockSize ) );
+        chunk.triangleCornerCount = 0;
+        chunk.failed = false;
+
+        begin = split;
+    }
+}
+
+
+static void LoadMaterialLibrary( const char* fileNames, tinyobj::MaterialReader& reader, std::vector<tinyobj::material_t>* materials,
+                                 std::map<std::string, int>& materialMap, std::string* warn, std::string* err )
+{
+    const char* p = fileNames;
+    const char* end = p + strlen( fileNames );
+
+    bool found = false;
+    while ( !found && ( p < end ) )
+    {
+        const char* tokenEnd = TokenEnd( p, end );
+        const std::string fileName( p, tokenEnd );
+        p = SkipSpace( tokenEnd, end );
+
+        std::string mtlWarn, mtlErr;
+        found = reader( fileName, materials, &materialMap, &mtlWarn, &mtlErr );
+
+        if ( warn != nullptr )
+        {
+            *warn += mtlWarn;
+        }
+        if ( err != nullptr )
+        {
+            *err += mtlErr;
+        }
+    }
+
+    if ( !found && ( warn != nullptr ) )
+    {
+        *warn += "Failed to load material file(s). Use default material.\n";
+    }
+}
+
+
+static inline int ResolveCorner( const int32_t index, const uint32_t relative, const uint32_t bit, const uint32_t base )
+{
+    return ( relative & bit ) ? ( static_cast<int>( base ) + index ) : index;
+}
+
+
+static void FillChunkShapes( const objChunk_t& chunk, std::vector<tinyobj::shape_t>& shapes )
+{
+    const uint32_t faceCount = static_cast<uint32_t>( chunk.faceSizes.size() );
+
+    uint32_t segmentIx = 0;
+    uint32_t cornerIx = 0;
+    uint32_t writeOffset = chunk.segments[ 0 ].writeOffset;
+
+    std::vector<tinyobj::index_t> face;
+    for ( uint32_t faceIx = 0; faceIx < faceCount; ++faceIx )
+    {
+        while ( ( ( segmentIx + 1 ) < chunk.segments.size() ) && ( chunk.segments[ segmentIx + 1 ].faceIx <= faceIx ) )
+        {
+            segmentIx++;
+            writeOffset = chunk.segments[ segmentIx ].writeOffset;
+        }
+
+        const objSegment_t& segment = chunk.segments[ segmentIx ];
+        tinyobj::mesh_t& mesh = shapes[ segment.shapeIx ].mesh;
+
+        const uint32_t faceSize = chunk.faceSizes[ faceIx ];
+        face.resize( faceSize );
+        for ( uint32_t i = 0; i < faceSize; ++i )
+        {
+            const objCorner_t& corner = chunk.corners[ cornerIx + i ];
+            face[ i ].vertex_index = ResolveCorner( corner.v, corner.relative, RelativeV, chunk.positionBase );
+            face[ i ].texcoord_index = ResolveCorner( corner.vt, corner.relative, RelativeVt, chunk.texcoordBase );
+            face[ i ].normal_index = ResolveCorner( corner.vn, corner.relative, RelativeVn, chunk.normalBase );
+        }
+        cornerIx += faceSize;
+
+        for ( uint32_t i = 1; ( i + 1 ) < faceSize; ++i )
+        {
+            mesh.material_ids[ writeOffset / 3 ] = segment.materialId;
+            mesh.indices[ writeOffset++ ] = face[ 0 ];
+            mesh.indices[ writeOffset++ ] = face[ i ];
+            mesh.indices[ writeOffset++ ] = face[ i + 1 ];
+        }
+    }
+}
+
+
+bool LoadObjMapped( tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+                    std::string* warn, std::string* err, const char* filename, const char* mtlBaseDir, const uint32_t threadCount )
+{
+    attrib->vertices.clear();
+    attrib->normals.clear();
+    attrib->texcoords.clear();
+    shapes->clear();
+
+    MappedFile file;
+    if ( !file.Open( filename ) )
+    {
+        if ( err != nullptr )
+        {
+            *err += "Cannot open file [" + std::string( filename ) + "]\n";
+        }
+        return false;
+    }
+
+    std::vector<objChunk_t> chunks;
+    SplitChunks( reinterpret_cast<const char*>( file.GetData() ), static_cast<size_t>( file.GetSize() ), threadCount, chunks );
+
+    const uint32_t chunkCount = static_cast<uint32_t>( chunks.size() );
+    ParallelFor( chunkCount, threadCount, [&]( const uint32_t chunkIx )
+    {
+        ParseChunk( chunks[ chunkIx ] );
+    } );
+
+    // Fix-up: replay chunk state in file order to place attribute ranges and
+    // find which shape and material every run of faces belongs to.
+    tinyobj::MaterialFileReader materialReader( ( mtlBaseDir != nullptr ) ? mtlBaseDir : "" );
+    std::map<std::string, int> materialMap;
+
+    std::vector<uint32_t> shapeCornerCounts( 1, 0 );
+    std::vector<std::string> shapeNames( 1 );
+
+    uint32_t positionCount = 0;
+    uint32_t normalCount = 0;
+    uint32_t texcoordCount = 0;
+    int32_t materialId = -1;
+
+    for ( uint32_t chunkIx = 0; chunkIx < chunkCount; ++chunkIx )
+    {
+        objChunk_t& chunk = chunks[ chunkIx ];
+        if ( chunk.failed )
+        {
+            if ( err != nullptr )
+            {
+                *err += "Failed parse `f' line(e.g. zero value for face index.)\n";
+            }
+            return false;
+        }
+
+        chunk.positionBase = positionCount;
+        chunk.normalBase = normalCount;
+        chunk.texcoordBase = texcoordCount;
+        positionCount += static_cast<uint32_t>( chunk.positions.size() / 3 );
+        normalCount += static_cast<uint32_t>( chunk.normals.size() / 3 );
+        texcoordCount += static_cast<uint32_t>( chunk.texcoords.size() / 2 );
+
+        uint32_t segmentCorner = 0;
+        objSegment_t segment;
+        segment.faceIx = 0;
+        segment.shapeIx = static_cast<uint32_t>( shapeCornerCounts.size() - 1 );
+        segment.writeOffset = shapeCornerCounts.back();
+        segment.materialId = materialId;
+        chunk.segments.push_back( segment );
+
+        for ( const objEvent_t& event : chunk.events )
+        {
+            shapeCornerCounts.back() += event.cornerIx - segmentCorner;
+            segmentCorner = event.cornerIx;
+
+            if ( event.type == OBJ_EVENT_MTLLIB )
+            {
+                LoadMaterialLibrary( event.name, materialReader, materials, materialMap, warn, err );
+            }
+            else if ( event.type == OBJ_EVENT_USEMTL )
+            {
+                std::map<std::string, int>::const_iterator it = materialMap.find( event.name );
+                if ( it != materialMap.end() )
+                {
+                    materialId = it->second;
+                }
+                else
+                {
+                    materialId = -1;
+                    if ( warn != nullptr )
+                    {
+                        *warn += "material [ '" + std::string( event.name ) + "' ] not found in .mtl\n";
+                    }
+                }
+            }
+            else
+            {
+                // g and o close the current shape once it has faces
+                if ( shapeCornerCounts.back() > 0 )
+                {
+                    shapeCornerCounts.push_back( 0 );
+                    shapeNames.push_back( std::string() );
+                }
+                shapeNames.back() = event.name;
+            }
+
+            segment.faceIx = event.faceIx;
+            segment.shapeIx = static_cast<uint32_t>( shapeCornerCounts.size() - 1 );
+            segment.writeOffset = shapeCornerCounts.back();
+            segment.materialId = materialId;
+            chunk.segments.push_back( segment );
+        }
+        shapeCornerCounts.back() += chunk.triangleCornerCount - segmentCorner;
+    }
+
+    if ( shapeCornerCounts.back() == 0 )
+    {
+        shapeCornerCounts.pop_back();
+        shapeNames.pop_back();
+    }
+
+    const uint32_t shapeCount = static_cast<uint32_t>( shapeCornerCounts.size() );
+    shapes->resize( shapeCount );
+    for ( uint32_t shapeIx = 0; shapeIx < shapeCount; ++shapeIx )
+    {
+        tinyobj::shape_t& shape = ( *shapes )[ shapeIx ];
+        const uint32_t triangleCount = shapeCornerCounts[ shapeIx ] / 3;
+
+        shape.name = shapeNames[ shapeIx ];
+        shape.mesh.indices.resize( shapeCornerCounts[ shapeIx ] );
+        shape.mesh.material_ids.resize( triangleCount );
+        shape.mesh.num_face_vertices.assign( triangleCount, 3 );
+        shape.mesh.smoothing_group_ids.assign( triangleCount, 0 );
+    }
+
+    attrib->vertices.resize( 3 * static_cast<size_t>( positionCount ) );
+    attrib->normals.resize( 3 * static_cast<size_t>( normalCount ) );
+    attrib->texcoords.resize( 2 * static_cast<size_t>( texcoordCount ) );
+
+    ParallelFor( chunkCount, threadCount, [&]( const uint32_t chunkIx )
+    {
+        objChunk_t& chunk = chunks[ chunkIx ];
+
+        std::copy( chunk.positions.begin(), chunk.positions.end(), attrib->vertices.begin() + 3 * static_cast<size_t>( chunk.positionBase ) );
+        std::copy( chunk.normals.begin(), chunk.normals.end(), attrib->normals.begin() + 3 * static_cast<size_t>( chunk.normalBase ) );
+        std::copy( chunk.texcoords.begin(), chunk.texcoords.end(), attrib->texcoords.begin() + 2 * static_cast<size_t>( chunk.texcoordBase ) );
+
+        if ( shapeCount > 0 )
+        {
+            FillChunkShapes( chunk, *shapes );
+        }
+
+        std::vector<tinyobj::real_t>().swap( chunk.positions );
+        std::vector<tinyobj::real_t>().swap( chunk.normals );
+        std::vector<tinyobj::real_t>().swap( chunk.texcoords );
+        std::vector<objCorner_t>().swap( chunk.corners );
+    } );
+
+    return true;
+}
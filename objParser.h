@@ -0,0 +1,16 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include "tiny_obj_loader.h"
+
+// Drop-in replacement for tinyobj::LoadObj. The file is memory-mapped, split into
+// line-aligned chunks and the chunks are parsed in parallel. A serial fix-up pass
+// then resolves relative indices and usemtl/g/o state across chunk boundaries.
+//
+// Only the subset of OBJ the converter consumes is handled: v, vn, vt, f, g, o,
+// usemtl and mtllib. Polygons are fan-triangulated, which matches tinyobj for
+// triangles and convex polygons.
+bool LoadObjMapped( tinyobj::attrib_t* attrib, std::vector<tinyobj::shape_t>* shapes, std::vector<tinyobj::material_t>* materials,
+                    std::string* warn, std::string* err, const char* filename, const char* mtlBaseDir, const uint32_t threadCount );
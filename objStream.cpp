@@ -0,0 +1,175 @@
+#include <fstream>
+#include <stdexcept>
+#include "converter.h"
+#include "vertexWelder.h"
+
+// State threaded through the tinyobj callbacks. Only the raw attribute
+// arrays are kept; faces are welded into the current surface as they arrive.
+struct objStreamState_t : objSurfaceState_t
+{
+    tinyobj::attrib_t                   attrib;
+    VertexWelder*                       welder;
+    importedModel_t*                    imported;
+};
+
+
+static objStreamState_t* StreamState( void* userData )
+{
+    return static_cast<objStreamState_t*>( static_cast<objSurfaceState_t*>( userData ) );
+}
+
+
+void ResolveObjIndex( int& index, const size_t count )
+{
+    // OBJ indices are 1-based, negative values count back from the newest
+    // element and 0 means the attribute is missing.
+    if ( index > 0 )
+    {
+        index -= 1;
+    }
+    else if ( index < 0 )
+    {
+        index += static_cast<int>( count );
+    }
+    else
+    {
+        index = -1;
+    }
+}
+
+
+static void StreamVertex( void* userData, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t /*w*/ )
+{
+    std::vector<tinyobj::real_t>& vertices = StreamState( userData )->attrib.vertices;
+    vertices.push_back( x );
+    vertices.push_back( y );
+    vertices.push_back( z );
+}
+
+
+static void StreamNormal( void* userData, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z )
+{
+    std::vector<tinyobj::real_t>& normals = StreamState( userData )->attrib.normals;
+    normals.push_back( x );
+    normals.push_back( y );
+    normals.push_back( z );
+}
+
+
+static void StreamTexCoord( void* userData, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t /*z*/ )
+{
+    std::vector<tinyobj::real_t>& texcoords = StreamState( userData )->attrib.texcoords;
+    texcoords.push_back( x );
+    texcoords.push_back( y );
+}
+
+
+static void StreamFace( void* userData, tinyobj::index_t* indices, int indexCount )
+{
+    objStreamState_t* state = StreamState( userData );
+    if ( indexCount < 3 )
+    {
+        return;
+    }
+
+    importedModel_t& imported = *state->imported;
+    if ( !state->surfaceOpen )
+    {
+        imported.indexBuffers.push_back( indexBuffer_t() );
+        imported.materialIds.push_back( state->materialId );
+        state->surfaceOpen = true;
+    }
+
+    const size_t vertexCount = state->attrib.vertices.size() / 3;
+    const size_t normalCount = state->attrib.normals.size() / 3;
+    const size_t texCoordCount = state->attrib.texcoords.size() / 2;
+
+    for ( int i = 0; i < indexCount; ++i )
+    {
+        ResolveObjIndex( indices[ i ].vertex_index, vertexCount );
+        ResolveObjIndex( indices[ i ].normal_index, normalCount );
+        ResolveObjIndex( indices[ i ].texcoord_index, texCoordCount );
+    }
+
+    // Polygons are fanned around the first corner. tinyobj's ear clipping
+    // produces the same triangles for convex faces.
+    indexBuffer_t& ib = imported.indexBuffers.back();
+    const uint32_t first = state->welder->Add( TinyObjVertex( state->attrib, indices[ 0 ] ) );
+    uint32_t prev = state->welder->Add( TinyObjVertex( state->attrib, indices[ 1 ] ) );
+    for ( int i = 2; i < indexCount; ++i )
+    {
+        const uint32_t next = state->welder->Add( TinyObjVertex( state->attrib, indices[ i ] ) );
+        ib.push_back( first );
+        ib.push_back( prev );
+        ib.push_back( next );
+        prev = next;
+    }
+}
+
+
+static void ObjUseMtl( void* userData, const char* /*name*/, int materialId )
+{
+    static_cast<objSurfaceState_t*>( userData )->materialId = materialId;
+}
+
+
+static void ObjMtlLib( void* userData, const tinyobj::material_t* materials, int materialCount )
+{
+    static_cast<objSurfaceState_t*>( userData )->materials.assign( materials, materials + materialCount );
+}
+
+
+static void ObjGroup( void* userData, const char** /*names*/, int /*nameCount*/ )
+{
+    // Like LoadObj, a new group or object starts a new surface once the current one has faces
+    static_cast<objSurfaceState_t*>( userData )->surfaceOpen = false;
+}
+
+
+static void ObjObject( void* userData, const char* /*name*/ )
+{
+    static_cast<objSurfaceState_t*>( userData )->surfaceOpen = false;
+}
+
+
+void SetObjSurfaceCallbacks( tinyobj::callback_t& callbacks )
+{
+    callbacks.usemtl_cb = ObjUseMtl;
+    callbacks.mtllib_cb = ObjMtlLib;
+    callbacks.group_cb = ObjGroup;
+    callbacks.object_cb = ObjObject;
+}
+
+
+void ImportObjStreamed( const std::string& path, const convertOptions_t& options, importedModel_t& imported )
+{
+    std::ifstream objStream( path );
+    if ( !objStream )
+    {
+        throw std::runtime_error( "Cannot open file [" + path + "]" );
+    }
+
+    VertexWelder welder( 0, options.weldTolerance );
+
+    objStreamState_t state;
+    state.welder = &welder;
+    state.imported = &imported;
+
+    tinyobj::callback_t callbacks;
+    callbacks.vertex_cb = StreamVertex;
+    callbacks.normal_cb = StreamNormal;
+    callbacks.texcoord_cb = StreamTexCoord;
+    callbacks.index_cb = StreamFace;
+    SetObjSurfaceCallbacks( callbacks );
+
+    tinyobj::MaterialFileReader materialReader( ModelPath );
+    std::string warn, err;
+
+    if ( !tinyobj::LoadObjWithCallback( objStream, callbacks, static_cast<objSurfaceState_t*>( &state ), &materialReader, &warn, &err ) )
+    {
+        throw std::runtime_error( warn + err );
+    }
+
+    imported.vertices.swap( welder.GetVertices() );
+    imported.materials.swap( state.materials );
+}
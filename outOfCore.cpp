@@ -0,0 +1,511 @@
+#include <assert.h>
+#include <float.h>
+#include <string.h>
+#include <math.h>
+#include <fstream>
+#include <stdexcept>
+#include <atomic>
+#include <algorithm>
+#if defined( _WIN32 )
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+#include "converter.h"
+#include "vertexWelder.h"
+#include "spillFile.h"
+#include "mappedFile.h"
+#include "modelFile.h"
+#include "bounds.h"
+
+// Out-of-core conversion to the mapped .mdl layout. Nothing proportional to the
+// model size is held in memory; the welded vertex buffer is only ever mapped:
+//
+// 1. Parse: stream the OBJ, spilling attributes and resolved triangle corners.
+// 2. Partition: map the attribute spills, build each corner's vertex and route it
+//    to a partition by hash. Equal vertices always share a partition.
+// 3. Weld: weld one partition at a time within the memory limit, spilling the
+//    local index of every corner and the unique vertices.
+// 4. Write: copy the vertex spill into the vertex section, then replay corners in
+//    file order and stream partition base + local index into the index section.
+
+static const size_t SpillBufferSize = 1024 * 1024;
+static const size_t PartitionBufferSize = 64 * 1024;
+static const size_t SpillBatchSize = 4096;
+static const uint32_t MaxPartitions = 0xFFFF;     // Routes are spilled as uint16_t
+
+struct spillSurface_t
+{
+    uint64_t    cornerBegin;
+    uint64_t    cornerEnd;
+    int32_t     materialId;
+};
+
+// Welder input, hashed once during partitioning
+struct spillVertex_t
+{
+    vertex_t    vertex;
+    uint64_t    hash;
+};
+
+struct spillParseState_t : objSurfaceState_t
+{
+    SpillFile*                          positions;
+    SpillFile*                          normals;
+    SpillFile*                          texcoords;
+    SpillFile*                          corners;
+    uint64_t                            positionCount;
+    uint64_t                            normalCount;
+    uint64_t                            texcoordCount;
+    uint64_t                            cornerCount;
+    std::vector<spillSurface_t>         surfaces;
+};
+
+
+static spillParseState_t* SpillState( void* userData )
+{
+    return static_cast<spillParseState_t*>( static_cast<objSurfaceState_t*>( userData ) );
+}
+
+
+static void SpillVertexCallback( void* userData, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t /*w*/ )
+{
+    spillParseState_t* state = SpillState( userData );
+    const tinyobj::real_t position[ 3 ] = { x, y, z };
+    state->positions->Write( position, sizeof( position ) );
+    state->positionCount++;
+}
+
+
+static void SpillNormalCallback( void* userData, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z )
+{
+    spillParseState_t* state = SpillState( userData );
+    const tinyobj::real_t normal[ 3 ] = { x, y, z };
+    state->normals->Write( normal, sizeof( normal ) );
+    state->normalCount++;
+}
+
+
+static void SpillTexCoordCallback( void* userData, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t /*z*/ )
+{
+    spillParseState_t* state = SpillState( userData );
+    const tinyobj::real_t texcoord[ 2 ] = { x, y };
+    state->texcoords->Write( texcoord, sizeof( texcoord ) );
+    state->texcoordCount++;
+}
+
+
+static void SpillFaceCallback( void* userData, tinyobj::index_t* indices, int indexCount )
+{
+    spillParseState_t* state = SpillState( userData );
+    if ( indexCount < 3 )
+    {
+        return;
+    }
+
+    if ( !state->surfaceOpen )
+    {
+        spillSurface_t surface;
+        surface.cornerBegin = state->cornerCount;
+        surface.cornerEnd = state->cornerCount;
+        surface.materialId = state->materialId;
+        state->surfaces.push_back( surface );
+        state->surfaceOpen = true;
+    }
+
+    for ( int i = 0; i < indexCount; ++i )
+    {
+        ResolveObjIndex( indices[ i ].vertex_index, static_cast<size_t>( state->positionCount ) );
+        ResolveObjIndex( indices[ i ].normal_index, static_cast<size_t>( state->normalCount ) );
+        ResolveObjIndex( indices[ i ].texcoord_index, static_cast<size_t>( state->texcoordCount ) );
+    }
+
+    // Same fan as the streaming import
+    for ( int i = 2; i < indexCount; ++i )
+    {
+        state->corners->Write( &indices[ 0 ], sizeof( tinyobj::index_t ) );
+        state->corners->Write( &indices[ i - 1 ], sizeof( tinyobj::index_t ) );
+        state->corners->Write( &indices[ i ], sizeof( tinyobj::index_t ) );
+        state->cornerCount += 3;
+    }
+    state->surfaces.back().cornerEnd = state->cornerCount;
+}
+
+
+// Scratch files of concurrent conversions, in this process or others, must not
+// collide even for the same model
+static std::string SpillFilePrefix( const std::string& spillPath, const std::string& modelPath )
+{
+    static std::atomic<uint32_t> conversionCount( 0 );
+
+#if defined( _WIN32 )
+    const int processId = _getpid();
+#else
+    const int processId = static_cast<int>( getpid() );
+#endif
+    const std::string modelName = modelPath.substr( modelPath.find_last_of( "/\\" ) + 1 );
+    const std::string directory = spillPath.empty() ? std::string( "" ) : ( spillPath + "/" );
+    return directory + modelName + "." + std::to_string( processId ) + "." + std::to_string( conversionCount++ );
+}
+
+
+static const tinyobj::real_t* MapAttributes( SpillFile& spill, MappedFile& mapping, size_t& floatCount )
+{
+    spill.Close();
+    floatCount = static_cast<size_t>( spill.GetSize() / sizeof( tinyobj::real_t ) );
+    if ( floatCount == 0 )
+    {
+        return nullptr;
+    }
+    if ( !mapping.Open( spill.GetPath() ) )
+    {
+        throw std::runtime_error( "Cannot map spill file [" + spill.GetPath() + "]" );
+    }
+    return reinterpret_cast<const tinyobj::real_t*>( mapping.GetData() );
+}
+
+
+// Surface bounds, built up one index at a time since a surface's vertices are
+// never gathered. The grown sphere is swapped for the one around the box when
+// that is smaller.
+static void BeginBounds( mdlBounds_t& bounds )
+{
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        bounds.min[ axis ] = FLT_MAX;
+        bounds.max[ axis ] = -FLT_MAX;
+        bounds.center[ axis ] = 0.0f;
+    }
+    bounds.radius = -1.0f;
+}
+
+
+static void AddToBounds( mdlBounds_t& bounds, const float* p )
+{
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        bounds.min[ axis ] = std::min( bounds.min[ axis ], p[ axis ] );
+        bounds.max[ axis ] = std::max( bounds.max[ axis ], p[ axis ] );
+    }
+    GrowBoundingSphere( p, bounds.center, bounds.radius );
+}
+
+
+static void EndBounds( mdlBounds_t& bounds )
+{
+    if ( bounds.radius < 0.0f )
+    {
+        memset( &bounds, 0, sizeof( bounds ) );
+        return;
+    }
+
+    float halfDiagonalSquared = 0.0f;
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        const float halfExtent = ( bounds.max[ axis ] - bounds.min[ axis ] ) * 0.5f;
+        halfDiagonalSquared += halfExtent * halfExtent;
+    }
+    const float boxRadius = sqrtf( halfDiagonalSquared );
+    if ( boxRadius < bounds.radius )
+    {
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            bounds.center[ axis ] = ( bounds.min[ axis ] + bounds.max[ axis ] ) * 0.5f;
+        }
+        bounds.radius = boxRadius;
+    }
+}
+
+
+// Out-of-core models are stored with raw shared vertices and indices only.
+// Tolerance welds merge across hash partitions, and everything else here needs
+// whole surfaces or the whole vertex buffer in memory.
+const char* OutOfCoreUnsupportedOption( const convertOptions_t& options )
+{
+    const struct
+    {
+        bool        set;
+        const char* name;
+    } unsupported[] =
+    {
+        { !options.weldTolerance.IsExact(), "-posEps/-normalEps/-uvEps" },
+        { options.quantizeVertices, "-quantize" },
+        { options.encodeIndices, "-encodeIndices" },
+        { options.encodeVertices, "-encodeVertices" },
+        { options.surfaceRanges, "-surfaceRanges" },
+        { options.index16, "-index16" },
+        { options.compressSections, "-lz" },
+        { options.optimizeVertexCache, "-vcache" },
+        { options.overdrawThreshold > 0.0f, "-overdraw" },
+        { options.optimizeVertexFetch, "-vfetch" },
+        { options.buildMeshlets, "-meshlets" },
+        { !options.lodRatios.empty(), "-lod" },
+    };
+    for ( const auto& option : unsupported )
+    {
+        if ( option.set )
+        {
+            return option.name;
+        }
+    }
+    return nullptr;
+}
+
+
+void ConvertModelOutOfCore( const std::string& srcPath, const std::string& dstPath, const convertOptions_t& options )
+{
+    const char* unsupported = OutOfCoreUnsupportedOption( options );
+    if ( unsupported != nullptr )
+    {
+        throw std::runtime_error( std::string( unsupported ) + " is not supported out of core" );
+    }
+
+    const std::string spillPrefix = SpillFilePrefix( options.spillPath, srcPath );
+
+    // Pass 1: parse
+    SpillFile positions, normals, texcoords, corners;
+    positions.Create( spillPrefix + ".positions.spill", SpillBufferSize );
+    normals.Create( spillPrefix + ".normals.spill", SpillBufferSize );
+    texcoords.Create( spillPrefix + ".texcoords.spill", SpillBufferSize );
+    corners.Create( spillPrefix + ".corners.spill", SpillBufferSize );
+
+    spillParseState_t state;
+    state.positions = &positions;
+    state.normals = &normals;
+    state.texcoords = &texcoords;
+    state.corners = &corners;
+    state.positionCount = 0;
+    state.normalCount = 0;
+    state.texcoordCount = 0;
+    state.cornerCount = 0;
+
+    {
+        std::ifstream objStream( srcPath );
+        if ( !objStream )
+        {
+            throw std::runtime_error( "Cannot open file [" + srcPath + "]" );
+        }
+
+        tinyobj::callback_t callbacks;
+        callbacks.vertex_cb = SpillVertexCallback;
+        callbacks.normal_cb = SpillNormalCallback;
+        callbacks.texcoord_cb = SpillTexCoordCallback;
+        callbacks.index_cb = SpillFaceCallback;
+        SetObjSurfaceCallbacks( callbacks );
+
+        tinyobj::MaterialFileReader materialReader( ModelPath );
+        std::string warn, err;
+
+        if ( !tinyobj::LoadObjWithCallback( objStream, callbacks, static_cast<objSurfaceState_t*>( &state ), &materialReader, &warn, &err ) )
+        {
+            throw std::runtime_error( warn + err );
+        }
+    }
+
+    // Surface index offsets and counts are 32-bit. No surface ends past the total,
+    // so checking it covers every surface.
+    if ( state.cornerCount > UINT32_MAX )
+    {
+        throw std::runtime_error( "Too many triangle corners in [" + srcPath + "]: " + std::to_string( state.cornerCount ) + ", mapped models index at most " + std::to_string( UINT32_MAX ) );
+    }
+
+    // Size partitions so that one partition's weld tables fit in three quarters of
+    // the limit even if no vertex is shared. The rest covers the partition buffers,
+    // one per partition while routing and again while replaying.
+    const uint64_t bytesPerVertex = sizeof( vertex_t ) + sizeof( uint64_t ) + 4 * sizeof( uint32_t );
+    const uint64_t weldBudget = ( 3 * options.memoryLimit ) / 4;
+    const uint64_t partitionCount64 = std::max<uint64_t>( 1, ( state.cornerCount * bytesPerVertex + weldBudget - 1 ) / std::max<uint64_t>( weldBudget, 1 ) );
+    if ( ( partitionCount64 > MaxPartitions ) || ( ( partitionCount64 * 2 * PartitionBufferSize ) > ( options.memoryLimit / 4 ) ) )
+    {
+        throw std::runtime_error( "Memory limit is too small to convert [" + srcPath + "] out of core" );
+    }
+    const uint32_t partitionCount = static_cast<uint32_t>( partitionCount64 );
+
+    // Pass 2: partition
+    PartitionedSpillFile partitions;
+    partitions.Create( spillPrefix + ".partitions.spill", partitionCount, PartitionBufferSize );
+
+    SpillFile cornerPartitions;
+    cornerPartitions.Create( spillPrefix + ".routes.spill", SpillBufferSize );
+    {
+        MappedFile positionMap, normalMap, texcoordMap;
+        size_t positionFloats, normalFloats, texcoordFloats;
+        const tinyobj::real_t* positionData = MapAttributes( positions, positionMap, positionFloats );
+        const tinyobj::real_t* normalData = MapAttributes( normals, normalMap, normalFloats );
+        const tinyobj::real_t* texcoordData = MapAttributes( texcoords, texcoordMap, texcoordFloats );
+
+        corners.Rewind();
+
+        tinyobj::index_t cornerBatch[ SpillBatchSize ];
+        uint16_t routeBatch[ SpillBatchSize ];
+        for ( uint64_t cornerIx = 0; cornerIx < state.cornerCount; cornerIx += SpillBatchSize )
+        {
+            const size_t count = static_cast<size_t>( std::min<uint64_t>( SpillBatchSize, state.cornerCount - cornerIx ) );
+            if ( !corners.Read( cornerBatch, count * sizeof( tinyobj::index_t ) ) )
+            {
+                throw std::runtime_error( "Failed to read spill file [" + corners.GetPath() + "]" );
+            }
+
+            for ( size_t i = 0; i < count; ++i )
+            {
+                spillVertex_t spilled;
+                spilled.vertex = ObjVertex( positionData, positionFloats, normalData, normalFloats, texcoordData, texcoordFloats, cornerBatch[ i ] );
+                spilled.hash = HashVertex( spilled.vertex );
+
+                // High bits pick the partition; the welder's table uses the low bits
+                const uint16_t partition = static_cast<uint16_t>( ( spilled.hash >> 32 ) % partitionCount );
+                partitions.Write( partition, &spilled, sizeof( spilled ) );
+                routeBatch[ i ] = partition;
+            }
+            cornerPartitions.Write( routeBatch, count * sizeof( uint16_t ) );
+        }
+    }
+    partitions.Flush();
+    corners.Remove();
+    positions.Remove();
+    normals.Remove();
+    texcoords.Remove();
+
+    // Pass 3: weld each partition and spill its vertices
+    PartitionedSpillFile localIndices;
+    localIndices.Create( spillPrefix + ".local.spill", partitionCount, PartitionBufferSize );
+
+    SpillFile vertices;
+    vertices.Create( spillPrefix + ".vertices.spill", SpillBufferSize );
+
+    std::vector<uint32_t> partitionBases( partitionCount );
+    uint64_t vertexCount = 0;
+    for ( uint32_t p = 0; p < partitionCount; ++p )
+    {
+        const uint64_t recordCount = partitions.GetSize( p ) / sizeof( spillVertex_t );
+
+        VertexWelder welder( static_cast<size_t>( recordCount ) );
+
+        std::vector<spillVertex_t> records( SpillBatchSize );
+        uint32_t localBatch[ SpillBatchSize ];
+        for ( uint64_t recordIx = 0; recordIx < recordCount; recordIx += SpillBatchSize )
+        {
+            const size_t count = static_cast<size_t>( std::min<uint64_t>( SpillBatchSize, recordCount - recordIx ) );
+            if ( !partitions.Read( p, records.data(), count * sizeof( spillVertex_t ) ) )
+            {
+                throw std::runtime_error( "Failed to read spill file [" + partitions.GetPath() + "]" );
+            }
+            for ( size_t i = 0; i < count; ++i )
+            {
+                localBatch[ i ] = welder.Add( records[ i ].vertex, records[ i ].hash );
+            }
+            localIndices.Write( p, localBatch, count * sizeof( uint32_t ) );
+        }
+        partitions.Release( p );
+
+        std::vector<vertex_t>& uniqueVertices = welder.GetVertices();
+        NormalizeUVs( uniqueVertices.data(), uniqueVertices.size() );
+        vertices.Write( uniqueVertices.data(), uniqueVertices.size() * sizeof( vertex_t ) );
+
+        partitionBases[ p ] = static_cast<uint32_t>( vertexCount );
+        vertexCount += uniqueVertices.size();
+        if ( vertexCount > UINT32_MAX )
+        {
+            throw std::runtime_error( "Too many vertices in [" + srcPath + "]" );
+        }
+    }
+    partitions.Remove();
+    localIndices.Flush();
+
+    // Pass 4: write the model. Vertices are read back through a mapping, which the
+    // OS can page out, for the bounds.
+    MappedFile vertexMap;
+    vertices.Close();
+    if ( ( vertexCount > 0 ) && !vertexMap.Open( vertices.GetPath() ) )
+    {
+        throw std::runtime_error( "Cannot map spill file [" + vertices.GetPath() + "]" );
+    }
+    const vertex_t* vertexData = reinterpret_cast<const vertex_t*>( vertexMap.GetData() );
+
+    MdlWriter writer;
+    writer.Open( dstPath, options.threadCount );
+
+    writer.BeginSection( MDL_SECTION_NAME );
+    writer.Write( srcPath.c_str(), srcPath.size() + 1 );
+    writer.EndSection( srcPath.size() + 1 );
+
+    const uint32_t surfaceCount = static_cast<uint32_t>( state.surfaces.size() );
+    std::vector<mdlSurface_t> surfaces( surfaceCount );
+    std::vector<mdlSurfaceToc_t> toc( surfaceCount );
+    std::vector<mdlBounds_t> surfaceBounds( surfaceCount );
+
+    writer.BeginSection( MDL_SECTION_VERTICES );
+    const uint64_t vbFileOffset = writer.GetOffset();
+    writer.Write( vertexData, static_cast<size_t>( vertexCount * sizeof( vertex_t ) ) );
+    writer.EndSection( vertexCount );
+
+    mdlBounds_t modelBounds;
+    memset( &modelBounds, 0, sizeof( modelBounds ) );
+    if ( vertexCount > 0 )
+    {
+        ComputeBounds( &vertexData[ 0 ].pos[ 0 ], static_cast<size_t>( vertexCount ), sizeof( vertex_t ), modelBounds );
+    }
+    writer.SetBounds( modelBounds );
+
+    writer.BeginSection( MDL_SECTION_INDICES );
+    cornerPartitions.Rewind();
+    uint16_t routeBatch[ SpillBatchSize ];
+    uint32_t indexBatch[ SpillBatchSize ];
+    for ( uint32_t surfaceIx = 0; surfaceIx < surfaceCount; ++surfaceIx )
+    {
+        const spillSurface_t& spilled = state.surfaces[ surfaceIx ];
+        mdlSurface_t& surface = surfaces[ surfaceIx ];
+        memset( &surface, 0, sizeof( surface ) );
+        surface.vbOffset = 0;
+        surface.vbCount = static_cast<uint32_t>( vertexCount );
+        assert( spilled.cornerEnd <= UINT32_MAX );
+        surface.ibOffset = static_cast<uint32_t>( spilled.cornerBegin );
+        surface.ibCount = static_cast<uint32_t>( spilled.cornerEnd - spilled.cornerBegin );
+        surface.materialId = spilled.materialId;
+
+        toc[ surfaceIx ].vbFileOffset = vbFileOffset;
+        toc[ surfaceIx ].vbByteSize = vertexCount * sizeof( vertex_t );
+        toc[ surfaceIx ].ibFileOffset = writer.GetOffset();
+        toc[ surfaceIx ].ibByteSize = surface.ibCount * sizeof( uint32_t );
+
+        mdlBounds_t& bounds = surfaceBounds[ surfaceIx ];
+        BeginBounds( bounds );
+        for ( uint64_t cornerIx = spilled.cornerBegin; cornerIx < spilled.cornerEnd; cornerIx += SpillBatchSize )
+        {
+            const size_t count = static_cast<size_t>( std::min<uint64_t>( SpillBatchSize, spilled.cornerEnd - cornerIx ) );
+            if ( !cornerPartitions.Read( routeBatch, count * sizeof( uint16_t ) ) )
+            {
+                throw std::runtime_error( "Failed to read spill file [" + cornerPartitions.GetPath() + "]" );
+            }
+            for ( size_t i = 0; i < count; ++i )
+            {
+                uint32_t localIndex;
+                if ( !localIndices.Read( routeBatch[ i ], &localIndex, sizeof( localIndex ) ) )
+                {
+                    throw std::runtime_error( "Failed to read spill file [" + localIndices.GetPath() + "]" );
+                }
+                indexBatch[ i ] = partitionBases[ routeBatch[ i ] ] + localIndex;
+                AddToBounds( bounds, &vertexData[ indexBatch[ i ] ].pos[ 0 ] );
+            }
+            writer.Write( indexBatch, count * sizeof( uint32_t ) );
+        }
+        EndBounds( bounds );
+    }
+    writer.EndSection( state.cornerCount );
+
+    writer.BeginSection( MDL_SECTION_SURFACE_BOUNDS );
+    writer.Write( surfaceBounds.data(), surfaceBounds.size() * sizeof( mdlBounds_t ) );
+    writer.EndSection( surfaceCount );
+
+    writer.BeginSection( MDL_SECTION_SURFACE_TOC );
+    writer.Write( toc.data(), toc.size() * sizeof( mdlSurfaceToc_t ) );
+    writer.EndSection( surfaceCount );
+
+    writer.BeginSection( MDL_SECTION_SURFACES );
+    writer.Write( surfaces.data(), surfaces.size() * sizeof( mdlSurface_t ) );
+    writer.EndSection( surfaceCount );
+
+    WriteMaterialSection( writer, state.materials );
+
+    writer.Finish();
+}
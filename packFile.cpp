@@ -0,0 +1,403 @@
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include "packFile.h"
+#include "checksum.h"
+
+// FNV-1a over the type then the name, so a model and a texture may share a name
+uint64_t PackHash( const char* name, const uint32_t type )
+{
+    uint64_t hash = 0xCBF29CE484222325ull;
+    for ( uint32_t i = 0; i < 4; ++i )
+    {
+        hash = ( hash ^ ( ( type >> ( 8 * i ) ) & 0xFF ) ) * 0x100000001B3ull;
+    }
+    for ( const char* c = name; *c != '\0'; ++c )
+    {
+        hash = ( hash ^ static_cast<uint8_t>( *c ) ) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+
+PackWriter::PackWriter()
+{
+    file = nullptr;
+    created = false;
+    offset = 0;
+}
+
+
+PackWriter::~PackWriter()
+{
+    if ( file != nullptr )
+    {
+        // Abandoned before Finish(). An existing pack's header was never touched,
+        // so it still describes the old contents.
+        fclose( file );
+        if ( created )
+        {
+            remove( path.c_str() );
+        }
+    }
+}
+
+
+void PackWriter::Open( const std::string& path )
+{
+    this->path = path;
+    entries.clear();
+    names.clear();
+    entryIxs.clear();
+
+    // An existing pack is validated and its index read through a mapping, which
+    // is closed again before the file is opened for writing
+    PackFile existing;
+    std::string err;
+    created = !existing.Open( path, &err );
+    if ( created )
+    {
+#if defined( _WIN32 )
+        if ( fopen_s( &file, path.c_str(), "rb" ) != 0 )
+        {
+            file = nullptr;
+        }
+#else
+        file = fopen( path.c_str(), "rb" );
+#endif
+        if ( file != nullptr )
+        {
+            // There is something there, just not a pack
+            fclose( file );
+            file = nullptr;
+            throw std::runtime_error( err );
+        }
+    }
+    else
+    {
+        entries.assign( existing.GetEntries(), existing.GetEntries() + existing.GetEntryCount() );
+        for ( const packEntry_t& entry : entries )
+        {
+            entryIxs[ std::make_pair( entry.type, std::string( existing.GetName( entry ) ) ) ] = static_cast<uint32_t>( names.size() );
+            names.push_back( existing.GetName( entry ) );
+        }
+        offset = existing.GetHeader()->fileSize;
+        existing.Close();
+    }
+
+#if defined( _WIN32 )
+    if ( fopen_s( &file, path.c_str(), created ? "wb" : "r+b" ) != 0 )
+    {
+        file = nullptr;
+    }
+#else
+    file = fopen( path.c_str(), created ? "wb" : "r+b" );
+#endif
+    if ( file == nullptr )
+    {
+        throw std::runtime_error( "Cannot " + std::string( created ? "create" : "open" ) + " pack file [" + path + "]" );
+    }
+
+    if ( created )
+    {
+        // Placeholder, patched by Finish()
+        packHeader_t header;
+        memset( &header, 0, sizeof( header ) );
+        offset = 0;
+        Write( &header, sizeof( header ) );
+        return;
+    }
+
+    // New entries go after everything the header covers, including the current
+    // index, which stays valid until the header is repointed. Bytes past that
+    // are left from an interrupted append and get overwritten.
+#if defined( _WIN32 )
+    if ( _fseeki64( file, static_cast<int64_t>( offset ), SEEK_SET ) != 0 )
+#else
+    if ( fseeko( file, static_cast<off_t>( offset ), SEEK_SET ) != 0 )
+#endif
+    {
+        throw std::runtime_error( "Cannot open pack file [" + path + "]" );
+    }
+}
+
+
+void PackWriter::Write( const void* data, const size_t size )
+{
+    if ( ( size > 0 ) && ( fwrite( data, 1, size, file ) != size ) )
+    {
+        throw std::runtime_error( "Failed to write pack file [" + path + "]" );
+    }
+    offset += size;
+}
+
+
+void PackWriter::Pad()
+{
+    static const uint8_t zeros[ PackAlignment ] = {};
+    const size_t padding = static_cast<size_t>( ( PackAlignment - ( offset % PackAlignment ) ) % PackAlignment );
+    Write( zeros, padding );
+}
+
+
+bool PackWriter::Contains( const std::string& name, const uint32_t type ) const
+{
+    return entryIxs.find( std::make_pair( type, name ) ) != entryIxs.end();
+}
+
+
+void PackWriter::Add( const std::string& name, const uint32_t type, const void* data, const size_t size )
+{
+    if ( name.empty() )
+    {
+        throw std::runtime_error( "Pack entry without a name in [" + path + "]" );
+    }
+
+    Pad();
+
+    packEntry_t entry;
+    memset( &entry, 0, sizeof( entry ) );
+    entry.offset = offset;
+    entry.size = size;
+    entry.type = type;
+    entry.checksum = Crc32c( data, size );
+    Write( data, size );
+
+    const auto existing = entryIxs.find( std::make_pair( type, name ) );
+    if ( existing != entryIxs.end() )
+    {
+        entries[ existing->second ] = entry;
+        return;
+    }
+    entryIxs[ std::make_pair( type, name ) ] = static_cast<uint32_t>( entries.size() );
+    entries.push_back( entry );
+    names.push_back( name );
+}
+
+
+void PackWriter::AddFile( const std::string& name, const uint32_t type, const std::string& srcPath )
+{
+    MappedFile src;
+    if ( !src.Open( srcPath ) )
+    {
+        throw std::runtime_error( "Cannot open [" + srcPath + "] for pack file [" + path + "]" );
+    }
+    Add( name, type, src.GetData(), static_cast<size_t>( src.GetSize() ) );
+}
+
+
+void PackWriter::Finish()
+{
+    const uint32_t entryCount = static_cast<uint32_t>( entries.size() );
+
+    // At most half full keeps probe runs short
+    uint32_t bucketCount = 16;
+    while ( bucketCount < ( 2 * entryCount ) )
+    {
+        bucketCount *= 2;
+    }
+
+    std::vector<packBucket_t> buckets( bucketCount );
+    memset( buckets.data(), 0, buckets.size() * sizeof( packBucket_t ) );
+    std::string packNames;
+    for ( uint32_t entryIx = 0; entryIx < entryCount; ++entryIx )
+    {
+        entries[ entryIx ].nameOffset = static_cast<uint32_t>( packNames.size() );
+        packNames.append( names[ entryIx ].c_str(), names[ entryIx ].size() + 1 );
+
+        const uint64_t hash = PackHash( names[ entryIx ].c_str(), entries[ entryIx ].type );
+        uint32_t bucketIx = static_cast<uint32_t>( hash ) & ( bucketCount - 1 );
+        while ( buckets[ bucketIx ].entryIx != 0 )
+        {
+            bucketIx = ( bucketIx + 1 ) & ( bucketCount - 1 );
+        }
+        buckets[ bucketIx ].hash = hash;
+        buckets[ bucketIx ].entryIx = entryIx + 1;
+    }
+
+    Pad();
+    packHeader_t header;
+    memset( &header, 0, sizeof( header ) );
+    header.magic = PackMagic;
+    header.version = PackVersion;
+    header.entryCount = entryCount;
+    header.bucketCount = bucketCount;
+    header.indexOffset = offset;
+    header.indexSize = entries.size() * sizeof( packEntry_t ) + buckets.size() * sizeof( packBucket_t ) + packNames.size();
+
+    uint32_t checksum = Crc32c( entries.data(), entries.size() * sizeof( packEntry_t ) );
+    checksum = Crc32c( buckets.data(), buckets.size() * sizeof( packBucket_t ), checksum );
+    header.indexChecksum = Crc32c( packNames.data(), packNames.size(), checksum );
+
+    Write( entries.data(), entries.size() * sizeof( packEntry_t ) );
+    Write( buckets.data(), buckets.size() * sizeof( packBucket_t ) );
+    Write( packNames.data(), packNames.size() );
+    header.fileSize = offset;
+
+    // Everything the new header points at is written before the header is
+    if ( ( fflush( file ) != 0 ) || ( fseek( file, 0, SEEK_SET ) != 0 ) || ( fwrite( &header, 1, sizeof( header ), file ) != sizeof( header ) ) )
+    {
+        throw std::runtime_error( "Failed to write pack file [" + path + "]" );
+    }
+
+    const bool closed = ( fclose( file ) == 0 );
+    file = nullptr;
+    if ( !closed )
+    {
+        if ( created )
+        {
+            remove( path.c_str() );
+        }
+        throw std::runtime_error( "Failed to write pack file [" + path + "]" );
+    }
+}
+
+
+PackFile::PackFile()
+{
+    Close();
+}
+
+
+void PackFile::Close()
+{
+    file.Close();
+    header = nullptr;
+    entries = nullptr;
+    buckets = nullptr;
+    names = nullptr;
+}
+
+
+bool PackFile::Open( const std::string& path, std::string* err )
+{
+    Close();
+    if ( !file.Open( path ) )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Cannot open pack file [" + path + "]";
+        }
+        return false;
+    }
+
+    const uint8_t* base = file.GetData();
+    const uint64_t fileSize = file.GetSize();
+    const packHeader_t* packHeader = reinterpret_cast<const packHeader_t*>( base );
+
+    std::string problem;
+    if ( fileSize < sizeof( packHeader_t ) )
+    {
+        problem = "file is too small";
+    }
+    else if ( packHeader->magic != PackMagic )
+    {
+        problem = "not a pack";
+    }
+    else if ( packHeader->version != PackVersion )
+    {
+        problem = "unsupported version " + std::to_string( packHeader->version );
+    }
+    else if ( packHeader->fileSize > fileSize )
+    {
+        problem = "truncated file";
+    }
+    else if ( ( packHeader->bucketCount == 0 ) || ( ( packHeader->bucketCount & ( packHeader->bucketCount - 1 ) ) != 0 ) ||
+              ( packHeader->bucketCount <= packHeader->entryCount ) || ( ( packHeader->indexOffset % PackAlignment ) != 0 ) ||
+              ( packHeader->indexOffset > packHeader->fileSize ) || ( packHeader->indexSize > ( packHeader->fileSize - packHeader->indexOffset ) ) ||
+              ( packHeader->indexSize < ( packHeader->entryCount * sizeof( packEntry_t ) + packHeader->bucketCount * sizeof( packBucket_t ) ) ) )
+    {
+        problem = "bad index";
+    }
+    else if ( Crc32c( base + packHeader->indexOffset, static_cast<size_t>( packHeader->indexSize ) ) != packHeader->indexChecksum )
+    {
+        problem = "index checksum mismatch";
+    }
+    else
+    {
+        const uint8_t* index = base + packHeader->indexOffset;
+        const packEntry_t* packEntries = reinterpret_cast<const packEntry_t*>( index );
+        const packBucket_t* packBuckets = reinterpret_cast<const packBucket_t*>( index + packHeader->entryCount * sizeof( packEntry_t ) );
+        const uint64_t namesOffset = packHeader->entryCount * sizeof( packEntry_t ) + packHeader->bucketCount * sizeof( packBucket_t );
+        const uint64_t namesSize = packHeader->indexSize - namesOffset;
+        // The name block is empty in a pack without entries; entries into an empty
+        // block fail their nameOffset check below
+        if ( ( namesSize > 0 ) && ( index[ packHeader->indexSize - 1 ] != '\0' ) )
+        {
+            problem = "bad names";
+        }
+        for ( uint32_t i = 0; problem.empty() && ( i < packHeader->entryCount ); ++i )
+        {
+            const packEntry_t& entry = packEntries[ i ];
+            if ( ( entry.offset > packHeader->fileSize ) || ( entry.size > ( packHeader->fileSize - entry.offset ) ) || ( entry.nameOffset >= namesSize ) )
+            {
+                problem = "bad entry " + std::to_string( i );
+            }
+        }
+        uint32_t emptyBuckets = 0;
+        for ( uint32_t i = 0; problem.empty() && ( i < packHeader->bucketCount ); ++i )
+        {
+            if ( packBuckets[ i ].entryIx > packHeader->entryCount )
+            {
+                problem = "bad bucket " + std::to_string( i );
+            }
+            emptyBuckets += ( packBuckets[ i ].entryIx == 0 ) ? 1 : 0;
+        }
+        if ( problem.empty() && ( emptyBuckets == 0 ) )
+        {
+            problem = "bad index";
+        }
+        if ( problem.empty() )
+        {
+            header = packHeader;
+            entries = packEntries;
+            buckets = packBuckets;
+            names = reinterpret_cast<const char*>( index + namesOffset );
+        }
+    }
+
+    if ( !problem.empty() )
+    {
+        if ( err != nullptr )
+        {
+            *err = "Bad pack file: " + problem;
+        }
+        Close();
+        return false;
+    }
+    return true;
+}
+
+
+const packEntry_t* PackFile::Find( const std::string& name, const uint32_t type ) const
+{
+    if ( header == nullptr )
+    {
+        return nullptr;
+    }
+
+    // Open() checked that some bucket is empty, so the probe ends
+    const uint64_t hash = PackHash( name.c_str(), type );
+    const uint32_t mask = header->bucketCount - 1;
+    for ( uint32_t bucketIx = static_cast<uint32_t>( hash ) & mask; buckets[ bucketIx ].entryIx != 0; bucketIx = ( bucketIx + 1 ) & mask )
+    {
+        const packBucket_t& bucket = buckets[ bucketIx ];
+        if ( bucket.hash != hash )
+        {
+            continue;
+        }
+        const packEntry_t& entry = entries[ bucket.entryIx - 1 ];
+        if ( ( entry.type == type ) && ( strcmp( names + entry.nameOffset, name.c_str() ) == 0 ) )
+        {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+
+bool PackFile::Verify( const packEntry_t& entry ) const
+{
+    return Crc32c( GetData( entry ), static_cast<size_t>( entry.size ) ) == entry.checksum;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "mappedFile.h"
+
+// Archive of many converted models and their textures in one file.
+//
+// Entries are stored back to back, each on a PackAlignment boundary, so mapped
+// models keep their section alignment. An index follows them: the entry table, a
+// hash table of name hashes, then the names. The header points at the current
+// index. Appending writes new entries and a new index past the end of the file
+// and repoints the header last, so existing entries are never rewritten and an
+// interrupted append leaves the previous pack readable.
+
+static const uint32_t PackMagic = 0x4B41504D;   // "MPAK"
+static const uint32_t PackVersion = 1;
+static const uint32_t PackAlignment = 64;
+
+enum packEntryType_t : uint32_t
+{
+    PACK_ENTRY_MODEL    = 1,    // Mapped .mdl
+    PACK_ENTRY_TEXTURE  = 2,    // Image file as it was on disk
+};
+
+struct packHeader_t
+{
+    uint32_t    magic;
+    uint32_t    version;
+    uint32_t    entryCount;
+    uint32_t    bucketCount;        // Power of two, more than entryCount
+    uint64_t    indexOffset;        // packEntry_t[ entryCount ], packBucket_t[ bucketCount ], then names
+    uint64_t    indexSize;
+    uint64_t    fileSize;           // Anything past this is left from an interrupted append
+    uint32_t    indexChecksum;      // CRC32C of the index
+    uint32_t    reserved[ 5 ];
+};
+
+struct packEntry_t
+{
+    uint64_t    offset;
+    uint64_t    size;
+    uint32_t    type;               // packEntryType_t
+    uint32_t    nameOffset;         // Into the names, null terminated
+    uint32_t    checksum;           // CRC32C of the data
+    uint32_t    reserved;
+};
+
+// Open addressing with linear probing. entryIx is 1-based so zero is empty.
+struct packBucket_t
+{
+    uint64_t    hash;
+    uint32_t    entryIx;
+    uint32_t    reserved;
+};
+
+static_assert( sizeof( packHeader_t ) == 64, "packHeader_t is part of the file format" );
+static_assert( sizeof( packEntry_t ) == 32, "packEntry_t is part of the file format" );
+static_assert( sizeof( packBucket_t ) == 16, "packBucket_t is part of the file format" );
+
+uint64_t    PackHash( const char* name, const uint32_t type );
+
+
+// Adds entries to a new or existing pack. Adding a name and type that is already
+// there repoints the index at the new data; the old data stays as dead space.
+class PackWriter
+{
+public:
+    PackWriter();
+    ~PackWriter();
+
+    PackWriter( const PackWriter& ) = delete;
+    PackWriter& operator=( const PackWriter& ) = delete;
+
+    void                Open( const std::string& path );
+    bool                IsOpen() const { return file != nullptr; }
+    bool                Contains( const std::string& name, const uint32_t type ) const;
+    void                Add( const std::string& name, const uint32_t type, const void* data, const size_t size );
+    void                AddFile( const std::string& name, const uint32_t type, const std::string& srcPath );
+    void                Finish();
+
+private:
+    void                Write( const void* data, const size_t size );
+    void                Pad();
+
+    FILE*                       file;
+    std::string                 path;
+    bool                        created;
+    uint64_t                    offset;
+    std::vector<packEntry_t>    entries;
+    std::vector<std::string>    names;
+    std::map<std::pair<uint32_t, std::string>, uint32_t>    entryIxs;
+};
+
+
+// Read-only view of a mapped pack
+class PackFile
+{
+public:
+    PackFile();
+
+    bool                Open( const std::string& path, std::string* err );
+    void                Close();
+
+    // Hashes the name once and probes from its bucket
+    const packEntry_t*  Find( const std::string& name, const uint32_t type ) const;
+    const uint8_t*      GetData( const packEntry_t& entry ) const { return file.GetData() + entry.offset; }
+    const char*         GetName( const packEntry_t& entry ) const { return names + entry.nameOffset; }
+    bool                Verify( const packEntry_t& entry ) const;
+
+    const packHeader_t* GetHeader() const { return header; }
+    const packEntry_t*  GetEntries() const { return entries; }
+    uint32_t            GetEntryCount() const { return ( header != nullptr ) ? header->entryCount : 0; }
+
+private:
+    MappedFile          file;
+    const packHeader_t* header;
+    const packEntry_t*  entries;
+    const packBucket_t* buckets;
+    const char*         names;
+};
@@ -0,0 +1,51 @@
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "parallel.h"
+
+uint32_t ResolveThreadCount( const uint32_t requested )
+{
+    if ( requested > 0 )
+    {
+        return requested;
+    }
+    const uint32_t hwThreads = std::thread::hardware_concurrency();
+    return ( hwThreads > 0 ) ? hwThreads : 1;
+}
+
+
+void ParallelFor( const uint32_t count, const uint32_t threadCount, const std::function<void( uint32_t )>& task )
+{
+    const uint32_t workerCount = std::min( ResolveThreadCount( threadCount ), count );
+    if ( workerCount <= 1 )
+    {
+        for ( uint32_t i = 0; i < count; ++i )
+        {
+            task( i );
+        }
+        return;
+    }
+
+    std::atomic<uint32_t> next( 0 );
+    auto worker = [&]()
+    {
+        for ( uint32_t i = next++; i < count; i = next++ )
+        {
+            task( i );
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve( workerCount - 1 );
+    for ( uint32_t i = 1; i < workerCount; ++i )
+    {
+        threads.emplace_back( worker );
+    }
+    worker();
+
+    for ( std::thread& thread : threads )
+    {
+        thread.join();
+    }
+}
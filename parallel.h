@@ -0,0 +1,10 @@
+#pragma once
+
+#include <functional>
+#include <stdint.h>
+
+uint32_t    ResolveThreadCount( const uint32_t requested );
+
+// Runs task( i ) for every i in [0, count) across up to threadCount workers.
+// Items are handed out dynamically so uneven work still balances.
+void        ParallelFor( const uint32_t count, const uint32_t threadCount, const std::function<void( uint32_t )>& task );
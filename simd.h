@@ -0,0 +1,20 @@
+#pragma once
+
+// SSE2 is part of the x64 baseline. 32-bit builds only get it with /arch:SSE2 or higher.
+#if defined( _M_X64 ) || ( defined( _M_IX86_FP ) && ( _M_IX86_FP >= 2 ) ) || defined( __SSE2__ )
+#define CONVERTER_SSE2
+#include <emmintrin.h>
+#endif
+
+// SSE4.2 is not baseline anywhere. Functions using it are compiled with
+// CONVERTER_TARGET_SSE42 and only called after a CPUID check.
+#if defined( _M_X64 ) || defined( __x86_64__ )
+#define CONVERTER_SSE42
+#include <nmmintrin.h>
+#if defined( _MSC_VER )
+#include <intrin.h>
+#define CONVERTER_TARGET_SSE42
+#else
+#define CONVERTER_TARGET_SSE42 __attribute__( ( target( "sse4.2" ) ) )
+#endif
+#endif
@@ -0,0 +1,233 @@
+#include <string.h>
+#include <stdexcept>
+#include <algorithm>
+#include "spillFile.h"
+
+SpillFile::SpillFile()
+{
+    file = nullptr;
+    size = 0;
+}
+
+
+SpillFile::~SpillFile()
+{
+    Remove();
+}
+
+
+void SpillFile::Create( const std::string& path, const size_t bufferSize )
+{
+    Remove();
+
+#if defined( _WIN32 )
+    if ( fopen_s( &file, path.c_str(), "wb+" ) != 0 )
+    {
+        file = nullptr;
+    }
+#else
+    file = fopen( path.c_str(), "wb+" );
+#endif
+    if ( file == nullptr )
+    {
+        throw std::runtime_error( "Cannot create spill file [" + path + "]" );
+    }
+    setvbuf( file, nullptr, _IOFBF, bufferSize );
+
+    this->path = path;
+    size = 0;
+}
+
+
+void SpillFile::Write( const void* data, const size_t size )
+{
+    if ( fwrite( data, 1, size, file ) != size )
+    {
+        throw std::runtime_error( "Failed to write spill file [" + path + "]" );
+    }
+    this->size += size;
+}
+
+
+bool SpillFile::Read( void* data, const size_t size )
+{
+    return ( fread( data, 1, size, file ) == size );
+}
+
+
+bool SpillFile::ReadAt( const uint64_t offset, void* data, const size_t size )
+{
+#if defined( _WIN32 )
+    if ( _fseeki64( file, static_cast<int64_t>( offset ), SEEK_SET ) != 0 )
+#else
+    if ( fseeko( file, static_cast<off_t>( offset ), SEEK_SET ) != 0 )
+#endif
+    {
+        return false;
+    }
+    return ( fread( data, 1, size, file ) == size );
+}
+
+
+void SpillFile::Rewind()
+{
+    if ( fseek( file, 0, SEEK_SET ) != 0 )
+    {
+        throw std::runtime_error( "Failed to rewind spill file [" + path + "]" );
+    }
+}
+
+
+void SpillFile::Close()
+{
+    // Closing keeps the file on disk so it can be mapped
+    if ( file != nullptr )
+    {
+        if ( fclose( file ) != 0 )
+        {
+            file = nullptr;
+            throw std::runtime_error( "Failed to flush spill file [" + path + "]" );
+        }
+        file = nullptr;
+    }
+}
+
+
+void SpillFile::Remove()
+{
+    if ( file != nullptr )
+    {
+        fclose( file );
+        file = nullptr;
+    }
+    if ( path.size() > 0 )
+    {
+        remove( path.c_str() );
+        path.clear();
+    }
+    size = 0;
+}
+
+
+PartitionedSpillFile::PartitionedSpillFile()
+{
+    blockSize = 0;
+}
+
+
+void PartitionedSpillFile::Create( const std::string& path, const uint32_t partitionCount, const size_t blockSize )
+{
+    // Blocks are already buffered here, stdio only needs to batch the odd small read
+    file.Create( path, 4096 );
+    this->blockSize = blockSize;
+
+    partitions.clear();
+    partitions.resize( partitionCount );
+    for ( partition_t& partition : partitions )
+    {
+        partition.used = 0;
+        partition.filled = 0;
+        partition.nextBlock = 0;
+        partition.size = 0;
+    }
+}
+
+
+void PartitionedSpillFile::WriteBlock( partition_t& partition )
+{
+    block_t block;
+    block.offset = file.GetSize();
+    block.size = partition.used;
+    file.Write( partition.buffer.data(), partition.used );
+    partition.blocks.push_back( block );
+    partition.used = 0;
+}
+
+
+void PartitionedSpillFile::Write( const uint32_t partitionIx, const void* data, const size_t size )
+{
+    partition_t& partition = partitions[ partitionIx ];
+    partition.buffer.resize( blockSize );
+    partition.size += size;
+
+    const uint8_t* bytes = static_cast<const uint8_t*>( data );
+    size_t remaining = size;
+    while ( remaining > 0 )
+    {
+        const size_t count = std::min( remaining, blockSize - partition.used );
+        memcpy( partition.buffer.data() + partition.used, bytes, count );
+        partition.used += count;
+        bytes += count;
+        remaining -= count;
+
+        if ( partition.used == blockSize )
+        {
+            WriteBlock( partition );
+        }
+    }
+}
+
+
+void PartitionedSpillFile::Flush()
+{
+    for ( partition_t& partition : partitions )
+    {
+        if ( partition.used > 0 )
+        {
+            WriteBlock( partition );
+        }
+        std::vector<uint8_t>().swap( partition.buffer );
+    }
+}
+
+
+bool PartitionedSpillFile::Read( const uint32_t partitionIx, void* data, const size_t size )
+{
+    partition_t& partition = partitions[ partitionIx ];
+
+    uint8_t* bytes = static_cast<uint8_t*>( data );
+    size_t remaining = size;
+    while ( remaining > 0 )
+    {
+        if ( partition.used == partition.filled )
+        {
+            if ( partition.nextBlock == partition.blocks.size() )
+            {
+                return false;
+            }
+            const block_t& block = partition.blocks[ partition.nextBlock++ ];
+            partition.buffer.resize( blockSize );
+            if ( !file.ReadAt( block.offset, partition.buffer.data(), static_cast<size_t>( block.size ) ) )
+            {
+                return false;
+            }
+            partition.used = 0;
+            partition.filled = static_cast<size_t>( block.size );
+        }
+
+        const size_t count = std::min( remaining, partition.filled - partition.used );
+        memcpy( bytes, partition.buffer.data() + partition.used, count );
+        partition.used += count;
+        bytes += count;
+        remaining -= count;
+    }
+    return true;
+}
+
+
+void PartitionedSpillFile::Release( const uint32_t partitionIx )
+{
+    partition_t& partition = partitions[ partitionIx ];
+    std::vector<uint8_t>().swap( partition.buffer );
+    std::vector<block_t>().swap( partition.blocks );
+    partition.used = 0;
+    partition.filled = 0;
+    partition.nextBlock = 0;
+}
+
+
+void PartitionedSpillFile::Remove()
+{
+    file.Remove();
+    partitions.clear();
+}
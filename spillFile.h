@@ -0,0 +1,82 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Scratch file for out-of-core passes. Written sequentially, then either read
+// back sequentially or closed and mapped. The file is deleted with the object.
+class SpillFile
+{
+public:
+    SpillFile();
+    ~SpillFile();
+
+    SpillFile( const SpillFile& ) = delete;
+    SpillFile& operator=( const SpillFile& ) = delete;
+
+    void                Create( const std::string& path, const size_t bufferSize );
+    void                Write( const void* data, const size_t size );
+    bool                Read( void* data, const size_t size );
+    bool                ReadAt( const uint64_t offset, void* data, const size_t size );
+    void                Rewind();
+    void                Close();
+    void                Remove();
+
+    const std::string&  GetPath() const { return path; }
+    uint64_t            GetSize() const { return size; }
+
+private:
+    FILE*               file;
+    std::string         path;
+    uint64_t            size;
+};
+
+
+// Many sequential streams in one scratch file, so the stream count is not bounded
+// by open file handles. Each partition is buffered in memory and appended to the
+// file a block at a time. All writes come before Flush(), all reads after it;
+// reads walk a partition's blocks in order through a buffer of the same size.
+class PartitionedSpillFile
+{
+public:
+    PartitionedSpillFile();
+
+    PartitionedSpillFile( const PartitionedSpillFile& ) = delete;
+    PartitionedSpillFile& operator=( const PartitionedSpillFile& ) = delete;
+
+    void                Create( const std::string& path, const uint32_t partitionCount, const size_t blockSize );
+    void                Write( const uint32_t partition, const void* data, const size_t size );
+    void                Flush();
+    bool                Read( const uint32_t partition, void* data, const size_t size );
+    // Frees a partition's buffer once it has been read to the end
+    void                Release( const uint32_t partition );
+    void                Remove();
+
+    const std::string&  GetPath() const { return file.GetPath(); }
+    uint64_t            GetSize( const uint32_t partition ) const { return partitions[ partition ].size; }
+
+private:
+    struct block_t
+    {
+        uint64_t                offset;
+        uint64_t                size;
+    };
+
+    struct partition_t
+    {
+        std::vector<uint8_t>    buffer;
+        size_t                  used;           // Bytes buffered for writing, or consumed for reading
+        size_t                  filled;         // Bytes of the current block loaded for reading
+        std::vector<block_t>    blocks;
+        size_t                  nextBlock;
+        uint64_t                size;
+    };
+
+    void                WriteBlock( partition_t& partition );
+
+    SpillFile                   file;
+    std::vector<partition_t>    partitions;
+    size_t                      blockSize;
+};
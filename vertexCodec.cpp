@@ -0,0 +1,272 @@
+#include <string.h>
+#include <algorithm>
+#include "vertexCodec.h"
+#include "simd.h"
+
+static const uint32_t GroupSize = 16;
+static const uint32_t GroupsPerBlock = VertexBlockSize / GroupSize;
+
+// Packed bytes per group for each 2-bit mode
+static const uint32_t GroupBytes[ 4 ] = { 0, 4, 8, 16 };
+
+static_assert( ( VertexBlockSize % GroupSize ) == 0, "Blocks must hold whole groups" );
+
+
+static inline uint8_t ZigZag8( const uint8_t delta )
+{
+    return static_cast<uint8_t>( ( delta << 1 ) ^ static_cast<uint8_t>( static_cast<int8_t>( delta ) >> 7 ) );
+}
+
+
+static inline uint8_t UnZigZag8( const uint8_t value )
+{
+    return static_cast<uint8_t>( ( value >> 1 ) ^ static_cast<uint8_t>( 0u - ( value & 1 ) ) );
+}
+
+
+static void EncodeGroup( const uint8_t* values, std::vector<uint8_t>& out, uint8_t& header, const uint32_t groupIx )
+{
+    uint8_t maxValue = 0;
+    for ( uint32_t i = 0; i < GroupSize; ++i )
+    {
+        maxValue = std::max( maxValue, values[ i ] );
+    }
+
+    const uint32_t mode = ( maxValue == 0 ) ? 0 : ( ( maxValue < 4 ) ? 1 : ( ( maxValue < 16 ) ? 2 : 3 ) );
+    header |= static_cast<uint8_t>( mode << ( ( groupIx % 4 ) * 2 ) );
+
+    if ( mode == 1 )
+    {
+        for ( uint32_t j = 0; j < 4; ++j )
+        {
+            out.push_back( static_cast<uint8_t>( ( values[ 4 * j ] << 6 ) | ( values[ 4 * j + 1 ] << 4 ) | ( values[ 4 * j + 2 ] << 2 ) | values[ 4 * j + 3 ] ) );
+        }
+    }
+    else if ( mode == 2 )
+    {
+        for ( uint32_t j = 0; j < 8; ++j )
+        {
+            out.push_back( static_cast<uint8_t>( ( values[ 2 * j ] << 4 ) | values[ 2 * j + 1 ] ) );
+        }
+    }
+    else if ( mode == 3 )
+    {
+        out.insert( out.end(), values, values + GroupSize );
+    }
+}
+
+
+void EncodeVertexBuffer( const void* vertices, const size_t vertexCount, const size_t stride, std::vector<uint8_t>& out )
+{
+    const uint8_t* src = static_cast<const uint8_t*>( vertices );
+    std::vector<uint8_t> last( stride, 0 );
+    uint8_t deltas[ VertexBlockSize ];
+
+    for ( size_t blockStart = 0; blockStart < vertexCount; blockStart += VertexBlockSize )
+    {
+        const size_t blockCount = std::min<size_t>( VertexBlockSize, vertexCount - blockStart );
+        const uint32_t groupCount = static_cast<uint32_t>( ( blockCount + GroupSize - 1 ) / GroupSize );
+
+        for ( size_t byteIx = 0; byteIx < stride; ++byteIx )
+        {
+            // The tail of a partial group codes as zero deltas
+            uint8_t previous = last[ byteIx ];
+            for ( size_t i = 0; i < groupCount * GroupSize; ++i )
+            {
+                if ( i < blockCount )
+                {
+                    const uint8_t value = src[ ( blockStart + i ) * stride + byteIx ];
+                    deltas[ i ] = ZigZag8( static_cast<uint8_t>( value - previous ) );
+                    previous = value;
+                }
+                else
+                {
+                    deltas[ i ] = 0;
+                }
+            }
+            last[ byteIx ] = previous;
+
+            const size_t headerPos = out.size();
+            out.resize( out.size() + ( groupCount + 3 ) / 4, 0 );
+            for ( uint32_t groupIx = 0; groupIx < groupCount; ++groupIx )
+            {
+                uint8_t header = out[ headerPos + groupIx / 4 ];
+                EncodeGroup( deltas + groupIx * GroupSize, out, header, groupIx );
+                out[ headerPos + groupIx / 4 ] = header;
+            }
+        }
+    }
+}
+
+
+#if defined( CONVERTER_SSE2 )
+static inline __m128i UnpackGroup( const uint8_t* data, const uint32_t mode )
+{
+    const __m128i lowNibbles = _mm_set1_epi8( 0x0F );
+    switch ( mode )
+    {
+        case 1:
+        {
+            int32_t bits;
+            memcpy( &bits, data, sizeof( bits ) );
+            const __m128i packed = _mm_cvtsi32_si128( bits );
+            // 2-bit pairs to nibbles, then nibbles to bytes
+            const __m128i nibbles = _mm_unpacklo_epi8( _mm_and_si128( _mm_srli_epi16( packed, 4 ), lowNibbles ), _mm_and_si128( packed, lowNibbles ) );
+            const __m128i lowPairs = _mm_set1_epi8( 0x03 );
+            return _mm_unpacklo_epi8( _mm_and_si128( _mm_srli_epi16( nibbles, 2 ), lowPairs ), _mm_and_si128( nibbles, lowPairs ) );
+        }
+        case 2:
+        {
+            const __m128i packed = _mm_loadl_epi64( reinterpret_cast<const __m128i*>( data ) );
+            return _mm_unpacklo_epi8( _mm_and_si128( _mm_srli_epi16( packed, 4 ), lowNibbles ), _mm_and_si128( packed, lowNibbles ) );
+        }
+        case 3:
+            return _mm_loadu_si128( reinterpret_cast<const __m128i*>( data ) );
+        default:
+            return _mm_setzero_si128();
+    }
+}
+
+
+// Undoes the zigzag and delta coding for 16 bytes, carrying the running value
+static inline void DecodeGroup( const uint8_t* data, const uint32_t mode, uint8_t& previous, uint8_t* plane )
+{
+    __m128i values = UnpackGroup( data, mode );
+    values = _mm_xor_si128( _mm_and_si128( _mm_srli_epi16( values, 1 ), _mm_set1_epi8( 0x7F ) ), _mm_sub_epi8( _mm_setzero_si128(), _mm_and_si128( values, _mm_set1_epi8( 1 ) ) ) );
+
+    // Log-step prefix sum
+    values = _mm_add_epi8( values, _mm_slli_si128( values, 1 ) );
+    values = _mm_add_epi8( values, _mm_slli_si128( values, 2 ) );
+    values = _mm_add_epi8( values, _mm_slli_si128( values, 4 ) );
+    values = _mm_add_epi8( values, _mm_slli_si128( values, 8 ) );
+    values = _mm_add_epi8( values, _mm_set1_epi8( static_cast<char>( previous ) ) );
+
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( plane ), values );
+    previous = plane[ GroupSize - 1 ];
+}
+
+
+// Interleaves four planes back into 4-byte columns of 16 vertices
+static inline void TransposeGroup4( const uint8_t* planes, const size_t planeStride, uint8_t* dst, const size_t stride, const size_t count )
+{
+    const __m128i p0 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( planes ) );
+    const __m128i p1 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( planes + planeStride ) );
+    const __m128i p2 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( planes + 2 * planeStride ) );
+    const __m128i p3 = _mm_loadu_si128( reinterpret_cast<const __m128i*>( planes + 3 * planeStride ) );
+
+    const __m128i t0 = _mm_unpacklo_epi8( p0, p1 );
+    const __m128i t1 = _mm_unpackhi_epi8( p0, p1 );
+    const __m128i t2 = _mm_unpacklo_epi8( p2, p3 );
+    const __m128i t3 = _mm_unpackhi_epi8( p2, p3 );
+
+    uint32_t columns[ GroupSize ];
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( columns + 0 ), _mm_unpacklo_epi16( t0, t2 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( columns + 4 ), _mm_unpackhi_epi16( t0, t2 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( columns + 8 ), _mm_unpacklo_epi16( t1, t3 ) );
+    _mm_storeu_si128( reinterpret_cast<__m128i*>( columns + 12 ), _mm_unpackhi_epi16( t1, t3 ) );
+
+    for ( size_t i = 0; i < count; ++i )
+    {
+        memcpy( dst + i * stride, &columns[ i ], sizeof( uint32_t ) );
+    }
+}
+#else
+static inline void DecodeGroup( const uint8_t* data, const uint32_t mode, uint8_t& previous, uint8_t* plane )
+{
+    uint8_t values[ GroupSize ];
+    if ( mode == 0 )
+    {
+        memset( values, 0, sizeof( values ) );
+    }
+    else if ( mode == 1 )
+    {
+        for ( uint32_t i = 0; i < GroupSize; ++i )
+        {
+            values[ i ] = ( data[ i / 4 ] >> ( 6 - 2 * ( i % 4 ) ) ) & 0x03;
+        }
+    }
+    else if ( mode == 2 )
+    {
+        for ( uint32_t i = 0; i < GroupSize; ++i )
+        {
+            values[ i ] = ( data[ i / 2 ] >> ( 4 - 4 * ( i % 2 ) ) ) & 0x0F;
+        }
+    }
+    else
+    {
+        memcpy( values, data, GroupSize );
+    }
+
+    for ( uint32_t i = 0; i < GroupSize; ++i )
+    {
+        previous = static_cast<uint8_t>( previous + UnZigZag8( values[ i ] ) );
+        plane[ i ] = previous;
+    }
+}
+#endif
+
+
+bool DecodeVertexBuffer( const uint8_t* data, const size_t size, void* vertices, const size_t vertexCount, const size_t stride )
+{
+    uint8_t* dst = static_cast<uint8_t*>( vertices );
+    const uint8_t* end = data + size;
+
+    std::vector<uint8_t> last( stride, 0 );
+    std::vector<uint8_t> planes( stride * VertexBlockSize );
+
+    for ( size_t blockStart = 0; blockStart < vertexCount; blockStart += VertexBlockSize )
+    {
+        const size_t blockCount = std::min<size_t>( VertexBlockSize, vertexCount - blockStart );
+        const uint32_t groupCount = static_cast<uint32_t>( ( blockCount + GroupSize - 1 ) / GroupSize );
+        const uint32_t headerBytes = ( groupCount + 3 ) / 4;
+
+        for ( size_t byteIx = 0; byteIx < stride; ++byteIx )
+        {
+            if ( static_cast<size_t>( end - data ) < headerBytes )
+            {
+                return false;
+            }
+            const uint8_t* header = data;
+            data += headerBytes;
+
+            uint8_t previous = last[ byteIx ];
+            uint8_t* plane = planes.data() + byteIx * VertexBlockSize;
+            for ( uint32_t groupIx = 0; groupIx < groupCount; ++groupIx )
+            {
+                const uint32_t mode = ( header[ groupIx / 4 ] >> ( ( groupIx % 4 ) * 2 ) ) & 3;
+                if ( static_cast<size_t>( end - data ) < GroupBytes[ mode ] )
+                {
+                    return false;
+                }
+                DecodeGroup( data, mode, previous, plane + groupIx * GroupSize );
+                data += GroupBytes[ mode ];
+            }
+
+            // Padding deltas are zero, so the value carried over is the last real one
+            last[ byteIx ] = previous;
+        }
+
+        uint8_t* blockDst = dst + blockStart * stride;
+        size_t byteIx = 0;
+#if defined( CONVERTER_SSE2 )
+        for ( ; ( byteIx + 4 ) <= stride; byteIx += 4 )
+        {
+            for ( uint32_t groupIx = 0; groupIx < groupCount; ++groupIx )
+            {
+                const size_t first = groupIx * GroupSize;
+                TransposeGroup4( planes.data() + byteIx * VertexBlockSize + first, VertexBlockSize, blockDst + first * stride + byteIx, stride, std::min<size_t>( GroupSize, blockCount - first ) );
+            }
+        }
+#endif
+        for ( ; byteIx < stride; ++byteIx )
+        {
+            const uint8_t* plane = planes.data() + byteIx * VertexBlockSize;
+            for ( size_t i = 0; i < blockCount; ++i )
+            {
+                blockDst[ i * stride + byteIx ] = plane[ i ];
+            }
+        }
+    }
+
+    return ( data == end );
+}
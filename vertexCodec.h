@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+// Lossless vertex stream codec for any fixed-stride vertex layout.
+//
+// Vertices are processed in blocks of VertexBlockSize. Within a block each byte
+// of the vertex is transposed into its own plane and delta coded against the
+// same byte of the previous vertex. Planes are split into groups of 16 deltas,
+// each zigzagged and bit-packed at 0, 2, 4 or 8 bits, with a 2-bit mode per
+// group up front. Decoding is SSE2 where available.
+
+static const uint32_t VertexBlockSize = 256;
+
+// Appends the encoded stream to out
+void    EncodeVertexBuffer( const void* vertices, const size_t vertexCount, const size_t stride, std::vector<uint8_t>& out );
+
+// Returns false if the stream is malformed or is not exactly vertexCount vertices
+bool    DecodeVertexBuffer( const uint8_t* data, const size_t size, void* vertices, const size_t vertexCount, const size_t stride );
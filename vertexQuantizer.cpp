@@ -0,0 +1,247 @@
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include "vertexQuantizer.h"
+
+static uint16_t QuantizeUnorm16( const float value )
+{
+    const float clamped = std::min( std::max( value, 0.0f ), 1.0f );
+    return static_cast<uint16_t>( clamped * 65535.0f + 0.5f );
+}
+
+
+static int16_t QuantizeSnorm16( const float value )
+{
+    const float clamped = std::min( std::max( value, -1.0f ), 1.0f );
+    return static_cast<int16_t>( lrintf( clamped * 32767.0f ) );
+}
+
+
+static float SignNotZero( const float value )
+{
+    return ( value >= 0.0f ) ? 1.0f : -1.0f;
+}
+
+
+static void EncodeOctahedral( const vec3f& normal, int16_t* encoded )
+{
+    const float l1 = fabsf( normal[ 0 ] ) + fabsf( normal[ 1 ] ) + fabsf( normal[ 2 ] );
+    if ( l1 == 0.0f )
+    {
+        // Degenerate normals decode to +z
+        encoded[ 0 ] = 0;
+        encoded[ 1 ] = 0;
+        return;
+    }
+
+    float x = normal[ 0 ] / l1;
+    float y = normal[ 1 ] / l1;
+    if ( normal[ 2 ] < 0.0f )
+    {
+        // Fold the lower hemisphere over the diagonals
+        const float foldedX = ( 1.0f - fabsf( y ) ) * SignNotZero( x );
+        const float foldedY = ( 1.0f - fabsf( x ) ) * SignNotZero( y );
+        x = foldedX;
+        y = foldedY;
+    }
+    encoded[ 0 ] = QuantizeSnorm16( x );
+    encoded[ 1 ] = QuantizeSnorm16( y );
+}
+
+
+static vec3f DecodeOctahedral( const int16_t* encoded )
+{
+    float x = std::max( encoded[ 0 ] * ( 1.0f / 32767.0f ), -1.0f );
+    float y = std::max( encoded[ 1 ] * ( 1.0f / 32767.0f ), -1.0f );
+    const float z = 1.0f - fabsf( x ) - fabsf( y );
+    const float t = std::max( -z, 0.0f );
+    x += ( x >= 0.0f ) ? -t : t;
+    y += ( y >= 0.0f ) ? -t : t;
+
+    const float invLength = 1.0f / sqrtf( x * x + y * y + z * z );
+    return vec3f( x * invLength, y * invLength, z * invLength );
+}
+
+
+uint16_t FloatToHalf( const float value )
+{
+    uint32_t bits;
+    memcpy( &bits, &value, sizeof( bits ) );
+
+    const uint32_t sign = ( bits >> 16 ) & 0x8000;
+    const uint32_t exponent = ( bits >> 23 ) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    if ( exponent == 0xFF )
+    {
+        // Inf stays inf, NaN stays NaN
+        return static_cast<uint16_t>( sign | 0x7C00 | ( ( mantissa != 0 ) ? 0x200 : 0 ) );
+    }
+
+    const int32_t halfExponent = static_cast<int32_t>( exponent ) - 127 + 15;
+    if ( halfExponent >= 31 )
+    {
+        return static_cast<uint16_t>( sign | 0x7C00 );
+    }
+
+    if ( halfExponent <= 0 )
+    {
+        if ( halfExponent < -10 )
+        {
+            return static_cast<uint16_t>( sign );
+        }
+        // Subnormal: shift the implicit bit in, round to nearest even
+        mantissa |= 0x800000;
+        const uint32_t shift = static_cast<uint32_t>( 14 - halfExponent );
+        const uint32_t halfMantissa = mantissa >> shift;
+        const uint32_t remainder = mantissa & ( ( 1u << shift ) - 1 );
+        const uint32_t halfway = 1u << ( shift - 1 );
+        const uint32_t rounded = halfMantissa + ( ( ( remainder > halfway ) || ( ( remainder == halfway ) && ( halfMantissa & 1 ) ) ) ? 1 : 0 );
+        return static_cast<uint16_t>( sign | rounded );
+    }
+
+    // Rounding may carry into the exponent, which is still correct, up to inf
+    const uint32_t half = ( static_cast<uint32_t>( halfExponent ) << 10 ) | ( mantissa >> 13 );
+    const uint32_t remainder = mantissa & 0x1FFF;
+    const uint32_t rounded = half + ( ( ( remainder > 0x1000 ) || ( ( remainder == 0x1000 ) && ( half & 1 ) ) ) ? 1 : 0 );
+    return static_cast<uint16_t>( sign | rounded );
+}
+
+
+float HalfToFloat( const uint16_t value )
+{
+    const uint32_t sign = static_cast<uint32_t>( value & 0x8000 ) << 16;
+    const uint32_t exponent = ( value >> 10 ) & 0x1F;
+    const uint32_t mantissa = value & 0x3FF;
+
+    uint32_t bits;
+    if ( exponent == 0x1F )
+    {
+        bits = sign | 0x7F800000 | ( mantissa << 13 );
+    }
+    else if ( exponent != 0 )
+    {
+        bits = sign | ( ( exponent + 127 - 15 ) << 23 ) | ( mantissa << 13 );
+    }
+    else if ( mantissa != 0 )
+    {
+        // Subnormal half, normal float
+        uint32_t shifted = mantissa;
+        uint32_t floatExponent = 127 - 15 + 1;
+        while ( ( shifted & 0x400 ) == 0 )
+        {
+            shifted <<= 1;
+            --floatExponent;
+        }
+        bits = sign | ( floatExponent << 23 ) | ( ( shifted & 0x3FF ) << 13 );
+    }
+    else
+    {
+        bits = sign;
+    }
+
+    float result;
+    memcpy( &result, &bits, sizeof( result ) );
+    return result;
+}
+
+
+bool QuantizeVertices( const vertex_t* vertices, const size_t vertexCount, mdlVertexQuantization_t& quantization, std::vector<mdlPackedVertex_t>& packed )
+{
+    memset( &quantization, 0, sizeof( quantization ) );
+    packed.clear();
+
+    if ( vertexCount == 0 )
+    {
+        return true;
+    }
+
+    float posMin[ 3 ] = { vertices[ 0 ].pos[ 0 ], vertices[ 0 ].pos[ 1 ], vertices[ 0 ].pos[ 2 ] };
+    float posMax[ 3 ] = { posMin[ 0 ], posMin[ 1 ], posMin[ 2 ] };
+    bool uvInUnitRange = true;
+
+    const float posW = vertices[ 0 ].pos[ 3 ];
+    const Color color = vertices[ 0 ].color;
+
+    for ( size_t i = 0; i < vertexCount; ++i )
+    {
+        const vertex_t& vert = vertices[ i ];
+        if ( ( vert.pos[ 3 ] != posW ) || !( vert.color == color ) )
+        {
+            return false;
+        }
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            posMin[ axis ] = std::min( posMin[ axis ], vert.pos[ axis ] );
+            posMax[ axis ] = std::max( posMax[ axis ], vert.pos[ axis ] );
+        }
+        uvInUnitRange = uvInUnitRange && ( vert.uv[ 0 ] >= 0.0f ) && ( vert.uv[ 0 ] <= 1.0f ) && ( vert.uv[ 1 ] >= 0.0f ) && ( vert.uv[ 1 ] <= 1.0f );
+    }
+
+    float posScale[ 3 ];
+    for ( uint32_t axis = 0; axis < 3; ++axis )
+    {
+        quantization.posMin[ axis ] = posMin[ axis ];
+        quantization.posExtent[ axis ] = posMax[ axis ] - posMin[ axis ];
+        posScale[ axis ] = ( quantization.posExtent[ axis ] > 0.0f ) ? ( 1.0f / quantization.posExtent[ axis ] ) : 0.0f;
+    }
+    quantization.posW = posW;
+    quantization.color[ 0 ] = color.r;
+    quantization.color[ 1 ] = color.g;
+    quantization.color[ 2 ] = color.b;
+    quantization.color[ 3 ] = color.a;
+    quantization.uvEncoding = uvInUnitRange ? MDL_UV_UNORM16 : MDL_UV_HALF;
+
+    packed.resize( vertexCount );
+    for ( size_t i = 0; i < vertexCount; ++i )
+    {
+        const vertex_t& vert = vertices[ i ];
+        mdlPackedVertex_t& out = packed[ i ];
+
+        for ( uint32_t axis = 0; axis < 3; ++axis )
+        {
+            out.pos[ axis ] = QuantizeUnorm16( ( vert.pos[ axis ] - posMin[ axis ] ) * posScale[ axis ] );
+        }
+        EncodeOctahedral( vert.normal, out.normal );
+        for ( uint32_t axis = 0; axis < 2; ++axis )
+        {
+            out.uv[ axis ] = uvInUnitRange ? QuantizeUnorm16( vert.uv[ axis ] ) : FloatToHalf( vert.uv[ axis ] );
+        }
+        out.reserved = 0;
+    }
+    return true;
+}
+
+
+void DequantizeVertices( const mdlVertexQuantization_t& quantization, const mdlPackedVertex_t* packed, const size_t vertexCount, vertex_t* vertices )
+{
+    const float posStep[ 3 ] =
+    {
+        quantization.posExtent[ 0 ] / 65535.0f,
+        quantization.posExtent[ 1 ] / 65535.0f,
+        quantization.posExtent[ 2 ] / 65535.0f,
+    };
+    const Color color( quantization.color[ 0 ], quantization.color[ 1 ], quantization.color[ 2 ], quantization.color[ 3 ] );
+    const bool unormUVs = ( quantization.uvEncoding == MDL_UV_UNORM16 );
+
+    for ( size_t i = 0; i < vertexCount; ++i )
+    {
+        const mdlPackedVertex_t& in = packed[ i ];
+        vertex_t& vert = vertices[ i ];
+
+        vert.pos = vec4f( quantization.posMin[ 0 ] + in.pos[ 0 ] * posStep[ 0 ],
+                          quantization.posMin[ 1 ] + in.pos[ 1 ] * posStep[ 1 ],
+                          quantization.posMin[ 2 ] + in.pos[ 2 ] * posStep[ 2 ],
+                          quantization.posW );
+        vert.normal = DecodeOctahedral( in.normal );
+        if ( unormUVs )
+        {
+            vert.uv = vec2f( in.uv[ 0 ] * ( 1.0f / 65535.0f ), in.uv[ 1 ] * ( 1.0f / 65535.0f ) );
+        }
+        else
+        {
+            vert.uv = vec2f( HalfToFloat( in.uv[ 0 ] ), HalfToFloat( in.uv[ 1 ] ) );
+        }
+        vert.color = color;
+    }
+}
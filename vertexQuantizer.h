@@ -0,0 +1,14 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "../GfxCore/geom.h"
+#include "modelFile.h"
+
+// Packs vertices into mdlPackedVertex_t. Fails, leaving the outputs empty, when
+// pos.w or color vary across the model since those are only stored once.
+bool        QuantizeVertices( const vertex_t* vertices, const size_t vertexCount, mdlVertexQuantization_t& quantization, std::vector<mdlPackedVertex_t>& packed );
+void        DequantizeVertices( const mdlVertexQuantization_t& quantization, const mdlPackedVertex_t* packed, const size_t vertexCount, vertex_t* vertices );
+
+uint16_t    FloatToHalf( const float value );
+float       HalfToFloat( const uint16_t value );
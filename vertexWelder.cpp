@@ -0,0 +1,259 @@
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "vertexWelder.h"
+
+static const uint32_t EmptySlot = ~0u;
+
+static inline uint64_t MixHash( uint64_t h, uint64_t k )
+{
+    k *= 0x87c37b91114253d5ull;
+    k = ( k << 31 ) | ( k >> 33 );
+    k *= 0x4cf5ad432745937full;
+    h ^= k;
+    h = ( h << 27 ) | ( h >> 37 );
+    return h * 5 + 0x52dce729;
+}
+
+
+template<typename T>
+static inline uint64_t HashScalar( uint64_t h, const T value )
+{
+    // Adding zero folds -0.0 into +0.0 so values that compare equal hash equally
+    const float f = static_cast<float>( value ) + 0.0f;
+    uint32_t bits;
+    memcpy( &bits, &f, sizeof( bits ) );
+    return MixHash( h, bits );
+}
+
+
+uint64_t HashVertex( const vertex_t& vertex )
+{
+    // Color is left to operator== since LoadModel always writes Color::White
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    h = HashScalar( h, vertex.pos[ 0 ] );
+    h = HashScalar( h, vertex.pos[ 1 ] );
+    h = HashScalar( h, vertex.pos[ 2 ] );
+    h = HashScalar( h, vertex.normal[ 0 ] );
+    h = HashScalar( h, vertex.normal[ 1 ] );
+    h = HashScalar( h, vertex.normal[ 2 ] );
+    h = HashScalar( h, vertex.uv[ 0 ] );
+    h = HashScalar( h, vertex.uv[ 1 ] );
+
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    return h;
+}
+
+
+static inline uint64_t HashCell( const int64_t x, const int64_t y, const int64_t z )
+{
+    uint64_t h = 0x9e3779b97f4a7c15ull;
+    h = MixHash( h, static_cast<uint64_t>( x ) );
+    h = MixHash( h, static_cast<uint64_t>( y ) );
+    h = MixHash( h, static_cast<uint64_t>( z ) );
+    h ^= h >> 33;
+    return h;
+}
+
+
+VertexWelder::VertexWelder( const size_t expectedVertexCount, const weldTolerance_t& tolerance ) : tolerance( tolerance )
+{
+    exact = tolerance.IsExact();
+    slotMask = 0;
+    Reserve( ( expectedVertexCount > 0 ) ? expectedVertexCount : 1024 );
+}
+
+
+void VertexWelder::Reserve( const size_t vertexCount )
+{
+    vertices.reserve( vertexCount );
+    hashes.reserve( vertexCount );
+    if ( !exact )
+    {
+        chain.reserve( vertexCount );
+    }
+
+    // Keep the load factor at or below 50%
+    size_t slotCount = 16;
+    while ( slotCount < ( 2 * vertexCount ) )
+    {
+        slotCount <<= 1;
+    }
+
+    if ( slotCount > slots.size() )
+    {
+        Rehash( slotCount );
+    }
+}
+
+
+void VertexWelder::Rehash( const size_t slotCount )
+{
+    slots.assign( slotCount, EmptySlot );
+    slotMask = slotCount - 1;
+
+    const uint32_t vertexCount = static_cast<uint32_t>( vertices.size() );
+    if ( !exact )
+    {
+        for ( uint32_t i = 0; i < vertexCount; ++i )
+        {
+            const size_t bucket = static_cast<size_t>( hashes[ i ] ) & slotMask;
+            chain[ i ] = slots[ bucket ];
+            slots[ bucket ] = i;
+        }
+        return;
+    }
+
+    for ( uint32_t i = 0; i < vertexCount; ++i )
+    {
+        size_t slot = static_cast<size_t>( hashes[ i ] ) & slotMask;
+        while ( slots[ slot ] != EmptySlot )
+        {
+            slot = ( slot + 1 ) & slotMask;
+        }
+        slots[ slot ] = i;
+    }
+}
+
+
+uint32_t VertexWelder::Add( const vertex_t& vertex )
+{
+    if ( !exact )
+    {
+        return AddNearest( vertex );
+    }
+    return Add( vertex, HashVertex( vertex ) );
+}
+
+
+uint32_t VertexWelder::Add( const vertex_t& vertex, const uint64_t hash )
+{
+    assert( exact );
+
+    size_t slot = static_cast<size_t>( hash ) & slotMask;
+    while ( slots[ slot ] != EmptySlot )
+    {
+        const uint32_t candidate = slots[ slot ];
+        if ( ( hashes[ candidate ] == hash ) && ( vertices[ candidate ] == vertex ) )
+        {
+            return candidate;
+        }
+        slot = ( slot + 1 ) & slotMask;
+    }
+
+    const uint32_t index = static_cast<uint32_t>( vertices.size() );
+    slots[ slot ] = index;
+    vertices.push_back( vertex );
+    hashes.push_back( hash );
+
+    if ( ( 2 * vertices.size() ) > slots.size() )
+    {
+        Rehash( 2 * slots.size() );
+    }
+    return index;
+}
+
+
+void VertexWelder::GridCell( const vertex_t& vertex, int64_t cell[ 3 ], int64_t neighbor[ 3 ] ) const
+{
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        if ( tolerance.position > 0.0f )
+        {
+            // Cells are twice the tolerance wide, so a match is either in this cell
+            // or in the adjacent cell on the side nearer the vertex.
+            const double scaled = vertex.pos[ i ] / ( 2.0 * tolerance.position );
+            const double base = floor( scaled );
+            cell[ i ] = static_cast<int64_t>( base );
+            neighbor[ i ] = ( ( scaled - base ) < 0.5 ) ? -1 : 1;
+        }
+        else
+        {
+            // No position slack, so the cell is the exact coordinate
+            const float f = static_cast<float>( vertex.pos[ i ] ) + 0.0f;
+            uint32_t bits;
+            memcpy( &bits, &f, sizeof( bits ) );
+            cell[ i ] = bits;
+            neighbor[ i ] = 0;
+        }
+    }
+}
+
+
+bool VertexWelder::WithinTolerance( const vertex_t& a, const vertex_t& b ) const
+{
+    // pos[ 3 ] and color are constant for imported vertices, so only the
+    // varying attributes are compared.
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        if ( fabs( a.pos[ i ] - b.pos[ i ] ) > tolerance.position )
+        {
+            return false;
+        }
+    }
+    for ( uint32_t i = 0; i < 3; ++i )
+    {
+        if ( fabs( a.normal[ i ] - b.normal[ i ] ) > tolerance.normal )
+        {
+            return false;
+        }
+    }
+    for ( uint32_t i = 0; i < 2; ++i )
+    {
+        if ( fabs( a.uv[ i ] - b.uv[ i ] ) > tolerance.uv )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+uint32_t VertexWelder::AddNearest( const vertex_t& vertex )
+{
+    int64_t cell[ 3 ];
+    int64_t neighbor[ 3 ];
+    GridCell( vertex, cell, neighbor );
+
+    const uint32_t cellCount = ( tolerance.position > 0.0f ) ? 8 : 1;
+
+    // Take the earliest match so the result does not depend on bucket order
+    uint32_t match = EmptySlot;
+    for ( uint32_t n = 0; n < cellCount; ++n )
+    {
+        const int64_t x = cell[ 0 ] + ( ( n & 1 ) ? neighbor[ 0 ] : 0 );
+        const int64_t y = cell[ 1 ] + ( ( n & 2 ) ? neighbor[ 1 ] : 0 );
+        const int64_t z = cell[ 2 ] + ( ( n & 4 ) ? neighbor[ 2 ] : 0 );
+
+        const uint64_t cellHash = HashCell( x, y, z );
+        for ( uint32_t i = slots[ cellHash & slotMask ]; i != EmptySlot; i = chain[ i ] )
+        {
+            if ( ( i < match ) && WithinTolerance( vertices[ i ], vertex ) )
+            {
+                match = i;
+            }
+        }
+    }
+
+    if ( match != EmptySlot )
+    {
+        return match;
+    }
+
+    const uint64_t cellHash = HashCell( cell[ 0 ], cell[ 1 ], cell[ 2 ] );
+    const size_t bucket = static_cast<size_t>( cellHash ) & slotMask;
+
+    const uint32_t index = static_cast<uint32_t>( vertices.size() );
+    vertices.push_back( vertex );
+    hashes.push_back( cellHash );
+    chain.push_back( slots[ bucket ] );
+    slots[ bucket ] = index;
+
+    if ( vertices.size() > slots.size() )
+    {
+        Rehash( 2 * slots.size() );
+    }
+    return index;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include "../GfxCore/geom.h"
+
+uint64_t HashVertex( const vertex_t& vertex );
+
+// Per-component limits for merging nearly equal vertices. All zero means exact equality.
+struct weldTolerance_t
+{
+    float   position = 0.0f;
+    float   normal = 0.0f;
+    float   uv = 0.0f;
+
+    bool    IsExact() const { return ( position <= 0.0f ) && ( normal <= 0.0f ) && ( uv <= 0.0f ); }
+};
+
+// Deduplicates vertices using an open-addressed hash table keyed on the full vertex_t.
+// Indices are handed out in order of first appearance, matching a linear std::find weld.
+//
+// With a non-exact tolerance, vertices are bucketed into a position grid and a new
+// vertex merges into the earliest vertex in the nearby cells that is within every
+// tolerance.
+class VertexWelder
+{
+public:
+    VertexWelder( const size_t expectedVertexCount = 0, const weldTolerance_t& tolerance = weldTolerance_t() );
+
+    uint32_t                        Add( const vertex_t& vertex );
+    uint32_t                        Add( const vertex_t& vertex, const uint64_t hash );
+    void                            Reserve( const size_t vertexCount );
+
+    size_t                          GetVertexCount() const { return vertices.size(); }
+    const std::vector<vertex_t>&    GetVertices() const { return vertices; }
+    std::vector<vertex_t>&          GetVertices() { return vertices; }
+    uint64_t                        GetHash( const uint32_t vertexIx ) const { return hashes[ vertexIx ]; }
+    bool                            IsExact() const { return exact; }
+
+private:
+    void                            Rehash( const size_t slotCount );
+    uint32_t                        AddNearest( const vertex_t& vertex );
+    bool                            WithinTolerance( const vertex_t& a, const vertex_t& b ) const;
+    void                            GridCell( const vertex_t& vertex, int64_t cell[ 3 ], int64_t neighbor[ 3 ] ) const;
+
+    weldTolerance_t                 tolerance;
+    bool                            exact;
+
+    std::vector<vertex_t>           vertices;
+    std::vector<uint64_t>           hashes;     // Cached per vertex to make rehashing and probing cheap. Grid cell hash in tolerance mode.
+    std::vector<uint32_t>           slots;      // Index into vertices, or EmptySlot. Head of a cell chain in tolerance mode.
+    std::vector<uint32_t>           chain;      // Next vertex in the same grid bucket, tolerance mode only
+    size_t                          slotMask;
+};